@@ -0,0 +1,1513 @@
+#include "cpuengine.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined(CPU_ENGINE_AVX2) || defined(CPU_ENGINE_AVX512)
+#include <immintrin.h>
+#endif
+
+// Bodies per vector of the widest instruction set, which the streams are padded to
+#define CPU_ENGINE_PADDING 16
+
+// Bodies handed to a thread at a time. A multiple of the padding
+#define CPU_ENGINE_CHUNK_KICK  64
+#define CPU_ENGINE_CHUNK_DRIFT 4096
+
+#define TREE_LEVEL_COUNT 21  // Levels below the root, three bits of the Morton keys each
+#define TREE_LEAF_SIZE   16  // Nodes with fewer particles are not split
+#define TREE_STACK_SIZE  256 // Enough for every level to push all eight children
+
+#define FMM_ORDER_MAX         8
+#define FMM_COEFFICIENT_MAX   165 // Monomials up to FMM_ORDER_MAX in three dimensions
+#define FMM_LEAF_SIZE         64  // Larger leaves than the tree walk, since every node takes part in many expansions
+
+namespace
+{
+    // Force law exponent times ten, as the specialization constant of the shaders. The common exponents avoid pow()
+    int powerTenths(float power)
+    {
+        return static_cast<int>(std::lround(power * 10.0f));
+    }
+
+    // s^-power, see powerInverse() in shaders/nbody_common.glsl
+    inline float powerInverse(float s, int power_tenths, float power)
+    {
+        if (power_tenths == 15)
+        {
+            float s_inv_sqrt = 1.0f / std::sqrt(s);
+            return s_inv_sqrt * s_inv_sqrt * s_inv_sqrt;
+        }
+        else if (power_tenths == 10)
+        {
+            return 1.0f / s;
+        }
+        else if (power_tenths == 20)
+        {
+            float s_inv = 1.0f / s;
+            return s_inv * s_inv;
+        }
+
+        return std::pow(s, -power);
+    }
+
+    // Spreads 21 bits three apart
+    uint64_t mortonExpand(uint64_t value)
+    {
+        value = (value | (value << 32)) & 0x001f00000000ffffull;
+        value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+        value = (value | (value << 8))  & 0x100f00f00f00f00full;
+        value = (value | (value << 4))  & 0x10c30c30c30c30c3ull;
+        value = (value | (value << 2))  & 0x1249249249249249ull;
+        return value;
+    }
+
+    double binomial(uint32_t n, uint32_t k)
+    {
+        double value = 1.0;
+
+        for (uint32_t i = 1; i <= k; i++)
+        {
+            value = value * (n - k + i) / i;
+        }
+
+        return value;
+    }
+}
+
+
+CpuEngine::CpuEngine(unsigned int thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    pool_chunk_next = 0;
+
+    // The calling thread is the first one
+    for (unsigned int i = 1; i < thread_count; i++)
+    {
+        workers.emplace_back(&CpuEngine::workerRun, this);
+    }
+
+    // The widest kernel the CPU supports
+    if (instructionSetSupported(INSTRUCTION_SET_AVX512))
+    {
+        instruction_set = INSTRUCTION_SET_AVX512;
+    }
+    else if (instructionSetSupported(INSTRUCTION_SET_AVX2))
+    {
+        instruction_set = INSTRUCTION_SET_AVX2;
+    }
+    else
+    {
+        instruction_set = INSTRUCTION_SET_SCALAR;
+    }
+
+    multipoleTablesCreate();
+}
+
+
+CpuEngine::~CpuEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool_stop = true;
+    }
+
+    pool_wake.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+
+void CpuEngine::setParameters(const Parameters& value)
+{
+    parameters      = value;
+    fmm_lists_valid = false; // The opening angle may have changed
+}
+
+
+void CpuEngine::setParticles(const std::vector<VulkanWindow::Particle>& buffer)
+{
+    particle_count  = static_cast<uint32_t>(buffer.size());
+    fmm_lists_valid = false;
+
+    // Padding bodies are massless and at rest at the origin
+    uint32_t padded_count = (particle_count + CPU_ENGINE_PADDING - 1) / CPU_ENGINE_PADDING * CPU_ENGINE_PADDING;
+
+    for (std::vector<float> *stream : { &x, &y, &z, &m, &vx, &vy, &vz, &vw })
+    {
+        stream->assign(padded_count, 0.0f);
+    }
+
+    for (uint32_t i = 0; i < particle_count; i++)
+    {
+        x[i]  = buffer[i].xyzm[0];
+        y[i]  = buffer[i].xyzm[1];
+        z[i]  = buffer[i].xyzm[2];
+        m[i]  = buffer[i].xyzm[3];
+        vx[i] = buffer[i].v[0];
+        vy[i] = buffer[i].v[1];
+        vz[i] = buffer[i].v[2];
+        vw[i] = buffer[i].v[3];
+    }
+}
+
+
+void CpuEngine::particles(std::vector<VulkanWindow::Particle>& buffer) const
+{
+    buffer.resize(particle_count);
+
+    for (uint32_t i = 0; i < particle_count; i++)
+    {
+        buffer[i].xyzm[0] = x[i];
+        buffer[i].xyzm[1] = y[i];
+        buffer[i].xyzm[2] = z[i];
+        buffer[i].xyzm[3] = m[i];
+        buffer[i].v[0]    = vx[i];
+        buffer[i].v[1]    = vy[i];
+        buffer[i].v[2]    = vz[i];
+        buffer[i].v[3]    = vw[i];
+    }
+}
+
+
+void CpuEngine::setForceSolver(ForceSolver value)
+{
+    force_solver    = value;
+    fmm_lists_valid = false;
+}
+
+
+void CpuEngine::setMultipoleOrder(uint32_t value)
+{
+    fmm_order       = std::min(std::max(value, 1u), static_cast<uint32_t>(FMM_ORDER_MAX));
+    fmm_lists_valid = false;
+
+    multipoleTablesCreate();
+}
+
+
+void CpuEngine::setMultipoleRebuildInterval(uint32_t value)
+{
+    fmm_rebuild_interval = std::max(value, 1u);
+}
+
+
+CpuEngine::ForceSolver CpuEngine::forceSolver() const
+{
+    return force_solver;
+}
+
+
+bool CpuEngine::setInstructionSet(InstructionSet value)
+{
+    if (!instructionSetSupported(value))
+    {
+        return false;
+    }
+
+    instruction_set = value;
+    return true;
+}
+
+
+bool CpuEngine::instructionSetSupported(InstructionSet value)
+{
+    switch (value)
+    {
+    case INSTRUCTION_SET_AVX512:
+#if defined(CPU_ENGINE_AVX512) && defined(CPU_ENGINE_DISPATCH)
+        return __builtin_cpu_supports("avx512f") != 0;
+#elif defined(CPU_ENGINE_AVX512)
+        return true; // The whole build targets it
+#else
+        return false;
+#endif
+
+    case INSTRUCTION_SET_AVX2:
+#if defined(CPU_ENGINE_AVX2) && defined(CPU_ENGINE_DISPATCH)
+        return __builtin_cpu_supports("avx2") != 0 && __builtin_cpu_supports("fma") != 0;
+#elif defined(CPU_ENGINE_AVX2)
+        return true;
+#else
+        return false;
+#endif
+
+    default:
+        return true;
+    }
+}
+
+
+CpuEngine::InstructionSet CpuEngine::instructionSet() const
+{
+    return instruction_set;
+}
+
+
+QString CpuEngine::instructionSetName() const
+{
+    switch (instruction_set)
+    {
+    case INSTRUCTION_SET_AVX512:
+        return "AVX-512";
+
+    case INSTRUCTION_SET_AVX2:
+        return "AVX2";
+
+    default:
+        return "scalar";
+    }
+}
+
+
+unsigned int CpuEngine::threadCount() const
+{
+    return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+
+uint32_t CpuEngine::particleCount() const
+{
+    return particle_count;
+}
+
+
+void CpuEngine::step()
+{
+    // Step one computes the velocity at time step i + 1/2 from the positions at time step i
+    kick();
+
+    // Step two computes the position at time step i + 1 from the velocity at time step i + 1/2, once every body has been kicked
+    float t_delta = parameters.time_step;
+
+    parallelFor(particle_count, CPU_ENGINE_CHUNK_DRIFT, [this, t_delta](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            x[i] += vx[i] * t_delta;
+            y[i] += vy[i] * t_delta;
+            z[i] += vz[i] * t_delta;
+        }
+    });
+}
+
+
+double CpuEngine::forceError(uint32_t sample_count)
+{
+    // Velocity changes of one kick from rest, by the selected solver and by the all-pairs sum for every stride-th particle
+    std::vector<float> velocities[3] = { vx, vy, vz };
+
+    for (std::vector<float> *stream : { &vx, &vy, &vz })
+    {
+        std::fill(stream->begin(), stream->end(), 0.0f);
+    }
+
+    kick();
+
+    std::vector<float> kicked[3] = { vx, vy, vz };
+
+    for (std::vector<float> *stream : { &vx, &vy, &vz })
+    {
+        std::fill(stream->begin(), stream->end(), 0.0f);
+    }
+
+    uint32_t stride        = std::max(particle_count / std::max(sample_count, 1u), 1u);
+    uint32_t sample_actual = (particle_count + stride - 1) / stride;
+
+    parallelFor(sample_actual, CPU_ENGINE_CHUNK_KICK, [this, stride](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t s = begin; s < end; s++)
+        {
+            kickScalar(s * stride, s * stride + 1);
+        }
+    });
+
+    double   error_squared = 0.0;
+    uint32_t error_count   = 0;
+
+    for (uint32_t s = 0; s < sample_actual; s++)
+    {
+        uint32_t i         = s * stride;
+        double   difference[3] = { kicked[0][i] - vx[i], kicked[1][i] - vy[i], kicked[2][i] - vz[i] };
+        double   norm_squared  = static_cast<double>(vx[i]) * vx[i] + static_cast<double>(vy[i]) * vy[i] + static_cast<double>(vz[i]) * vz[i];
+
+        if (norm_squared > 0.0)
+        {
+            error_squared += (difference[0] * difference[0] + difference[1] * difference[1] + difference[2] * difference[2]) / norm_squared;
+            error_count++;
+        }
+    }
+
+    vx.swap(velocities[0]);
+    vy.swap(velocities[1]);
+    vz.swap(velocities[2]);
+
+    return std::sqrt(error_squared / std::max(error_count, 1u));
+}
+
+
+void CpuEngine::kick()
+{
+    // Every body reads all positions but only writes its own velocity, so the bodies are kicked in parallel. The multipole
+    // expansions need a force law steeper than 1/r, otherwise the tree is walked instead
+    if ((force_solver == FORCE_SOLVER_MULTIPOLE) && (parameters.power > 1.0f))
+    {
+        kickMultipole();
+    }
+    else if (force_solver != FORCE_SOLVER_ALL_PAIRS)
+    {
+        treeBuild();
+
+        // Threads walk the tree for neighbouring particles in Morton order, like nbody_tree_walk.comp
+        parallelFor(particle_count, CPU_ENGINE_CHUNK_KICK, [this](uint32_t begin, uint32_t end)
+        {
+            kickTree(begin, end);
+        });
+    }
+    else
+    {
+        parallelFor(static_cast<uint32_t>(x.size()), CPU_ENGINE_CHUNK_KICK, [this](uint32_t begin, uint32_t end)
+        {
+            switch (instruction_set)
+            {
+#if defined(CPU_ENGINE_AVX512)
+            case INSTRUCTION_SET_AVX512:
+                kickAvx512(begin, end);
+                break;
+#endif
+#if defined(CPU_ENGINE_AVX2)
+            case INSTRUCTION_SET_AVX2:
+                kickAvx2(begin, end);
+                break;
+#endif
+            default:
+                kickScalar(begin, end);
+                break;
+            }
+        });
+    }
+}
+
+
+void CpuEngine::kickScalar(uint32_t begin, uint32_t end)
+{
+    int   power_tenths = powerTenths(parameters.power);
+    float power        = parameters.power;
+    float eps2         = parameters.softening_squared;
+    float G_t_delta    = parameters.gravity_constant * parameters.time_step;
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        float acceleration[3] = { 0.0f, 0.0f, 0.0f };
+
+        // bodyBodyInteraction() of the shader
+        for (uint32_t j = 0; j < particle_count; j++)
+        {
+            float r[3] = { x[j] - x[i], y[j] - y[i], z[j] - z[i] };
+            float f    = m[j] * powerInverse(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + eps2, power_tenths, power);
+
+            acceleration[0] += r[0] * f;
+            acceleration[1] += r[1] * f;
+            acceleration[2] += r[2] * f;
+        }
+
+        vx[i] += acceleration[0] * G_t_delta;
+        vy[i] += acceleration[1] * G_t_delta;
+        vz[i] += acceleration[2] * G_t_delta;
+    }
+}
+
+
+#if defined(CPU_ENGINE_AVX2)
+void CpuEngine::kickAvx2(uint32_t begin, uint32_t end)
+{
+    // Eight bodies per vector, like BODIES_PER_THREAD of the shader. Each position of the other bodies is broadcast to all lanes
+    int power_tenths = powerTenths(parameters.power);
+
+    const __m256 one       = _mm256_set1_ps(1.0f);
+    const __m256 eps2      = _mm256_set1_ps(parameters.softening_squared);
+    const __m256 G_t_delta = _mm256_set1_ps(parameters.gravity_constant * parameters.time_step);
+
+    for (uint32_t i = begin; i < end; i += 8)
+    {
+        __m256 x_i = _mm256_loadu_ps(&x[i]);
+        __m256 y_i = _mm256_loadu_ps(&y[i]);
+        __m256 z_i = _mm256_loadu_ps(&z[i]);
+
+        __m256 acceleration_x = _mm256_setzero_ps();
+        __m256 acceleration_y = _mm256_setzero_ps();
+        __m256 acceleration_z = _mm256_setzero_ps();
+
+        for (uint32_t j = 0; j < particle_count; j++)
+        {
+            __m256 r_x = _mm256_sub_ps(_mm256_set1_ps(x[j]), x_i);
+            __m256 r_y = _mm256_sub_ps(_mm256_set1_ps(y[j]), y_i);
+            __m256 r_z = _mm256_sub_ps(_mm256_set1_ps(z[j]), z_i);
+            __m256 s   = _mm256_fmadd_ps(r_x, r_x, _mm256_fmadd_ps(r_y, r_y, _mm256_fmadd_ps(r_z, r_z, eps2)));
+            __m256 s_inv;
+
+            if (power_tenths == 15)
+            {
+                __m256 s_inv_sqrt = _mm256_div_ps(one, _mm256_sqrt_ps(s));
+                s_inv = _mm256_mul_ps(_mm256_mul_ps(s_inv_sqrt, s_inv_sqrt), s_inv_sqrt);
+            }
+            else if (power_tenths == 10)
+            {
+                s_inv = _mm256_div_ps(one, s);
+            }
+            else if (power_tenths == 20)
+            {
+                __m256 s_inv_one = _mm256_div_ps(one, s);
+                s_inv = _mm256_mul_ps(s_inv_one, s_inv_one);
+            }
+            else
+            {
+                alignas(32) float lanes[8];
+                _mm256_store_ps(lanes, s);
+
+                for (float& lane : lanes)
+                {
+                    lane = std::pow(lane, -parameters.power);
+                }
+
+                s_inv = _mm256_load_ps(lanes);
+            }
+
+            __m256 f = _mm256_mul_ps(_mm256_set1_ps(m[j]), s_inv);
+
+            acceleration_x = _mm256_fmadd_ps(r_x, f, acceleration_x);
+            acceleration_y = _mm256_fmadd_ps(r_y, f, acceleration_y);
+            acceleration_z = _mm256_fmadd_ps(r_z, f, acceleration_z);
+        }
+
+        _mm256_storeu_ps(&vx[i], _mm256_fmadd_ps(acceleration_x, G_t_delta, _mm256_loadu_ps(&vx[i])));
+        _mm256_storeu_ps(&vy[i], _mm256_fmadd_ps(acceleration_y, G_t_delta, _mm256_loadu_ps(&vy[i])));
+        _mm256_storeu_ps(&vz[i], _mm256_fmadd_ps(acceleration_z, G_t_delta, _mm256_loadu_ps(&vz[i])));
+    }
+}
+#endif
+
+
+#if defined(CPU_ENGINE_AVX512)
+void CpuEngine::kickAvx512(uint32_t begin, uint32_t end)
+{
+    // Sixteen bodies per vector, see kickAvx2()
+    int power_tenths = powerTenths(parameters.power);
+
+    const __m512 one       = _mm512_set1_ps(1.0f);
+    const __m512 eps2      = _mm512_set1_ps(parameters.softening_squared);
+    const __m512 G_t_delta = _mm512_set1_ps(parameters.gravity_constant * parameters.time_step);
+
+    for (uint32_t i = begin; i < end; i += 16)
+    {
+        __m512 x_i = _mm512_loadu_ps(&x[i]);
+        __m512 y_i = _mm512_loadu_ps(&y[i]);
+        __m512 z_i = _mm512_loadu_ps(&z[i]);
+
+        __m512 acceleration_x = _mm512_setzero_ps();
+        __m512 acceleration_y = _mm512_setzero_ps();
+        __m512 acceleration_z = _mm512_setzero_ps();
+
+        for (uint32_t j = 0; j < particle_count; j++)
+        {
+            __m512 r_x = _mm512_sub_ps(_mm512_set1_ps(x[j]), x_i);
+            __m512 r_y = _mm512_sub_ps(_mm512_set1_ps(y[j]), y_i);
+            __m512 r_z = _mm512_sub_ps(_mm512_set1_ps(z[j]), z_i);
+            __m512 s   = _mm512_fmadd_ps(r_x, r_x, _mm512_fmadd_ps(r_y, r_y, _mm512_fmadd_ps(r_z, r_z, eps2)));
+            __m512 s_inv;
+
+            if (power_tenths == 15)
+            {
+                __m512 s_inv_sqrt = _mm512_div_ps(one, _mm512_sqrt_ps(s));
+                s_inv = _mm512_mul_ps(_mm512_mul_ps(s_inv_sqrt, s_inv_sqrt), s_inv_sqrt);
+            }
+            else if (power_tenths == 10)
+            {
+                s_inv = _mm512_div_ps(one, s);
+            }
+            else if (power_tenths == 20)
+            {
+                __m512 s_inv_one = _mm512_div_ps(one, s);
+                s_inv = _mm512_mul_ps(s_inv_one, s_inv_one);
+            }
+            else
+            {
+                alignas(64) float lanes[16];
+                _mm512_store_ps(lanes, s);
+
+                for (float& lane : lanes)
+                {
+                    lane = std::pow(lane, -parameters.power);
+                }
+
+                s_inv = _mm512_load_ps(lanes);
+            }
+
+            __m512 f = _mm512_mul_ps(_mm512_set1_ps(m[j]), s_inv);
+
+            acceleration_x = _mm512_fmadd_ps(r_x, f, acceleration_x);
+            acceleration_y = _mm512_fmadd_ps(r_y, f, acceleration_y);
+            acceleration_z = _mm512_fmadd_ps(r_z, f, acceleration_z);
+        }
+
+        _mm512_storeu_ps(&vx[i], _mm512_fmadd_ps(acceleration_x, G_t_delta, _mm512_loadu_ps(&vx[i])));
+        _mm512_storeu_ps(&vy[i], _mm512_fmadd_ps(acceleration_y, G_t_delta, _mm512_loadu_ps(&vy[i])));
+        _mm512_storeu_ps(&vz[i], _mm512_fmadd_ps(acceleration_z, G_t_delta, _mm512_loadu_ps(&vz[i])));
+    }
+}
+#endif
+
+
+void CpuEngine::treeBuild()
+{
+    // Bounds of the particles, reduced over the chunks of the threads
+    uint32_t           chunk_count = (particle_count + CPU_ENGINE_CHUNK_DRIFT - 1) / CPU_ENGINE_CHUNK_DRIFT;
+    std::vector<float> chunk_bounds(6 * chunk_count);
+
+    parallelFor(particle_count, CPU_ENGINE_CHUNK_DRIFT, [this, &chunk_bounds](uint32_t begin, uint32_t end)
+    {
+        float *bounds = &chunk_bounds[6 * (begin / CPU_ENGINE_CHUNK_DRIFT)];
+
+        bounds[0] = bounds[1] = bounds[2] = std::numeric_limits<float>::max();
+        bounds[3] = bounds[4] = bounds[5] = -std::numeric_limits<float>::max();
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            bounds[0] = std::min(bounds[0], x[i]);
+            bounds[1] = std::min(bounds[1], y[i]);
+            bounds[2] = std::min(bounds[2], z[i]);
+            bounds[3] = std::max(bounds[3], x[i]);
+            bounds[4] = std::max(bounds[4], y[i]);
+            bounds[5] = std::max(bounds[5], z[i]);
+        }
+    });
+
+    float bbox_min[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float extent      = 0.0f;
+
+    for (uint32_t c = 0; c < chunk_count; c++)
+    {
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            bbox_min[k] = std::min(bbox_min[k], chunk_bounds[6 * c + k]);
+        }
+    }
+
+    for (uint32_t c = 0; c < chunk_count; c++)
+    {
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            extent = std::max(extent, chunk_bounds[6 * c + 3 + k] - bbox_min[k]);
+        }
+    }
+
+    // Morton keys over the bounding cube, so that the cells of the octree are cubes
+    const uint32_t cell_count = 1u << TREE_LEVEL_COUNT;
+    float          scale      = static_cast<float>(cell_count) / std::max(extent, 1.0e-20f);
+
+    tree_keys.resize(particle_count);
+
+    parallelFor(particle_count, CPU_ENGINE_CHUNK_DRIFT, [this, &bbox_min, scale, cell_count](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint64_t cell_x = std::min(static_cast<uint32_t>((x[i] - bbox_min[0]) * scale), cell_count - 1);
+            uint64_t cell_y = std::min(static_cast<uint32_t>((y[i] - bbox_min[1]) * scale), cell_count - 1);
+            uint64_t cell_z = std::min(static_cast<uint32_t>((z[i] - bbox_min[2]) * scale), cell_count - 1);
+
+            tree_keys[i].key   = (mortonExpand(cell_x) << 2) | (mortonExpand(cell_y) << 1) | mortonExpand(cell_z);
+            tree_keys[i].index = i;
+        }
+    });
+
+    // Sorted in chunks, then merged pairwise. Equal keys are ordered by particle, so that the tree does not depend on the threads
+    auto key_less = [](const TreeKey& a, const TreeKey& b)
+    {
+        return (a.key < b.key) || ((a.key == b.key) && (a.index < b.index));
+    };
+
+    uint32_t sort_chunk_size = std::max((particle_count + 4 * threadCount() - 1) / (4 * threadCount()), 1024u);
+
+    parallelFor(particle_count, sort_chunk_size, [this, &key_less](uint32_t begin, uint32_t end)
+    {
+        std::sort(tree_keys.begin() + begin, tree_keys.begin() + end, key_less);
+    });
+
+    for (uint32_t width = sort_chunk_size; width < particle_count; width *= 2)
+    {
+        parallelFor(particle_count, 2 * width, [this, &key_less, width](uint32_t begin, uint32_t end)
+        {
+            std::inplace_merge(tree_keys.begin() + begin, tree_keys.begin() + std::min(begin + width, end), tree_keys.begin() + end, key_less);
+        });
+    }
+
+    treeGather();
+
+    // Top levels, breadth first, until there is enough work for every thread
+    TreeNode root = {};
+    root.begin = 0;
+    root.end   = particle_count;
+
+    tree_nodes.assign(1, root);
+
+    std::vector<uint32_t> frontier(1, 0);
+    uint32_t              level = 0;
+
+    while (!frontier.empty() && (frontier.size() < 8 * threadCount()) && (level < TREE_LEVEL_COUNT))
+    {
+        std::vector<uint32_t> frontier_next;
+
+        for (uint32_t node : frontier)
+        {
+            treeSplit(tree_nodes, node, level);
+
+            for (uint32_t c = 0; c < tree_nodes[node].child_count; c++)
+            {
+                frontier_next.push_back(tree_nodes[node].child_first + c);
+            }
+        }
+
+        frontier.swap(frontier_next);
+        level++;
+    }
+
+    // Subtrees below the top levels. Each is built into a vector of its own with its root first
+    uint32_t subtree_count = static_cast<uint32_t>(frontier.size());
+
+    tree_subtrees.resize(subtree_count);
+
+    parallelFor(subtree_count, 1, [this, &frontier, level](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t t = begin; t < end; t++)
+        {
+            std::vector<TreeNode>& nodes = tree_subtrees[t];
+
+            nodes.assign(1, tree_nodes[frontier[t]]);
+            treeSubtreeBuild(nodes, 0, level);
+        }
+    });
+
+    // Move the subtrees behind the top levels, and their roots back into place
+    tree_top_count = static_cast<uint32_t>(tree_nodes.size());
+    tree_subtree_roots.swap(frontier);
+    tree_subtree_offsets.resize(subtree_count);
+    tree_subtree_root.assign(tree_top_count, false);
+
+    uint32_t node_count = tree_top_count;
+
+    for (uint32_t t = 0; t < subtree_count; t++)
+    {
+        tree_subtree_offsets[t]                   = node_count - 1; // The root stays at the top
+        tree_subtree_root[tree_subtree_roots[t]] = true;
+        node_count                               += static_cast<uint32_t>(tree_subtrees[t].size()) - 1;
+    }
+
+    tree_nodes.resize(node_count);
+
+    parallelFor(subtree_count, 1, [this](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t t = begin; t < end; t++)
+        {
+            const std::vector<TreeNode>& nodes = tree_subtrees[t];
+
+            for (uint32_t k = 0; k < nodes.size(); k++)
+            {
+                TreeNode node = nodes[k];
+
+                if (node.child_count > 0)
+                {
+                    node.child_first += tree_subtree_offsets[t];
+                }
+
+                tree_nodes[(k == 0) ? tree_subtree_roots[t] : tree_subtree_offsets[t] + k] = node;
+            }
+        }
+    });
+
+    treeBottomUp([this](uint32_t node)
+    {
+        treeMoments(node);
+    });
+}
+
+
+void CpuEngine::treeGather()
+{
+    // Positions and masses in Morton order, so that the leaves are contiguous
+    tree_x.resize(particle_count);
+    tree_y.resize(particle_count);
+    tree_z.resize(particle_count);
+    tree_m.resize(particle_count);
+
+    parallelFor(particle_count, CPU_ENGINE_CHUNK_DRIFT, [this](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t index = tree_keys[i].index;
+
+            tree_x[i] = x[index];
+            tree_y[i] = y[index];
+            tree_z[i] = z[index];
+            tree_m[i] = m[index];
+        }
+    });
+}
+
+
+void CpuEngine::treeBottomUp(const std::function<void(uint32_t)>& visit)
+{
+    // Children have larger indices than their parents, within the top levels as well as within a subtree
+    uint32_t subtree_count = static_cast<uint32_t>(tree_subtree_roots.size());
+
+    parallelFor(subtree_count, 1, [this, &visit](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t t = begin; t < end; t++)
+        {
+            for (uint32_t k = static_cast<uint32_t>(tree_subtrees[t].size()) - 1; k > 0; k--)
+            {
+                visit(tree_subtree_offsets[t] + k);
+            }
+
+            visit(tree_subtree_roots[t]);
+        }
+    });
+
+    for (uint32_t node = tree_top_count; node-- > 0;)
+    {
+        if (!tree_subtree_root[node])
+        {
+            visit(node);
+        }
+    }
+}
+
+
+void CpuEngine::treeTopDown(const std::function<void(uint32_t)>& visit)
+{
+    for (uint32_t node = 0; node < tree_top_count; node++)
+    {
+        visit(node);
+    }
+
+    uint32_t subtree_count = static_cast<uint32_t>(tree_subtree_roots.size());
+
+    parallelFor(subtree_count, 1, [this, &visit](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t t = begin; t < end; t++)
+        {
+            for (uint32_t k = 1; k < tree_subtrees[t].size(); k++)
+            {
+                visit(tree_subtree_offsets[t] + k);
+            }
+        }
+    });
+}
+
+
+void CpuEngine::treeSplit(std::vector<TreeNode>& nodes, uint32_t node, uint32_t level) const
+{
+    // Children are the runs of equal octants at this level. Keys of a node agree on all levels above
+    uint32_t begin = nodes[node].begin;
+    uint32_t end   = nodes[node].end;
+
+    if ((end - begin <= TREE_LEAF_SIZE) || (level >= TREE_LEVEL_COUNT))
+    {
+        return;
+    }
+
+    uint32_t shift       = 3 * (TREE_LEVEL_COUNT - 1 - level);
+    uint32_t child_first = static_cast<uint32_t>(nodes.size());
+
+    while (begin < end)
+    {
+        uint64_t octant = (tree_keys[begin].key >> shift) & 7;
+
+        auto upper = std::upper_bound(tree_keys.begin() + begin, tree_keys.begin() + end, octant, [shift](uint64_t value, const TreeKey& key)
+        {
+            return value < ((key.key >> shift) & 7);
+        });
+
+        TreeNode child = {};
+        child.begin = begin;
+        child.end   = static_cast<uint32_t>(upper - tree_keys.begin());
+
+        nodes.push_back(child);
+
+        begin = child.end;
+    }
+
+    nodes[node].child_first = child_first;
+    nodes[node].child_count = static_cast<uint32_t>(nodes.size()) - child_first;
+}
+
+
+void CpuEngine::treeSubtreeBuild(std::vector<TreeNode>& nodes, uint32_t node, uint32_t level) const
+{
+    // Depth first, so that the children of a node follow it
+    treeSplit(nodes, node, level);
+
+    for (uint32_t c = 0; c < nodes[node].child_count; c++)
+    {
+        treeSubtreeBuild(nodes, nodes[node].child_first + c, level + 1);
+    }
+}
+
+
+void CpuEngine::treeMoments(uint32_t node)
+{
+    // Mass, centre of mass and bounding box, like nbody_tree_moments.comp. Leaves take them from their particles
+    TreeNode& parent = tree_nodes[node];
+
+    float mass        = 0.0f;
+    float com[3]      = { 0.0f, 0.0f, 0.0f };
+    float bbox_min[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float bbox_max[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+    if (parent.child_count == 0)
+    {
+        for (uint32_t i = parent.begin; i < parent.end; i++)
+        {
+            float xyz[3] = { tree_x[i], tree_y[i], tree_z[i] };
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                com[k]     += xyz[k] * tree_m[i];
+                bbox_min[k] = std::min(bbox_min[k], xyz[k]);
+                bbox_max[k] = std::max(bbox_max[k], xyz[k]);
+            }
+
+            mass += tree_m[i];
+        }
+    }
+    else
+    {
+        for (uint32_t c = 0; c < parent.child_count; c++)
+        {
+            const TreeNode& child = tree_nodes[parent.child_first + c];
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                com[k]     += child.com_mass[k] * child.com_mass[3];
+                bbox_min[k] = std::min(bbox_min[k], child.bbox_min[k]);
+                bbox_max[k] = std::max(bbox_max[k], child.bbox_max[k]);
+            }
+
+            mass += child.com_mass[3];
+        }
+    }
+
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        // Massless nodes act on nothing, but keep a finite centre
+        parent.com_mass[k] = (mass > 0.0f) ? com[k] / mass : 0.5f * (bbox_min[k] + bbox_max[k]);
+        parent.bbox_min[k] = bbox_min[k];
+        parent.bbox_max[k] = bbox_max[k];
+    }
+
+    parent.com_mass[3] = mass;
+
+    // The multipole expansions converge beyond this radius
+    float extent[3];
+
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        extent[k] = std::max(parent.com_mass[k] - bbox_min[k], bbox_max[k] - parent.com_mass[k]);
+    }
+
+    parent.radius = std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+}
+
+
+void CpuEngine::kickTree(uint32_t begin, uint32_t end)
+{
+    // Same opening criterion as nbody_tree_walk.comp. Opened leaves are summed over their particles
+    int   power_tenths = powerTenths(parameters.power);
+    float power        = parameters.power;
+    float eps2         = parameters.softening_squared;
+    float theta2       = parameters.opening_angle * parameters.opening_angle;
+    float G_t_delta    = parameters.gravity_constant * parameters.time_step;
+
+    uint32_t stack[TREE_STACK_SIZE];
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        float xyz_i[3]        = { tree_x[i], tree_y[i], tree_z[i] };
+        float acceleration[3] = { 0.0f, 0.0f, 0.0f };
+
+        uint32_t stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const TreeNode& node = tree_nodes[stack[--stack_size]];
+
+            float r[3] = { node.com_mass[0] - xyz_i[0], node.com_mass[1] - xyz_i[1], node.com_mass[2] - xyz_i[2] };
+            float r2   = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+            float size = std::max(node.bbox_max[0] - node.bbox_min[0], std::max(node.bbox_max[1] - node.bbox_min[1], node.bbox_max[2] - node.bbox_min[2]));
+
+            // Open the node if it is too close to be approximated by its centre of mass
+            if (size * size >= theta2 * r2)
+            {
+                if (node.child_count == 0)
+                {
+                    for (uint32_t j = node.begin; j < node.end; j++)
+                    {
+                        float r_j[3] = { tree_x[j] - xyz_i[0], tree_y[j] - xyz_i[1], tree_z[j] - xyz_i[2] };
+                        float f      = tree_m[j] * powerInverse(r_j[0] * r_j[0] + r_j[1] * r_j[1] + r_j[2] * r_j[2] + eps2, power_tenths, power);
+
+                        acceleration[0] += r_j[0] * f;
+                        acceleration[1] += r_j[1] * f;
+                        acceleration[2] += r_j[2] * f;
+                    }
+
+                    continue;
+                }
+                else if (stack_size + node.child_count <= TREE_STACK_SIZE)
+                {
+                    for (uint32_t c = 0; c < node.child_count; c++)
+                    {
+                        stack[stack_size++] = node.child_first + c;
+                    }
+
+                    continue;
+                }
+            }
+
+            float f = node.com_mass[3] * powerInverse(r2 + eps2, power_tenths, power);
+
+            acceleration[0] += r[0] * f;
+            acceleration[1] += r[1] * f;
+            acceleration[2] += r[2] * f;
+        }
+
+        uint32_t index = tree_keys[i].index;
+
+        vx[index] += acceleration[0] * G_t_delta;
+        vy[index] += acceleration[1] * G_t_delta;
+        vz[index] += acceleration[2] * G_t_delta;
+    }
+}
+
+
+void CpuEngine::multipoleTablesCreate()
+{
+    // Multi-indices of the monomials up to the order, graded so that lower orders come first
+    uint32_t             p = fmm_order;
+    std::vector<int32_t> lookup((p + 1) * (p + 1) * (p + 1), -1);
+
+    auto coefficient = [&lookup, p](int32_t k_x, int32_t k_y, int32_t k_z) -> int32_t
+    {
+        if ((k_x < 0) || (k_y < 0) || (k_z < 0) || (static_cast<uint32_t>(k_x + k_y + k_z) > p))
+        {
+            return -1;
+        }
+
+        return lookup[(k_x * (p + 1) + k_y) * (p + 1) + k_z];
+    };
+
+    fmm_exponents.clear();
+
+    for (uint32_t n = 0; n <= p; n++)
+    {
+        for (uint32_t k_x = n + 1; k_x-- > 0;)
+        {
+            for (uint32_t k_y = n - k_x + 1; k_y-- > 0;)
+            {
+                uint32_t k_z = n - k_x - k_y;
+
+                lookup[(k_x * (p + 1) + k_y) * (p + 1) + k_z] = static_cast<int32_t>(fmm_exponents.size() / 3);
+
+                fmm_exponents.push_back(k_x);
+                fmm_exponents.push_back(k_y);
+                fmm_exponents.push_back(k_z);
+            }
+        }
+    }
+
+    fmm_coefficient_count = static_cast<uint32_t>(fmm_exponents.size() / 3);
+
+    fmm_minus_one.resize(3 * fmm_coefficient_count);
+    fmm_minus_two.resize(3 * fmm_coefficient_count);
+
+    for (uint32_t k = 0; k < fmm_coefficient_count; k++)
+    {
+        for (int32_t a = 0; a < 3; a++)
+        {
+            int32_t exponents_one[3] = { static_cast<int32_t>(fmm_exponents[3 * k]), static_cast<int32_t>(fmm_exponents[3 * k + 1]), static_cast<int32_t>(fmm_exponents[3 * k + 2]) };
+            int32_t exponents_two[3] = { exponents_one[0], exponents_one[1], exponents_one[2] };
+
+            exponents_one[a] -= 1;
+            exponents_two[a] -= 2;
+
+            fmm_minus_one[3 * k + a] = coefficient(exponents_one[0], exponents_one[1], exponents_one[2]);
+            fmm_minus_two[3 * k + a] = coefficient(exponents_two[0], exponents_two[1], exponents_two[2]);
+        }
+    }
+
+    // Translations and conversions. M2M and L2L shift by a monomial of the distance between the centres, M2L takes the
+    // derivatives of the potential at that distance. Terms are truncated at the total order
+    fmm_terms_m2m.clear();
+    fmm_terms_m2l.clear();
+    fmm_terms_l2l.clear();
+
+    for (uint32_t a = 0; a < fmm_coefficient_count; a++)
+    {
+        for (uint32_t b = 0; b < fmm_coefficient_count; b++)
+        {
+            const uint32_t *k_a = &fmm_exponents[3 * a];
+            const uint32_t *k_b = &fmm_exponents[3 * b];
+
+            // M2M and L2L, the exponents of b at most those of a
+            if ((k_b[0] <= k_a[0]) && (k_b[1] <= k_a[1]) && (k_b[2] <= k_a[2]))
+            {
+                MultipoleTerm term;
+                term.shift  = static_cast<uint32_t>(coefficient(k_a[0] - k_b[0], k_a[1] - k_b[1], k_a[2] - k_b[2]));
+                term.factor = binomial(k_a[0], k_b[0]) * binomial(k_a[1], k_b[1]) * binomial(k_a[2], k_b[2]);
+
+                term.output = a;
+                term.input  = b;
+                fmm_terms_m2m.push_back(term);
+
+                term.output = b;
+                term.input  = a;
+                fmm_terms_l2l.push_back(term);
+            }
+
+            // M2L, the local coefficient a from the multipole b
+            int32_t shift = coefficient(k_a[0] + k_b[0], k_a[1] + k_b[1], k_a[2] + k_b[2]);
+
+            if (shift >= 0)
+            {
+                MultipoleTerm term;
+                term.output = a;
+                term.input  = b;
+                term.shift  = static_cast<uint32_t>(shift);
+                term.factor = binomial(k_a[0] + k_b[0], k_b[0]) * binomial(k_a[1] + k_b[1], k_b[1]) * binomial(k_a[2] + k_b[2], k_b[2]);
+
+                fmm_terms_m2l.push_back(term);
+            }
+        }
+    }
+}
+
+
+void CpuEngine::multipolePowers(const double d[3], double *powers) const
+{
+    // Monomials d^k, each from one of a lower order
+    powers[0] = 1.0;
+
+    for (uint32_t k = 1; k < fmm_coefficient_count; k++)
+    {
+        uint32_t a = (fmm_exponents[3 * k] > 0) ? 0 : ((fmm_exponents[3 * k + 1] > 0) ? 1 : 2);
+
+        powers[k] = powers[fmm_minus_one[3 * k + a]] * d[a];
+    }
+}
+
+
+void CpuEngine::multipoleDerivatives(const double r[3], double *derivatives) const
+{
+    // Taylor coefficients D^k f(r) / k! of the potential f = s^-q / 2q, s = r.r + eps2 and q = power - 1, whose gradient is the force
+    // of bodyBodyInteraction(). They follow from the recurrence
+    // s |k| a_k = -(2 |k| - 2 + 2q) sum_i r_i a_(k - e_i) - (|k| - 2 + 2q) sum_i a_(k - 2e_i)
+    double q = static_cast<double>(parameters.power) - 1.0;
+    double s = r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + parameters.softening_squared;
+
+    derivatives[0] = std::pow(s, -q) / (2.0 * q);
+
+    for (uint32_t k = 1; k < fmm_coefficient_count; k++)
+    {
+        double n        = fmm_exponents[3 * k] + fmm_exponents[3 * k + 1] + fmm_exponents[3 * k + 2];
+        double sum_one  = 0.0;
+        double sum_two  = 0.0;
+
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            if (fmm_minus_one[3 * k + a] >= 0)
+            {
+                sum_one += r[a] * derivatives[fmm_minus_one[3 * k + a]];
+            }
+
+            if (fmm_minus_two[3 * k + a] >= 0)
+            {
+                sum_two += derivatives[fmm_minus_two[3 * k + a]];
+            }
+        }
+
+        derivatives[k] = (-(2.0 * n - 2.0 + 2.0 * q) * sum_one - (n - 2.0 + 2.0 * q) * sum_two) / (s * n);
+    }
+}
+
+
+void CpuEngine::multipoleListsBuild()
+{
+    uint32_t node_count = static_cast<uint32_t>(tree_nodes.size());
+
+    fmm_list_m2l.resize(node_count);
+    fmm_list_p2p.resize(node_count);
+    fmm_list_pending.resize(node_count);
+    fmm_active.assign(node_count, 0);
+
+    for (std::vector<uint32_t>& pending : fmm_list_pending)
+    {
+        pending.clear();
+    }
+
+    // Every node starts out with the sources handed down from its parent, the root with itself
+    fmm_list_pending[0].assign(1, 0);
+    fmm_active[0] = 1;
+
+    treeTopDown([this](uint32_t node)
+    {
+        const TreeNode& parent = tree_nodes[node];
+
+        for (uint32_t c = 0; c < parent.child_count; c++)
+        {
+            fmm_active[parent.child_first + c] = fmm_active[node] && !multipoleLeaf(parent);
+        }
+
+        multipoleListsVisit(node);
+    });
+
+    fmm_leaves.clear();
+
+    for (uint32_t node = 0; node < node_count; node++)
+    {
+        if (fmm_active[node] && multipoleLeaf(tree_nodes[node]))
+        {
+            fmm_leaves.push_back(node);
+        }
+    }
+}
+
+
+bool CpuEngine::multipoleLeaf(const TreeNode& node) const
+{
+    // A node covers the particles of all its descendants, so it can stand in for them
+    return (node.child_count == 0) || (node.end - node.begin <= FMM_LEAF_SIZE);
+}
+
+
+void CpuEngine::multipoleListsVisit(uint32_t node)
+{
+    // Dual tree traversal. Well separated sources interact through their expansions, neighbouring leaves directly. Otherwise the
+    // larger of the two nodes is split: source children are tested here, target children inherit the source
+    std::vector<uint32_t> sources;
+    sources.swap(fmm_list_pending[node]);
+
+    fmm_list_m2l[node].clear();
+    fmm_list_p2p[node].clear();
+
+    const TreeNode& target      = tree_nodes[node];
+    bool            target_leaf = multipoleLeaf(target);
+    float           theta2      = parameters.opening_angle * parameters.opening_angle;
+
+    while (!sources.empty())
+    {
+        uint32_t source_index = sources.back();
+        sources.pop_back();
+
+        const TreeNode& source = tree_nodes[source_index];
+
+        float r[3]   = { target.com_mass[0] - source.com_mass[0], target.com_mass[1] - source.com_mass[1], target.com_mass[2] - source.com_mass[2] };
+        float radius = target.radius + source.radius;
+        bool  source_leaf = multipoleLeaf(source);
+
+        if (radius * radius < theta2 * (r[0] * r[0] + r[1] * r[1] + r[2] * r[2]))
+        {
+            fmm_list_m2l[node].push_back(source_index);
+        }
+        else if (target_leaf && source_leaf)
+        {
+            fmm_list_p2p[node].push_back(source_index);
+        }
+        else if (target_leaf || (!source_leaf && (source.radius > target.radius)))
+        {
+            for (uint32_t c = 0; c < source.child_count; c++)
+            {
+                sources.push_back(source.child_first + c);
+            }
+        }
+        else
+        {
+            for (uint32_t c = 0; c < target.child_count; c++)
+            {
+                fmm_list_pending[target.child_first + c].push_back(source_index);
+            }
+        }
+    }
+}
+
+
+void CpuEngine::kickMultipole()
+{
+    // The tree and the interaction lists are rebuilt every few kicks. In between, the nodes keep their particles and only the
+    // moments follow the particles, so that the lists stay valid as long as the particles move little
+    if (!fmm_lists_valid || (fmm_kicks_since_rebuild >= fmm_rebuild_interval))
+    {
+        treeBuild();
+        multipoleListsBuild();
+
+        fmm_lists_valid         = true;
+        fmm_kicks_since_rebuild = 0;
+    }
+    else
+    {
+        treeGather();
+        treeBottomUp([this](uint32_t node)
+        {
+            treeMoments(node);
+        });
+    }
+
+    fmm_kicks_since_rebuild++;
+
+    uint32_t node_count = static_cast<uint32_t>(tree_nodes.size());
+    uint32_t C          = fmm_coefficient_count;
+
+    fmm_multipoles.assign(static_cast<size_t>(node_count) * C, 0.0);
+    fmm_locals.assign(static_cast<size_t>(node_count) * C, 0.0);
+
+    // Upward pass. Leaves expand their particles about their centre of mass, parents shift the expansions of their children
+    treeBottomUp([this, C](uint32_t node)
+    {
+        const TreeNode& parent     = tree_nodes[node];
+        double         *multipoles = &fmm_multipoles[static_cast<size_t>(node) * C];
+        double          powers[FMM_COEFFICIENT_MAX];
+
+        if (!fmm_active[node])
+        {
+            return;
+        }
+        else if (multipoleLeaf(parent))
+        {
+            for (uint32_t i = parent.begin; i < parent.end; i++)
+            {
+                double d[3] = { parent.com_mass[0] - tree_x[i], parent.com_mass[1] - tree_y[i], parent.com_mass[2] - tree_z[i] };
+
+                multipolePowers(d, powers);
+
+                for (uint32_t k = 0; k < C; k++)
+                {
+                    multipoles[k] += tree_m[i] * powers[k];
+                }
+            }
+        }
+        else
+        {
+            for (uint32_t c = 0; c < parent.child_count; c++)
+            {
+                uint32_t        child_index      = parent.child_first + c;
+                const TreeNode& child            = tree_nodes[child_index];
+                const double   *child_multipoles = &fmm_multipoles[static_cast<size_t>(child_index) * C];
+                double          d[3]             = { parent.com_mass[0] - child.com_mass[0], parent.com_mass[1] - child.com_mass[1], parent.com_mass[2] - child.com_mass[2] };
+
+                multipolePowers(d, powers);
+
+                for (const MultipoleTerm& term : fmm_terms_m2m)
+                {
+                    multipoles[term.output] += term.factor * powers[term.shift] * child_multipoles[term.input];
+                }
+            }
+        }
+    });
+
+    // Local expansions of every node from its well separated sources
+    parallelFor(node_count, 16, [this, C](uint32_t begin, uint32_t end)
+    {
+        double derivatives[FMM_COEFFICIENT_MAX];
+
+        for (uint32_t node = begin; node < end; node++)
+        {
+            const TreeNode& target = tree_nodes[node];
+            double         *locals = &fmm_locals[static_cast<size_t>(node) * C];
+
+            for (uint32_t source_index : fmm_list_m2l[node])
+            {
+                const TreeNode& source     = tree_nodes[source_index];
+                const double   *multipoles = &fmm_multipoles[static_cast<size_t>(source_index) * C];
+                double          r[3]       = { target.com_mass[0] - source.com_mass[0], target.com_mass[1] - source.com_mass[1], target.com_mass[2] - source.com_mass[2] };
+
+                multipoleDerivatives(r, derivatives);
+
+                for (const MultipoleTerm& term : fmm_terms_m2l)
+                {
+                    locals[term.output] += term.factor * derivatives[term.shift] * multipoles[term.input];
+                }
+            }
+        }
+    });
+
+    // Downward pass. Parents shift their local expansions to their children
+    treeTopDown([this, C](uint32_t node)
+    {
+        const TreeNode& parent        = tree_nodes[node];
+        const double   *parent_locals = &fmm_locals[static_cast<size_t>(node) * C];
+        double          powers[FMM_COEFFICIENT_MAX];
+
+        if (!fmm_active[node] || multipoleLeaf(parent))
+        {
+            return;
+        }
+
+        for (uint32_t c = 0; c < parent.child_count; c++)
+        {
+            uint32_t        child_index = parent.child_first + c;
+            const TreeNode& child       = tree_nodes[child_index];
+            double         *locals      = &fmm_locals[static_cast<size_t>(child_index) * C];
+            double          d[3]        = { child.com_mass[0] - parent.com_mass[0], child.com_mass[1] - parent.com_mass[1], child.com_mass[2] - parent.com_mass[2] };
+
+            multipolePowers(d, powers);
+
+            for (const MultipoleTerm& term : fmm_terms_l2l)
+            {
+                locals[term.output] += term.factor * powers[term.shift] * parent_locals[term.input];
+            }
+        }
+    });
+
+    // Particles of the leaves take the gradient of the local expansion, and the pull of the neighbouring leaves directly
+    int   power_tenths = powerTenths(parameters.power);
+    float power        = parameters.power;
+    float eps2         = parameters.softening_squared;
+    float G_t_delta    = parameters.gravity_constant * parameters.time_step;
+
+    parallelFor(static_cast<uint32_t>(fmm_leaves.size()), 1, [&](uint32_t begin, uint32_t end)
+    {
+        double powers[FMM_COEFFICIENT_MAX];
+
+        for (uint32_t l = begin; l < end; l++)
+        {
+            uint32_t        node   = fmm_leaves[l];
+            const TreeNode& target = tree_nodes[node];
+            const double   *locals = &fmm_locals[static_cast<size_t>(node) * C];
+
+            for (uint32_t i = target.begin; i < target.end; i++)
+            {
+                double u[3]           = { tree_x[i] - target.com_mass[0], tree_y[i] - target.com_mass[1], tree_z[i] - target.com_mass[2] };
+                double acceleration[3] = { 0.0, 0.0, 0.0 };
+
+                multipolePowers(u, powers);
+
+                for (uint32_t k = 1; k < C; k++)
+                {
+                    for (uint32_t a = 0; a < 3; a++)
+                    {
+                        if (fmm_exponents[3 * k + a] > 0)
+                        {
+                            acceleration[a] += fmm_exponents[3 * k + a] * locals[k] * powers[fmm_minus_one[3 * k + a]];
+                        }
+                    }
+                }
+
+                float xyz_i[3]     = { tree_x[i], tree_y[i], tree_z[i] };
+                float near_field[3] = { 0.0f, 0.0f, 0.0f };
+
+                for (uint32_t source_index : fmm_list_p2p[node])
+                {
+                    const TreeNode& source = tree_nodes[source_index];
+
+                    for (uint32_t j = source.begin; j < source.end; j++)
+                    {
+                        float r[3] = { tree_x[j] - xyz_i[0], tree_y[j] - xyz_i[1], tree_z[j] - xyz_i[2] };
+                        float f    = tree_m[j] * powerInverse(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + eps2, power_tenths, power);
+
+                        near_field[0] += r[0] * f;
+                        near_field[1] += r[1] * f;
+                        near_field[2] += r[2] * f;
+                    }
+                }
+
+                uint32_t index = tree_keys[i].index;
+
+                vx[index] += static_cast<float>(acceleration[0] + near_field[0]) * G_t_delta;
+                vy[index] += static_cast<float>(acceleration[1] + near_field[1]) * G_t_delta;
+                vz[index] += static_cast<float>(acceleration[2] + near_field[2]) * G_t_delta;
+            }
+        }
+    });
+}
+
+
+void CpuEngine::parallelFor(uint32_t count, uint32_t chunk_size, const std::function<void(uint32_t, uint32_t)>& function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool_function   = function;
+        pool_count      = count;
+        pool_chunk_size = chunk_size;
+        pool_chunk_next = 0;
+        pool_busy       = static_cast<uint32_t>(workers.size());
+        pool_generation++;
+    }
+
+    pool_wake.notify_all();
+
+    chunksRun();
+
+    // The job may only be replaced once no worker reads it anymore
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    pool_done.wait(lock, [this]() { return pool_busy == 0; });
+}
+
+
+void CpuEngine::workerRun()
+{
+    uint64_t generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            pool_wake.wait(lock, [this, generation]() { return pool_stop || (pool_generation != generation); });
+
+            if (pool_stop)
+            {
+                return;
+            }
+
+            generation = pool_generation;
+        }
+
+        chunksRun();
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            pool_busy--;
+
+            if (pool_busy == 0)
+            {
+                pool_done.notify_one();
+            }
+        }
+    }
+}
+
+
+void CpuEngine::chunksRun()
+{
+    while (true)
+    {
+        uint32_t begin = pool_chunk_next.fetch_add(pool_chunk_size);
+
+        if (begin >= pool_count)
+        {
+            break;
+        }
+
+        pool_function(begin, std::min(begin + pool_chunk_size, pool_count));
+    }
+}
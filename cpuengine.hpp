@@ -0,0 +1,211 @@
+/*
+ * N-body engine on the CPU, for machines without a GPU and as a reference for the compute shaders. It takes the leapfrog step of
+ * nbody_leapfrog_step_one.comp and nbody_leapfrog_step_two.comp over a structure of arrays, vectorised with AVX-512 or AVX2 when
+ * the CPU supports them, and spread over a pool of threads. The kick is the all-pairs sum, a Barnes-Hut octree walk or the fast
+ * multipole method over the same octree.
+ * */
+
+#ifndef CPUENGINE_H
+#define CPUENGINE_H
+
+#include <QString>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "vulkanwindow.hpp"
+
+// With GCC and Clang the AVX2 and AVX-512 kernels are compiled for their instruction set whatever the build targets, and picked at
+// runtime. Other compilers only get the kernels of the instruction sets the build targets
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_ENGINE_DISPATCH
+#define CPU_ENGINE_AVX2
+#define CPU_ENGINE_AVX512
+#define CPU_ENGINE_TARGET(isa) __attribute__((target(isa)))
+#else
+#if defined(__AVX2__) && defined(__FMA__)
+#define CPU_ENGINE_AVX2
+#endif
+#if defined(__AVX512F__)
+#define CPU_ENGINE_AVX512
+#endif
+#define CPU_ENGINE_TARGET(isa)
+#endif
+
+class CpuEngine
+{
+public:
+    // Same as the uniforms of the compute shaders
+    struct Parameters
+    {
+        float gravity_constant  = 0.001;
+        float time_step         = 0.002f;
+        float softening_squared = 0.005;
+        float power             = 1.5;
+        float opening_angle     = 0.5;
+    };
+
+    // The first two are the same as those of the window
+    enum ForceSolver
+    {
+        FORCE_SOLVER_ALL_PAIRS  = 0,
+        FORCE_SOLVER_BARNES_HUT = 1,
+        FORCE_SOLVER_MULTIPOLE  = 2  // CPU only
+    };
+
+    enum InstructionSet
+    {
+        INSTRUCTION_SET_SCALAR,
+        INSTRUCTION_SET_AVX2,
+        INSTRUCTION_SET_AVX512
+    };
+
+    explicit CpuEngine(unsigned int thread_count = 0); // Zero uses every hardware thread
+    ~CpuEngine();
+
+    void setParameters(const Parameters& value);
+    void setParticles(const std::vector<VulkanWindow::Particle>& buffer);
+    void particles(std::vector<VulkanWindow::Particle>& buffer) const;
+    bool setInstructionSet(InstructionSet value); // False if the CPU does not support it, the kernel is then unchanged
+    void setForceSolver(ForceSolver value);
+    void setMultipoleOrder(uint32_t value);           // Order of the expansions, clamped to [1, 8]
+    void setMultipoleRebuildInterval(uint32_t value); // Steps between rebuilds of the tree and the interaction lists
+
+    // Kick and drift all particles by one time step
+    void step();
+
+    // RMS relative error of the velocity change of a kick against the all-pairs sum, over a sample of the particles. The particles
+    // are left as they were
+    double forceError(uint32_t sample_count);
+
+    static bool instructionSetSupported(InstructionSet value);
+
+    InstructionSet instructionSet() const;
+    QString instructionSetName() const;
+    ForceSolver forceSolver() const;
+    unsigned int threadCount() const;
+    uint32_t particleCount() const;
+
+private:
+    // Positions, masses and velocities as separate streams. The streams are padded to a multiple of the widest vector, so that the
+    // kick can load whole vectors of bodies. Padding bodies do not act on the others
+    std::vector<float> x, y, z, m;
+    std::vector<float> vx, vy, vz, vw;
+    uint32_t           particle_count = 0;
+
+    Parameters     parameters;
+    InstructionSet instruction_set;
+    ForceSolver    force_solver = FORCE_SOLVER_ALL_PAIRS;
+
+    // Velocity update of step one with the selected force solver
+    void kick();
+
+    // Velocity update of step one for the bodies in [begin, end), which are multiples of the vector width
+    void kickScalar(uint32_t begin, uint32_t end);
+#if defined(CPU_ENGINE_AVX2)
+    CPU_ENGINE_TARGET("avx2,fma") void kickAvx2(uint32_t begin, uint32_t end);
+#endif
+#if defined(CPU_ENGINE_AVX512)
+    CPU_ENGINE_TARGET("avx512f") void kickAvx512(uint32_t begin, uint32_t end);
+#endif
+
+    // Barnes-Hut octree, rebuilt every step. The particles are sorted by their Morton keys, and every node covers a contiguous
+    // range of the sorted particles. The children of a node are contiguous as well. The top levels are split breadth first until
+    // there is a subtree for every thread, then the subtrees are built and their moments accumulated in parallel
+    struct TreeNode
+    {
+        float    com_mass[4]; // Centre of mass and total mass
+        float    bbox_min[3];
+        float    bbox_max[3];
+        float    radius;      // Largest distance of the bounding box from the centre of mass
+        uint32_t child_first; // The root is no child, so zero marks a leaf along with child_count
+        uint32_t child_count;
+        uint32_t begin;       // Range of sorted particles
+        uint32_t end;
+    };
+
+    struct TreeKey
+    {
+        uint64_t key;   // 21 bits per axis
+        uint32_t index; // Particle
+    };
+
+    std::vector<TreeKey>                tree_keys;
+    std::vector<float>                  tree_x, tree_y, tree_z, tree_m; // Positions and masses in Morton order
+    std::vector<TreeNode>               tree_nodes;
+    std::vector<std::vector<TreeNode> > tree_subtrees;        // Built in parallel, then moved behind the top levels
+    std::vector<uint32_t>               tree_subtree_roots;   // Nodes of the top levels that the subtrees hang from
+    std::vector<uint32_t>               tree_subtree_offsets; // Node index of the subtree nodes is the offset plus their local index
+    std::vector<bool>                   tree_subtree_root;    // Per node of the top levels
+    uint32_t                            tree_top_count = 0;
+
+    void treeBuild();
+    void treeGather(); // Positions and masses in the order of the keys
+    void treeSplit(std::vector<TreeNode>& nodes, uint32_t node, uint32_t level) const;
+    void treeSubtreeBuild(std::vector<TreeNode>& nodes, uint32_t node, uint32_t level) const;
+    void treeMoments(uint32_t node);
+    void treeBottomUp(const std::function<void(uint32_t)>& visit); // Children before parents, subtrees in parallel
+    void treeTopDown(const std::function<void(uint32_t)>& visit);  // Parents before children, subtrees in parallel
+    void kickTree(uint32_t begin, uint32_t end); // Range of sorted particles
+
+    // Fast multipole method over the octree. The expansions are Cartesian Taylor series of the softened potential, truncated at
+    // a total order. The interaction lists come from a dual tree traversal and are kept for a number of steps, in which the tree
+    // keeps its nodes and only the moments follow the particles. Nodes below FMM_LEAF_SIZE particles act as leaves, the nodes
+    // below them are inactive
+    struct MultipoleTerm
+    {
+        uint32_t output;
+        uint32_t input;
+        uint32_t shift;  // Monomial of the translation, or derivative of M2L
+        double   factor; // Multi-index binomial coefficient
+    };
+
+    uint32_t                            fmm_order                 = 4;
+    uint32_t                            fmm_rebuild_interval      = 1;
+    uint32_t                            fmm_kicks_since_rebuild   = 0;
+    bool                                fmm_lists_valid           = false;
+    uint32_t                            fmm_coefficient_count     = 0;
+    std::vector<uint32_t>               fmm_exponents;     // Three per coefficient, graded by total order
+    std::vector<int32_t>                fmm_minus_one;     // Coefficient of the exponents minus one along each axis, or -1
+    std::vector<int32_t>                fmm_minus_two;     // Same, minus two
+    std::vector<MultipoleTerm>          fmm_terms_m2m;
+    std::vector<MultipoleTerm>          fmm_terms_m2l;
+    std::vector<MultipoleTerm>          fmm_terms_l2l;
+    std::vector<double>                 fmm_multipoles;    // fmm_coefficient_count per node
+    std::vector<double>                 fmm_locals;
+    std::vector<std::vector<uint32_t> > fmm_list_m2l;      // Well separated source nodes of each node
+    std::vector<std::vector<uint32_t> > fmm_list_p2p;      // Neighbouring leaves of each leaf
+    std::vector<std::vector<uint32_t> > fmm_list_pending;  // Source nodes handed down from the parent during the traversal
+    std::vector<uint8_t>                fmm_active;        // Per node, not below a leaf
+    std::vector<uint32_t>               fmm_leaves;
+
+    void multipoleTablesCreate();
+    void multipoleListsBuild();
+    void multipoleListsVisit(uint32_t node);
+    bool multipoleLeaf(const TreeNode& node) const;
+    void multipolePowers(const double d[3], double *powers) const;
+    void multipoleDerivatives(const double r[3], double *derivatives) const;
+    void kickMultipole();
+
+    // Thread pool. The calling thread takes part, and chunks of the range are handed out until none are left
+    void parallelFor(uint32_t count, uint32_t chunk_size, const std::function<void(uint32_t, uint32_t)>& function);
+    void workerRun();
+    void chunksRun();
+
+    std::vector<std::thread>                workers;
+    std::mutex                              pool_mutex;
+    std::condition_variable                 pool_wake;
+    std::condition_variable                 pool_done;
+    std::function<void(uint32_t, uint32_t)> pool_function;
+    std::atomic<uint32_t>                   pool_chunk_next;
+    uint32_t                                pool_count      = 0;
+    uint32_t                                pool_chunk_size = 1;
+    uint32_t                                pool_busy       = 0; // Workers still running the current job
+    uint64_t                                pool_generation = 0; // Incremented for every job
+    bool                                    pool_stop       = false;
+};
+
+#endif // CPUENGINE_H
@@ -1,8 +1,108 @@
 #include "mainwindow.hpp"
+#include "cpuengine.hpp"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+// Runs the simulation on the CPU engine without a window, so that it also works on machines without a GPU or display. Prints the
+// throughput for benchmarking
+int runCpuEngine(QCoreApplication& application)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("N-body simulation on the CPU");
+    parser.addHelpOption();
+
+    QCommandLineOption option_cpu("cpu", "Run on the CPU engine without a window.");
+    QCommandLineOption option_particles("particles", "Number of particles.", "count", "20000");
+    QCommandLineOption option_steps("steps", "Number of time steps.", "count", "100");
+    QCommandLineOption option_initial_condition("initial-condition", "Initial condition, as in the window.", "index", "1");
+    QCommandLineOption option_threads("threads", "Number of threads, zero uses every hardware thread.", "count", "0");
+    QCommandLineOption option_scalar("scalar", "Use the scalar kernel rather than AVX2 or AVX-512.");
+    QCommandLineOption option_force_solver("force-solver", "Force solver: 0 all pairs, 1 Barnes-Hut, 2 fast multipole method.", "index", "0");
+    QCommandLineOption option_opening_angle("opening-angle", "Opening angle of the Barnes-Hut tree walk and the multipole interactions.", "angle", "0.5");
+    QCommandLineOption option_multipole_order("multipole-order", "Order of the multipole expansions, 1 to 8.", "order", "4");
+    QCommandLineOption option_rebuild_interval("rebuild-interval", "Steps between rebuilds of the multipole interaction lists.", "count", "1");
+    QCommandLineOption option_error("error", "Report the force error against the all-pairs sum over this many particles.", "count", "0");
+
+    parser.addOption(option_cpu);
+    parser.addOption(option_particles);
+    parser.addOption(option_steps);
+    parser.addOption(option_initial_condition);
+    parser.addOption(option_threads);
+    parser.addOption(option_scalar);
+    parser.addOption(option_force_solver);
+    parser.addOption(option_opening_angle);
+    parser.addOption(option_multipole_order);
+    parser.addOption(option_rebuild_interval);
+    parser.addOption(option_error);
+    parser.process(application);
+
+    int particle_count = std::max(parser.value(option_particles).toInt(), 1);
+    int step_count     = std::max(parser.value(option_steps).toInt(), 0);
+
+    CpuEngine::Parameters parameters;
+    parameters.opening_angle = parser.value(option_opening_angle).toFloat();
+
+    std::vector<VulkanWindow::Particle> particles(particle_count);
+    VulkanWindow::initializeNbodies(particles, parser.value(option_initial_condition).toInt(), parameters.gravity_constant);
+
+    CpuEngine engine(static_cast<unsigned int>(std::max(parser.value(option_threads).toInt(), 0)));
+    engine.setParameters(parameters);
+    engine.setParticles(particles);
+    engine.setForceSolver(static_cast<CpuEngine::ForceSolver>(std::min(std::max(parser.value(option_force_solver).toInt(), 0), 2)));
+    engine.setMultipoleOrder(static_cast<uint32_t>(std::max(parser.value(option_multipole_order).toInt(), 1)));
+    engine.setMultipoleRebuildInterval(static_cast<uint32_t>(std::max(parser.value(option_rebuild_interval).toInt(), 1)));
+
+    if (parser.isSet(option_scalar))
+    {
+        engine.setInstructionSet(CpuEngine::INSTRUCTION_SET_SCALAR);
+    }
+
+    QTextStream out(stdout);
+    out << "Particles: " << particle_count << ", threads: " << engine.threadCount() << ", kernel: " << engine.instructionSetName() << "\n";
+    out.flush();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < step_count; i++)
+    {
+        engine.step();
+    }
+
+    double seconds = std::max(timer.nsecsElapsed() * 1.0e-9, 1.0e-9);
+
+    // The tree and multipole solvers evaluate far fewer interactions, so for them the rate is that of an all-pairs sum in the same time
+    QString interactions_label = (engine.forceSolver() == CpuEngine::FORCE_SOLVER_ALL_PAIRS) ? "interactions per second" : "all-pairs-equivalent interactions per second";
+
+    out << "Steps: " << step_count << ", seconds: " << seconds << ", steps per second: " << step_count / seconds
+        << ", " << interactions_label << ": " << static_cast<double>(particle_count) * particle_count * step_count / seconds << "\n";
+    out.flush();
+
+    int error_sample_count = parser.value(option_error).toInt();
+
+    if (error_sample_count > 0)
+    {
+        out << "Force error against the all-pairs sum: " << engine.forceError(static_cast<uint32_t>(error_sample_count)) << "\n";
+        out.flush();
+    }
+
+    return 0;
+}
+
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if (QString(argv[i]) == "--cpu")
+        {
+            QCoreApplication a(argc, argv);
+            return runCpuEngine(a);
+        }
+    }
+
     QApplication a(argc, argv);
     a.setWindowIcon(QIcon(":/doc/app.png"));
 
@@ -77,6 +77,21 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->horizontalSliderBloomExtent, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setBloomExtent(int)));
     connect(ui->comboBoxToneMappingMode, SIGNAL(currentIndexChanged(int)), vulkan_window, SLOT(setToneMappingMode(int)));
     connect(ui->doubleSpinBoxSoftening, SIGNAL(valueChanged(double)), vulkan_window, SLOT(setSoftening(double)));
+    connect(ui->comboBoxForceSolver, SIGNAL(currentIndexChanged(int)), vulkan_window, SLOT(setForceSolver(int)));
+    connect(ui->doubleSpinBoxOpeningAngle, SIGNAL(valueChanged(double)), vulkan_window, SLOT(setOpeningAngle(double)));
+    connect(ui->comboBoxMeshSize, SIGNAL(currentIndexChanged(int)), vulkan_window, SLOT(setMeshSize(int)));
+    connect(ui->comboBoxMeshAssignment, SIGNAL(currentIndexChanged(int)), vulkan_window, SLOT(setMeshAssignment(int)));
+    connect(ui->doubleSpinBoxMeshSplitScale, SIGNAL(valueChanged(double)), vulkan_window, SLOT(setMeshSplitScale(double)));
+    connect(ui->comboBoxIntegrator, SIGNAL(currentIndexChanged(int)), vulkan_window, SLOT(setIntegrator(int)));
+    connect(ui->spinBoxStepsPerSubmit, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setStepsPerSubmit(int)));
+    connect(ui->comboBoxForceKernel, SIGNAL(currentIndexChanged(int)), vulkan_window, SLOT(setForceKernel(int)));
+    connect(ui->spinBoxReorderInterval, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setReorderInterval(int)));
+    connect(ui->checkBoxMergeCollisions, SIGNAL(toggled(bool)), vulkan_window, SLOT(setCollisionMerging(bool)));
+    connect(ui->spinBoxForceSliceSize, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setForceSliceSize(int)));
+    connect(ui->spinBoxDiagnosticsInterval, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setDiagnosticsInterval(int)));
+    connect(ui->doubleSpinBoxEscapeRadius, SIGNAL(valueChanged(double)), vulkan_window, SLOT(setEscapeRadius(double)));
+    connect(ui->spinBoxEnsembleCount, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setEnsembleCount(int)));
+    connect(ui->spinBoxOutOfCoreBlockSize, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setOutOfCoreBlockSize(int)));
     connect(ui->horizontalSliderExposure, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setExposure(int)));
     connect(ui->horizontalSliderGamma, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setGamma(int)));
     connect(ui->spinBoxParticleCount, SIGNAL(valueChanged(int)), vulkan_window, SLOT(setParticleCount(int)));
@@ -9,6 +9,9 @@ unix: QT += x11extras
 
 CONFIG += c++11
 
+# The CPU engine picks its AVX2 or AVX-512 kernel at runtime, so this only tunes the rest of the code to the build machine
+#unix: QMAKE_CXXFLAGS += -march=native
+
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = nbody
@@ -31,6 +34,7 @@ SOURCES += main.cpp\
     mainwindow.cpp \
     common.cpp \
     vulkanwindow.cpp \
+    cpuengine.cpp \
     vulkanbase.cpp \
     vulkantextureloader.cpp
 
@@ -39,6 +43,7 @@ HEADERS  += BUILD_OPTIONS.h \
     common.hpp \
     platform.hpp \
     vulkanwindow.hpp \
+    cpuengine.hpp \
     include/ccmatrix.hpp \
     include/matrix.hpp \
     include/rotationmatrix.hpp \
@@ -53,8 +58,35 @@ DISTFILES += \
     shaders/nbody.frag \
     shaders/gaussblur.vert \
     shaders/nbody.vert \
+    shaders/nbody_common.glsl \
     shaders/nbody_leapfrog_step_one.comp \
+    shaders/nbody_leapfrog_step_one_half.comp \
+    shaders/nbody_leapfrog_step_one_broadcast.comp \
+    shaders/nbody_leapfrog_symmetric.comp \
     shaders/nbody_leapfrog_step_two.comp \
+    shaders/nbody_leapfrog_fused.comp \
+    shaders/nbody_leapfrog_ensemble.comp \
+    shaders/nbody_leapfrog_stream.comp \
+    shaders/nbody_hermite_predict.comp \
+    shaders/nbody_hermite_evaluate.comp \
+    shaders/nbody_hermite_correct.comp \
+    shaders/nbody_yoshida_drift.comp \
+    shaders/nbody_yoshida_kick.comp \
+    shaders/nbody_tree_bounds.comp \
+    shaders/nbody_tree_morton.comp \
+    shaders/nbody_tree_sort.comp \
+    shaders/nbody_tree_build.comp \
+    shaders/nbody_tree_moments.comp \
+    shaders/nbody_tree_walk.comp \
+    shaders/nbody_pm.comp \
+    shaders/nbody_pm_fft.comp \
+    shaders/nbody_reorder.comp \
+    shaders/nbody_collision.comp \
+    shaders/nbody_compact.comp \
+    shaders/nbody_block_select.comp \
+    shaders/nbody_block_kick.comp \
+    shaders/nbody_block_drift.comp \
+    shaders/nbody_energy.comp \
     shaders/normal_texture.frag \
     shaders/normal_texture.vert \
     shaders/tone_mapping.frag \
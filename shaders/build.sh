@@ -1,5 +1,6 @@
 # A simple script for building SPIR-V binaries from glsl shader files. Requires glslangValidator.exe to be accessible.
+# Shared definitions are in .glsl files, which are included by the shaders rather than built on their own.
 
 for i in *.{vert,geom,frag,comp}; do
-    glslangValidator.exe -V $i -o $i.spv
+    glslangValidator.exe -V -I. $i -o $i.spv
 done
@@ -0,0 +1,52 @@
+/*
+ * Definitions shared by the N-body compute shaders, included after the uniform block. The first members of the uniform block
+ * are the same in every shader, see VulkanWindow::ubo_nbody_compute.
+ * */
+
+// The particle buffers are a structure of arrays: the positions and masses of all particles, their velocities, then their ids
+
+// Velocities follow the positions and masses of all particles
+uint velocityIndex(uint index)
+{
+    return ubo.particle_count + index;
+}
+
+// Ids follow the velocities, in units of uint
+uint idIndex(uint index)
+{
+    return 8 * ubo.particle_count + index;
+}
+
+layout (constant_id = 4) const uint POWER_TENTHS = 15; // Force law exponent times ten, see setPower()
+
+// s^-power. The common exponents avoid pow()
+float powerInverse(float s, float power)
+{
+    if (power == 1.5)
+    {
+        float s_inv_sqrt = inversesqrt(s);
+        return s_inv_sqrt * s_inv_sqrt * s_inv_sqrt;
+    }
+    else if (power == 1.0)
+    {
+        return 1.0 / s;
+    }
+    else if (power == 2.0)
+    {
+        float s_inv = 1.0 / s;
+        return s_inv * s_inv;
+    }
+
+    return pow(s, -power);
+}
+
+// s^-power with the exponent fixed when the pipeline is created, so that the branches above are resolved by the driver
+float powerInverse(float s)
+{
+    return powerInverse(s, float(POWER_TENTHS) / 10.0);
+}
+
+vec3 bodyBodyInteraction(vec3 r, float m_j)
+{
+    return r * m_j * powerInverse(dot(r,r) + ubo.eps2);
+}
@@ -1,6 +1,9 @@
 #include "vulkanwindow.hpp"
 
 #include <QGuiApplication>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileInfo>
 
 #ifdef VK_USE_PLATFORM_XCB_KHR
 #include <QX11Info>
@@ -75,11 +78,7 @@ VulkanWindow::~VulkanWindow()
     vkDestroyBuffer(vkbase.device(), uniform_performance_graphics.buffer, nullptr);
     vkFreeMemory(vkbase.device(), uniform_performance_graphics.memory, nullptr);
 
-    vkDestroyBuffer(vkbase.device(), buffer_nbody_compute.buffer, nullptr);
-    vkFreeMemory(vkbase.device(), buffer_nbody_compute.memory, nullptr);
-
-    vkDestroyBuffer(vkbase.device(), buffer_nbody_draw.buffer, nullptr);
-    vkFreeMemory(vkbase.device(), buffer_nbody_draw.memory, nullptr);
+    destroyBuffersNbody();
 
     delete vulkan_helper;
 
@@ -99,6 +98,7 @@ void VulkanWindow::initialize()
     query_timestamp_graphics_tone_map.resize(2);
     query_timestamp_compute_leapfrog_step_1.resize(2);
     query_timestamp_compute_leapfrog_step_2.resize(2);
+    query_timestamp_compute_mesh.resize(2);
 
     // Initial values
     camera_matrix.setN(0.1);
@@ -196,6 +196,15 @@ void VulkanWindow::setGravitationalConstant(double value)
 {
     ubo_nbody_compute.gravity_constant = value;
     uniformBuffersUpdate();
+
+    for (EnsembleSystem &system : ensemble_systems)
+    {
+        system.gravity_constant = value;
+    }
+
+    ensembleSystemsUpdate();
+
+    energy_initial_valid = false;
 }
 
 
@@ -203,6 +212,15 @@ void VulkanWindow::setSoftening(double value)
 {
     ubo_nbody_compute.softening_squared = value;
     uniformBuffersUpdate();
+
+    for (EnsembleSystem &system : ensemble_systems)
+    {
+        system.softening_squared = value;
+    }
+
+    ensembleSystemsUpdate();
+
+    energy_initial_valid = false;
 }
 
 
@@ -211,6 +229,13 @@ void VulkanWindow::setTimeStep(double value)
     ubo_nbody_compute.time_step  = value;
     ubo_nbody_graphics.time_step = value;
     uniformBuffersUpdate();
+
+    for (EnsembleSystem &system : ensemble_systems)
+    {
+        system.time_step = value;
+    }
+
+    ensembleSystemsUpdate();
 }
 
 
@@ -234,9 +259,50 @@ void VulkanWindow::setParticleCount(int value)
 }
 
 
+void VulkanWindow::setEnsembleCount(int value)
+{
+    initialization_ensemble_count = static_cast<uint32_t>(std::max(value, 1));
+}
+
+
+void VulkanWindow::setOutOfCoreBlockSize(int value)
+{
+    initialization_stream_block_size = static_cast<uint32_t>(std::max(value, 0));
+}
+
+
+void VulkanWindow::setEnsembleSystem(int index, double gravity_constant, double softening_squared, double time_step, double power)
+{
+    // For parameter studies. The force law exponent of a system is not compiled into the ensemble pipelines
+    if ((index < 0) || (index >= ensemble_systems.size()))
+    {
+        qWarning("Ensemble system %d does not exist", index);
+        return;
+    }
+
+    ensemble_systems[index].gravity_constant  = gravity_constant;
+    ensemble_systems[index].softening_squared = softening_squared;
+    ensemble_systems[index].time_step         = time_step;
+    ensemble_systems[index].power             = power;
+    ensembleSystemsUpdate();
+
+    energy_initial_valid = false;
+}
+
+
+void VulkanWindow::ensembleSystemsUpdate()
+{
+    if (buffer_ensemble_systems.mapped != nullptr)
+    {
+        std::memcpy(buffer_ensemble_systems.mapped, ensemble_systems.data(), ensemble_systems.size() * sizeof(EnsembleSystem));
+    }
+}
+
+
 void VulkanWindow::setParticleSize(int value)
 {
     ubo_nbody_graphics.particle_size = static_cast<float>(value);
+    ubo_nbody_compute.collision_radius = 0.05 * ubo_nbody_graphics.particle_size * 0.05; // See nbody.vert
     uniformBuffersUpdate();
 }
 
@@ -245,6 +311,38 @@ void VulkanWindow::setPower(int value)
 {
     ubo_nbody_compute.power = static_cast<float>(value) * 0.1;
     uniformBuffersUpdate();
+
+    for (EnsembleSystem &system : ensemble_systems)
+    {
+        system.power = ubo_nbody_compute.power;
+    }
+
+    ensembleSystemsUpdate();
+
+    energy_initial_valid = false;
+
+    if (static_cast<uint32_t>(value) == specialization_nbody.power_tenths)
+    {
+        return;
+    }
+
+    // The exponent is compiled into the compute pipelines. Pipelines built before are found in the pipeline cache
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
+    specialization_nbody.power_tenths = static_cast<uint32_t>(value);
+
+    pipelinesComputeDestroy();
+    pipelinesComputeCreate();
+    commandBuffersComputeRecord();
+
+    if (!paused)
+    {
+        compute_timer->start();
+    }
 }
 
 
@@ -254,36 +352,62 @@ void VulkanWindow::setInitialCondition(int value)
 }
 
 
-void VulkanWindow::launch()
+void VulkanWindow::setForceSolver(int value)
 {
-    bool paused = true;
-
-    if (compute_timer->isActive())
+    if (value == force_solver)
     {
-        paused = false;
+        return;
     }
 
-    graphics_timer->stop();
+    bool paused = !compute_timer->isActive();
+
     compute_timer->stop();
 
     HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
-    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
 
-    descriptorPoolReset();
+    force_solver = value;
+    commandBuffersComputeRecord();
 
-    vkDestroyBuffer(vkbase.device(), buffer_nbody_compute.buffer, nullptr);
-    vkFreeMemory(vkbase.device(), buffer_nbody_compute.memory, nullptr);
+    if (integratorHermite())
+    {
+        integratorHermiteInitialize();
+    }
 
-    vkDestroyBuffer(vkbase.device(), buffer_nbody_draw.buffer, nullptr);
-    vkFreeMemory(vkbase.device(), buffer_nbody_draw.memory, nullptr);
+    if (!paused)
+    {
+        compute_timer->start();
+    }
+}
 
-    generateBuffersNbody();
-    descriptorSetsAllocate();
-    descriptorSetsUpdate();
+
+void VulkanWindow::setOpeningAngle(double value)
+{
+    ubo_nbody_compute.opening_angle = value;
+    uniformBuffersUpdate();
+}
+
+
+void VulkanWindow::setIntegrator(int value)
+{
+    if (value == integrator)
+    {
+        return;
+    }
+
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
+    integrator = value;
     commandBuffersComputeRecord();
-    commandBuffersGraphicsRecord();
 
-    graphics_timer->start();
+    if (integratorHermite())
+    {
+        integratorHermiteInitialize();
+    }
+
     if (!paused)
     {
         compute_timer->start();
@@ -291,3565 +415,5628 @@ void VulkanWindow::launch()
 }
 
 
-void VulkanWindow::pauseCompute(bool value)
+void VulkanWindow::setStepsPerSubmit(int value)
 {
-    if (value)
+    if (static_cast<uint32_t>(value) == steps_per_submit)
     {
-        compute_timer->stop();
+        return;
     }
-    else
+
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
+    steps_per_submit = static_cast<uint32_t>(std::max(value, 1));
+    commandBuffersComputeRecord();
+
+    if (!paused)
     {
         compute_timer->start();
     }
 }
 
 
-void VulkanWindow::pauseAll(bool value)
+void VulkanWindow::setForceKernel(int value)
 {
-    if (value)
+    if (value == force_kernel)
     {
-        compute_timer->stop();
-        graphics_timer->stop();
-
-        HANDLE_VK_RESULT(vkDeviceWaitIdle(vkbase.device()));
+        return;
     }
-    else
+
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
+    force_kernel = value;
+    commandBuffersComputeRecord();
+
+    // The force changes slightly with the precision of the kernel, so compare against a new reference
+    energy_initial_valid = false;
+
+    if (!paused)
     {
         compute_timer->start();
-        graphics_timer->start();
     }
 }
 
 
-void VulkanWindow::setMouseSensitivity(int value)
+void VulkanWindow::setReorderInterval(int value)
 {
-    mouse_sensitivity = static_cast<double>(value * 0.01);
+    reorder_interval    = static_cast<uint32_t>(std::max(value, 0));
+    steps_since_reorder = 0;
 }
 
 
-void VulkanWindow::setExposure(int value)
+void VulkanWindow::setDiagnosticsInterval(int value)
 {
-    ubo_tone_mapping.exposure = static_cast<float>(value) / 20.0;
-    uniformBuffersUpdate();
+    diagnostics_interval    = static_cast<uint32_t>(std::max(value, 0));
+    steps_since_diagnostics = 0;
 }
 
 
-void VulkanWindow::setGamma(int value)
+void VulkanWindow::setForceSliceSize(int value)
 {
-    ubo_tone_mapping.gamma = static_cast<float>(value) / 30.0;
-    uniformBuffersUpdate();
+    if (static_cast<uint32_t>(value) == force_slice_size)
+    {
+        return;
+    }
+
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
+    // A step in progress starts over from its first slice
+    force_slice_size = static_cast<uint32_t>(std::max(value, 0));
+    force_slice      = 0;
+    commandBuffersComputeRecord();
+
+    if (!paused)
+    {
+        compute_timer->start();
+    }
 }
 
 
-void VulkanWindow::setToneMappingMode(int value)
+void VulkanWindow::setEscapeRadius(double value)
 {
-    ubo_tone_mapping.tone_mapping_method = value;
+    bool enabled = ubo_nbody_compute.escape_radius > 0.0f;
+
+    ubo_nbody_compute.escape_radius = std::max(value, 0.0);
+
+    if (enabled == (ubo_nbody_compute.escape_radius > 0.0f))
+    {
+        uniformBuffersUpdate();
+        return;
+    }
+
+    // The escape pass is recorded into the steps
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
     uniformBuffersUpdate();
+    commandBuffersComputeRecord();
+
+    if (!paused)
+    {
+        compute_timer->start();
+    }
 }
 
 
-void VulkanWindow::update()
+void VulkanWindow::setMeshSize(int value)
 {
-    queueGraphicsSubmit();
+    // Index of 16, 32, 64 and 128 cells per axis. Applied on launch, since the mesh buffers are sized for it
+    initialization_mesh_size = 16u << std::min(std::max(value, 0), 3);
 }
 
 
-void VulkanWindow::createFpsString()
+void VulkanWindow::setMeshAssignment(int value)
 {
-    double time_elapsed_graphics = 0;
-    double time_elapsed_compute  = 0;
+    ubo_nbody_compute.mesh_assignment = static_cast<uint32_t>(std::min(std::max(value, 0), 2));
+    uniformBuffersUpdate();
+}
 
-    for (int i = 0; i < p_fps_stack.size(); i++)
+
+void VulkanWindow::setMeshSplitScale(double value)
+{
+    ubo_nbody_compute.mesh_split_scale = static_cast<float>(std::max(value, 0.1));
+    uniformBuffersUpdate();
+}
+
+
+void VulkanWindow::setCollisionMerging(bool value)
+{
+    if (value == collision_merging)
     {
-        time_elapsed_graphics += p_fps_stack[i];
+        return;
     }
 
-    for (int i = 0; i < p_cps_stack.size(); i++)
+    bool paused = !compute_timer->isActive();
+
+    compute_timer->stop();
+
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+
+    collision_merging = value;
+    commandBuffersComputeRecord();
+
+    if (!paused)
     {
-        time_elapsed_compute += p_cps_stack[i];
+        compute_timer->start();
     }
-
-    emit fpsStringChanged("Qt+Vulkan N-body simulation - [fps: " +
-                          QString::number(static_cast<double> (p_fps_stack.size()) / (time_elapsed_graphics * 1.0e-9), 'f', 0) + " @ " +
-                          QString("%1").arg(time_total_graphics / 1.0e6, -4, 'g', 3, QLatin1Char('0')) + " ms] - [cps: " +
-                          QString::number(static_cast<double> (p_cps_stack.size()) / (time_elapsed_compute * 1.0e-9), 'f', 0) + " @ " +
-                          QString("%1").arg(time_total_compute / 1.0e6, -4, 'g', 3, QLatin1Char('0')) + " ms]");
 }
 
 
-void VulkanWindow::queueComputeSubmit()
+void VulkanWindow::particlesCompact()
 {
-    // Submit the first compute step
-    {
-        // Ensure that the previous invocation has finished
-        {
-            VkResult result = vkGetFenceStatus(vkbase.device(), fence_compute_step_1);
+    // Merged and escaped bodies have no mass. A prefix sum over the remaining bodies gives their positions, at which they are
+    // scattered into the next slot in their current order. This changes the layout of all particle buffers, so only the new slot
+    // is valid afterwards and everything depending on the count is recorded anew. Requires the compute queue to be idle
+    CollisionStatistics *statistics = static_cast<CollisionStatistics *>(buffer_collision_statistics.mapped);
 
-            switch (result)
-            {
-            case VK_NOT_READY:
-                // Wait for vertex buffer
-                HANDLE_VK_RESULT(vkWaitForFences(vkbase.device(), 1, &fence_compute_step_1, VK_TRUE, 1e9));
-                break;
+    uint32_t nbody_slot_write   = (nbody_slot_compute + 1) % NBODY_BUFFER_COUNT;
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_compaction[0])));
 
-            default:
-                HANDLE_VK_RESULT(result);
-                break;
-            }
-        }
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
 
-        // Poll timers
-        {
-            VkResult result = vkGetQueryPoolResults(vkbase.device(), query_pool_compute, 0, 2, sizeof(QueryResult) * 2, query_timestamp_compute_leapfrog_step_1.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-            switch (result)
-            {
-            case VK_NOT_READY:
-                break;
+    VkMemoryBarrier host_barrier = {};
+    host_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    host_barrier.pNext         = nullptr;
+    host_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
 
-            default:
-                HANDLE_VK_RESULT(result);
+    VkCommandBuffer command_buffer = commandBufferCreate();
 
-                float time_step_1 = static_cast<double>(query_timestamp_compute_leapfrog_step_1[1].time - query_timestamp_compute_leapfrog_step_1[0].time);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_compaction, 0, 1, &descriptor_compaction[nbody_slot_compute], 0, 0);
 
-                ubo_performance_meter_compute.process_count = 2;
-                ubo_performance_meter_compute.positions[0]  = time_step_1;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_compaction[1]);
+    vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
 
-                break;
-            }
-        }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
 
-        HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_compute_step_1));
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_compaction[2]);
+    vkCmdDispatch(command_buffer, 1, 1, 1);
 
-        VkSubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.pNext = nullptr;
-        submit_info.commandBufferCount   = 1;
-        submit_info.pCommandBuffers      = &command_buffer_compute_step_1;
-        submit_info.pSignalSemaphores    = &semaphore_compute_step_1_complete;
-        submit_info.signalSemaphoreCount = 1;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
 
-        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute_step_1));
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_compaction[3]);
+    vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
 
-        // Enable to enforce syncing with the graphics queue
-        if (0)
-        {
-            vkQueueWaitIdle(vkbase.computeQueue());
-        }
-    }
+    commandBufferPublishRecord(command_buffer, nbody_slot_write);
 
-    // Check fence to ensure vertex buffer is not being read from
-    {
-        VkResult result = vkGetFenceStatus(vkbase.device(), fence_draw);
+    // The host takes the new particle count from the prefix sum
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
 
-        switch (result)
-        {
-        case VK_NOT_READY:
-            // Wait for vertex buffer
-            HANDLE_VK_RESULT(vkWaitForFences(vkbase.device(), 1, &fence_draw, VK_TRUE, 1e9));
-            break;
+    commandBufferSubmitAndFree(command_buffer);
 
-        default:
-            HANDLE_VK_RESULT(result);
-            break;
-        }
+    uint32_t particle_count = statistics->remaining_count;
 
-        // Poll timers
-        {
-            VkResult result = vkGetQueryPoolResults(vkbase.device(), query_pool_compute, 2, 2, sizeof(QueryResult) * 2, query_timestamp_compute_leapfrog_step_2.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    ubo_nbody_compute.particle_count = particle_count;
+    uniformBuffersUpdate();
 
-            switch (result)
-            {
-            case VK_NOT_READY:
-                break;
+    tree_sort_count = 2;
+    while (tree_sort_count < particle_count)
+    {
+        tree_sort_count <<= 1;
+    }
 
-            default:
-                HANDLE_VK_RESULT(result);
-                float time_step_2 = static_cast<double>(query_timestamp_compute_leapfrog_step_2[1].time - query_timestamp_compute_leapfrog_step_2[0].time);
+    statistics->removed_count = 0;
 
-                ubo_performance_meter_compute.positions[1] = time_step_2;
+    nbody_slot_compute   = nbody_slot_write;
+    nbody_slot_published = nbody_slot_write;
+    nbody_slot_drawing   = nbody_slot_write;
 
-                float time_total = ubo_performance_meter_compute.positions[0] + ubo_performance_meter_compute.positions[1];
-                ubo_performance_meter_compute.positions[0] /= time_total;
-                ubo_performance_meter_compute.positions[1] /= time_total;
-                ubo_performance_meter_compute.positions[2]  = time_total;
-            }
-        }
+    commandBuffersComputeRecord();
+    commandBuffersGraphicsRecord();
 
-        // Computations per second (cps)
-        p_cps_stack.enqueue(cps_timer.nsecsElapsed());
-        if (p_cps_stack.size() > 100)
-        {
-            p_cps_stack.dequeue();
-        }
-        cps_timer.restart();
+    if (integratorHermite())
+    {
+        integratorHermiteInitialize();
     }
+}
 
-    // Submit the second compute step and transfer operation
-    {
-        // Ensure that the previous invocation has finished
-        {
-            VkResult result = vkGetFenceStatus(vkbase.device(), fence_transfer);
 
-            switch (result)
-            {
-            case VK_NOT_READY:
-                // Wait for vertex buffer
-                HANDLE_VK_RESULT(vkWaitForFences(vkbase.device(), 1, &fence_transfer, VK_TRUE, 1e9));
-                break;
+bool VulkanWindow::integratorFused() const
+{
+    // The fused kernel only implements the all-pairs force
+    return (integrator == INTEGRATOR_LEAPFROG_FUSED) && (force_solver == FORCE_SOLVER_ALL_PAIRS) && !integratorEnsemble() && !integratorOutOfCore();
+}
 
-            default:
-                HANDLE_VK_RESULT(result);
-                break;
-            }
-        }
 
-        HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_transfer));
+bool VulkanWindow::integratorBlock() const
+{
+    // The block kick only implements the all-pairs force
+    return (integrator == INTEGRATOR_LEAPFROG_BLOCK) && (force_solver == FORCE_SOLVER_ALL_PAIRS) && !integratorEnsemble() && !integratorOutOfCore();
+}
 
-        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-        VkSubmitInfo         submit_info         = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.pNext = nullptr;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers    = &command_buffer_compute_step_2;
-        submit_info.pWaitSemaphores    = &semaphore_compute_step_1_complete;
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitDstStageMask  = &wait_dst_stage_mask;
 
-        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_transfer));
-    }
+bool VulkanWindow::integratorHermite() const
+{
+    // The jerk is only computed by the all-pairs force
+    return (integrator == INTEGRATOR_HERMITE) && (force_solver == FORCE_SOLVER_ALL_PAIRS) && !integratorEnsemble() && !integratorOutOfCore();
 }
 
 
-void VulkanWindow::focusOutEvent(QFocusEvent *ev)
+bool VulkanWindow::integratorYoshida() const
 {
-    p_key_w_active     = false;
-    p_key_a_active     = false;
-    p_key_s_active     = false;
-    p_key_d_active     = false;
-    p_key_q_active     = false;
-    p_key_e_active     = false;
-    p_key_ctrl_active  = false;
-    p_key_shift_active = false;
-    p_key_space_active = false;
+    // The in-place kicks only implement the all-pairs force
+    return (integrator == INTEGRATOR_YOSHIDA) && (force_solver == FORCE_SOLVER_ALL_PAIRS) && !integratorEnsemble() && !integratorOutOfCore();
 }
 
 
-void VulkanWindow::queueGraphicsSubmit()
+bool VulkanWindow::integratorSliced() const
 {
-    // Update view matrices
-    passiveMove();
-
-    // Aquire the index of the currently active image
-    uint32_t buffer_index;
-    VkResult result = vkAcquireNextImageKHR(vkbase.device(), swapchain, UINT64_MAX, semaphore_present_complete, VK_NULL_HANDLE, &buffer_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
-    {
-        swapChainRecreate();
-        return;
-    }
-    else
-    {
-        HANDLE_VK_RESULT(result);
-    }
+    // Only the tiled, half and broadcast kernels of the plain two-pass leapfrog step take a work group offset
+    return (force_slice_size > 0) && !integratorBatched() && (force_solver == FORCE_SOLVER_ALL_PAIRS) && (force_kernel != FORCE_KERNEL_SYMMETRIC) && !integratorEnsemble() && !integratorOutOfCore();
+}
 
-    // Submit post present cb if present complete
-    {
-        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        VkSubmitInfo         info = {};
-        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        info.pNext = nullptr;
-        info.commandBufferCount   = 1;
-        info.pWaitDstStageMask    = &wait_dst_stage_mask;
-        info.waitSemaphoreCount   = 1;
-        info.pWaitSemaphores      = &semaphore_present_complete;
-        info.signalSemaphoreCount = 1;
-        info.pSignalSemaphores    = &semaphore_post_present_complete;
-        info.pCommandBuffers      = &command_buffer_post_present[buffer_index];
 
-        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &info, VK_NULL_HANDLE));
-    }
+bool VulkanWindow::integratorEnsemble() const
+{
+    // Ensembles take the plain leapfrog step with their own kick and drift, whatever the force solver and integrator
+    return ubo_nbody_compute.ensemble_count > 1;
+}
 
-    // Submit the draw cb
-    {
-        // Check fence to ensure vertex data buffer is not being written to
-        {
-            VkResult result = vkGetFenceStatus(vkbase.device(), fence_transfer);
 
-            switch (result)
-            {
-            case VK_NOT_READY:
-                // Wait for vertex buffer
-                HANDLE_VK_RESULT(vkWaitForFences(vkbase.device(), 1, &fence_transfer, VK_TRUE, 1e9));
-                break;
+bool VulkanWindow::integratorOutOfCore() const
+{
+    // Out-of-core and segmented steps stream the all-pairs force of the plain leapfrog step, whatever the force solver and integrator
+    return stream_block_size > 0;
+}
 
-            default:
-                HANDLE_VK_RESULT(result);
-                break;
-            }
-        }
 
-        HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_draw));
+uint32_t VulkanWindow::forceSliceCount() const
+{
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0] * specialization_nbody.bodies_per_thread)));
 
-        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-        VkSubmitInfo         info = {};
-        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        info.pNext = nullptr;
-        info.commandBufferCount   = 1;
-        info.pWaitDstStageMask    = &wait_dst_stage_mask;
-        info.waitSemaphoreCount   = 1;
-        info.pWaitSemaphores      = &semaphore_post_present_complete;
-        info.signalSemaphoreCount = 1;
-        info.pSignalSemaphores    = &semaphore_draw_complete;
-        info.pCommandBuffers      = &command_buffer_draw[buffer_index];
+    return (work_group_count_x + force_slice_size - 1) / force_slice_size;
+}
 
-        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &info, fence_draw));
-    }
-    // Submit pre present cb when draw cb complete
-    {
-        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        VkSubmitInfo         info = {};
-        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        info.pNext = nullptr;
-        info.commandBufferCount   = 1;
-        info.pWaitDstStageMask    = &wait_dst_stage_mask;
-        info.waitSemaphoreCount   = 1;
-        info.pWaitSemaphores      = &semaphore_draw_complete;
-        info.signalSemaphoreCount = 1;
-        info.pSignalSemaphores    = &semaphore_pre_present_complete;
-        info.pCommandBuffers      = &command_buffer_pre_present[buffer_index];
 
-        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &info, VK_NULL_HANDLE));
-    }
+bool VulkanWindow::integratorBatched() const
+{
+    // Everything but the plain two-pass leapfrog step is recorded into the single batch command buffer. Out-of-core steps have their own
+    return !integratorOutOfCore() && (integratorFused() || integratorBlock() || integratorHermite() || integratorYoshida() || (steps_per_submit > 1));
+}
 
-    {
-        // Present the current image to the swap chain
-        VkPresentInfoKHR info = {};
-        info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        info.pNext = nullptr;
-        info.waitSemaphoreCount = 1;
-        info.pWaitSemaphores    = &semaphore_pre_present_complete;
-        info.swapchainCount     = 1;
-        info.pSwapchains        = &swapchain;
-        info.pImageIndices      = &buffer_index;
-        info.pResults           = nullptr;
 
-        result = vkQueuePresentKHR(vkbase.graphicsQueue(), &info);
-        if (result == VK_SUBOPTIMAL_KHR)
-        {
-            swapChainRecreate();
-            return;
-        }
-        else
-        {
-            HANDLE_VK_RESULT(result);
-        }
-    }
+void VulkanWindow::integratorHermiteInitialize()
+{
+    // The Hermite predictor needs the acceleration and jerk of the previous step. Evaluate them for the current state,
+    // which is then both the previous and the current step. Requires the compute queue to be idle
+    VkCommandBuffer command_buffer = commandBufferCreate();
 
-    // Fps
-    p_fps_stack.enqueue(fps_timer.nsecsElapsed());
-    if (p_fps_stack.size() > 100)
-    {
-        p_fps_stack.dequeue();
-    }
-    fps_timer.restart();
+    commandBufferHermiteInitializeRecord(command_buffer, descriptor_leapfrog_from_scratch[nbody_slot_compute]);
 
-    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
+    commandBufferSubmitAndFree(command_buffer);
+}
 
-    // Poll timers and submit performance metrics
-    {
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 0, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_scene.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 2, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_brightness.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 4, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_blur_alpha.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 6, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_blur_beta.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 8, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_combine.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 10, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_tone_map.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
-        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 12, 2, sizeof(QueryResult) * 2, query_timestamp_graphics.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
 
-        float time_scene      = static_cast<double>(query_timestamp_graphics_scene[1].time - query_timestamp_graphics_scene[0].time);
-        float time_brightness = static_cast<double>(query_timestamp_graphics_brightness[1].time - query_timestamp_graphics_brightness[0].time);
-        float time_blur_alpha = static_cast<double>(query_timestamp_graphics_blur_alpha[1].time - query_timestamp_graphics_blur_alpha[0].time);
-        float time_blur_beta  = static_cast<double>(query_timestamp_graphics_blur_beta[1].time - query_timestamp_graphics_blur_beta[0].time);
-        float time_combine    = static_cast<double>(query_timestamp_graphics_combine[1].time - query_timestamp_graphics_combine[0].time);
-        float time_tone_map   = static_cast<double>(query_timestamp_graphics_tone_map[1].time - query_timestamp_graphics_tone_map[0].time);
-        time_total_graphics = static_cast<double>(query_timestamp_graphics[1].time - query_timestamp_graphics[0].time);
-        float time_overhead = time_total_graphics - time_scene - time_brightness - time_blur_alpha - time_blur_beta - time_combine - time_tone_map;
+void VulkanWindow::commandBufferHermiteInitializeRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog)
+{
+    // Evaluates the derivatives for the destination particles of the set and copies them to those of the previous step
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_hermite_evaluate);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
 
-        ubo_performance_meter_graphics.process_count = 7;
-        ubo_performance_meter_graphics.positions[0]  = time_scene / time_total_graphics;
-        ubo_performance_meter_graphics.positions[1]  = time_brightness / time_total_graphics;
-        ubo_performance_meter_graphics.positions[2]  = time_blur_alpha / time_total_graphics;
-        ubo_performance_meter_graphics.positions[3]  = time_blur_beta / time_total_graphics;
-        ubo_performance_meter_graphics.positions[4]  = time_combine / time_total_graphics;
-        ubo_performance_meter_graphics.positions[5]  = time_tone_map / time_total_graphics;
-        ubo_performance_meter_graphics.positions[6]  = time_overhead / time_total_graphics;
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0])));
+    vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
 
-        time_total_compute = ubo_performance_meter_compute.positions[2];
+    VkMemoryBarrier barrier = {};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext         = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-        if (time_total_compute > time_total_graphics)
-        {
-            ubo_performance_meter_compute.relative_size  = 1.0;
-            ubo_performance_meter_graphics.relative_size = time_total_graphics / time_total_compute;
-        }
-        else
-        {
-            ubo_performance_meter_compute.relative_size  = time_total_compute / time_total_graphics;
-            ubo_performance_meter_graphics.relative_size = 1.0;
-        }
-    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 
+    VkBufferCopy copy_region = {};
+    copy_region.srcOffset = ubo_nbody_compute.particle_count * sizeof(HermiteDerivatives);
+    copy_region.dstOffset = 0;
+    copy_region.size      = ubo_nbody_compute.particle_count * sizeof(HermiteDerivatives);
 
-    ubo_nbody_graphics.timestamp = static_cast<double>(uptime.nsecsElapsed()) / 1.0e9;
-}
+    vkCmdCopyBuffer(command_buffer, buffer_hermite.buffer, buffer_hermite.buffer, 1, &copy_region);
 
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-void VulkanWindow::resizeEvent(QResizeEvent *ev)
-{
-    swapChainRecreate();
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 
-void VulkanWindow::mouseMoveEvent(QMouseEvent *ev)
+void VulkanWindow::launch()
 {
-    QPoint middle_of_widget(this->width() / 2, this->height() / 2);
-    QPoint middle_of_widget_global = mapToGlobal(middle_of_widget);
+    bool paused = true;
 
-    if (p_ignore_mousemove_event == true)
+    if (compute_timer->isActive())
     {
-        ev->ignore();
-        p_ignore_mousemove_event = false;
-        p_last_position          = middle_of_widget;
-        p_pitch_yaw_vector       = QPointF(0, 0);
+        paused = false;
     }
-    else
-    {
-        if (p_mouse_right_button_active)
-        {
-            if (!p_key_ctrl_active)
-            {
-                // Instant rotation
-                p_pitch_yaw_vector.setX(p_last_position.x() - ev->localPos().x());
-                p_pitch_yaw_vector.setY(p_last_position.y() - ev->localPos().y());
 
-                double eta = std::atan2(p_pitch_yaw_vector.y(), p_pitch_yaw_vector.x()) - 0.5 * pi;
-                double magnitude = -mouse_sensitivity *pi *std::sqrt(p_pitch_yaw_vector.x() * p_pitch_yaw_vector.x() + p_pitch_yaw_vector.y() * p_pitch_yaw_vector.y()) / static_cast<double> (this->height());
+    graphics_timer->stop();
+    compute_timer->stop();
 
-                RotationMatrix<double> pitch_yaw_rotation;
-                pitch_yaw_rotation.setArbRotation(-0.5 * pi, eta, magnitude);
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
 
-                rotation_matrix = pitch_yaw_rotation * rotation_matrix;
+    descriptorPoolReset();
+    destroyBuffersNbody();
+    generateBuffersNbody();
+    descriptorSetsAllocate();
+    descriptorSetsUpdate();
+    commandBuffersComputeRecord();
+    commandBuffersGraphicsRecord();
 
-                // If cursor moves to edge of widget, place back at original position and making sure to ignore the resulting event
-                if ((ev->pos().x() <= 10) ||
-                    (ev->pos().x() >= this->width() - 10) ||
-                    (ev->pos().y() <= 10) ||
-                    (ev->pos().y() >= this->height() - 10))
-                {
-                    this->cursor().setPos(middle_of_widget_global);
-                    p_ignore_mousemove_event = true;
-                }
-            }
-            else
-            {
-                // Smooth rotation
-                QPoint middle_of_widget(this->width() / 2, this->height() / 2);
-                QPoint middle_of_widget_global = mapToGlobal(middle_of_widget);
+    if (integratorHermite())
+    {
+        integratorHermiteInitialize();
+    }
 
-                p_pitch_yaw_vector.setX(p_last_position.x() - middle_of_widget.x());
-                p_pitch_yaw_vector.setY(p_last_position.y() - middle_of_widget.y());
+    // A diagnostics pass in flight measured the previous particles
+    energy_initial_valid    = false;
+    diagnostics_pending     = false;
+    steps_since_diagnostics = 0;
+    steps_since_reorder     = 0;
+    force_slice             = 0;
 
-                double pitch_yaw_magnitude     = std::sqrt(p_pitch_yaw_vector.x() * p_pitch_yaw_vector.x() + p_pitch_yaw_vector.y() * p_pitch_yaw_vector.y());
-                double pitch_yaw_magnitude_max = 0.5 * this->height();
+    ubo_nbody_compute.work_group_offset[0] = 0;
+    uniformBuffersUpdate();
 
-                // Move cursor closer to origin defined by mouse press
-                if (pitch_yaw_magnitude > pitch_yaw_magnitude_max)
-                {
-                    p_pitch_yaw_vector.setX(p_pitch_yaw_vector.x() / pitch_yaw_magnitude * pitch_yaw_magnitude_max * 0.9);
-                    p_pitch_yaw_vector.setY(p_pitch_yaw_vector.y() / pitch_yaw_magnitude * pitch_yaw_magnitude_max * 0.9);
+    graphics_timer->start();
+    if (!paused)
+    {
+        compute_timer->start();
+    }
+}
 
-                    this->cursor().setPos(QPoint(p_pitch_yaw_vector.x() + middle_of_widget_global.x(), p_pitch_yaw_vector.y() + middle_of_widget_global.y()));
-                }
-            }
-        }
-        uniformBuffersUpdate();
-        p_last_position = ev->localPos();
+
+void VulkanWindow::pauseCompute(bool value)
+{
+    if (value)
+    {
+        compute_timer->stop();
+    }
+    else
+    {
+        compute_timer->start();
     }
+}
 
-    if (p_mouse_right_button_active)
+
+void VulkanWindow::pauseAll(bool value)
+{
+    if (value)
     {
-        this->setCursor(Qt::BlankCursor);
+        compute_timer->stop();
+        graphics_timer->stop();
+
+        HANDLE_VK_RESULT(vkDeviceWaitIdle(vkbase.device()));
     }
     else
     {
-        this->setCursor(Qt::CrossCursor);
+        compute_timer->start();
+        graphics_timer->start();
     }
 }
 
 
-void VulkanWindow::mouseDoubleClickEvent(QMouseEvent *ev)
+void VulkanWindow::setMouseSensitivity(int value)
 {
+    mouse_sensitivity = static_cast<double>(value * 0.01);
 }
 
 
-void VulkanWindow::mousePressEvent(QMouseEvent *ev)
+void VulkanWindow::setExposure(int value)
 {
-    p_last_position = ev->localPos();
+    ubo_tone_mapping.exposure = static_cast<float>(value) / 20.0;
+    uniformBuffersUpdate();
+}
 
-    if (ev->buttons() & Qt::RightButton)
-    {
-        p_mouse_right_button_active = true;
-    }
+
+void VulkanWindow::setGamma(int value)
+{
+    ubo_tone_mapping.gamma = static_cast<float>(value) / 30.0;
+    uniformBuffersUpdate();
 }
 
 
-void VulkanWindow::mouseReleaseEvent(QMouseEvent *ev)
+void VulkanWindow::setToneMappingMode(int value)
 {
-    if (ev->button() == Qt::RightButton)
-    {
-        p_mouse_right_button_active = false;
-        p_pitch_yaw_vector.setX(0);
-        p_pitch_yaw_vector.setY(0);
-        this->setCursor(Qt::CrossCursor);
-    }
+    ubo_tone_mapping.tone_mapping_method = value;
+    uniformBuffersUpdate();
 }
 
 
-void VulkanWindow::keyPressEvent(QKeyEvent *ev)
+void VulkanWindow::update()
 {
-    if (ev->key() == Qt::Key_W)
-    {
-        p_key_w_active = true;
-    }
-    if (ev->key() == Qt::Key_A)
-    {
-        p_key_a_active = true;
-    }
-    if (ev->key() == Qt::Key_S)
-    {
-        p_key_s_active = true;
-    }
-    if (ev->key() == Qt::Key_D)
-    {
-        p_key_d_active = true;
-    }
-    if (ev->key() == Qt::Key_Q)
-    {
-        p_key_q_active = true;
-    }
-    if (ev->key() == Qt::Key_E)
-    {
-        p_key_e_active = true;
-    }
-    if (ev->key() == Qt::Key_Shift)
-    {
-        p_key_shift_active = true;
-    }
-    if (ev->key() == Qt::Key_Control)
-    {
-        p_key_ctrl_active = true;
-    }
-    if (ev->key() == Qt::Key_Space)
-    {
-        p_key_space_active = true;
-    }
+    queueGraphicsSubmit();
 }
 
 
-void VulkanWindow::keyReleaseEvent(QKeyEvent *ev)
+void VulkanWindow::createFpsString()
 {
-    if (ev->key() == Qt::Key_W)
-    {
-        p_key_w_active = false;
-    }
-    if (ev->key() == Qt::Key_A)
-    {
-        p_key_a_active = false;
-    }
-    if (ev->key() == Qt::Key_S)
-    {
-        p_key_s_active = false;
-    }
-    if (ev->key() == Qt::Key_D)
-    {
-        p_key_d_active = false;
-    }
-    if (ev->key() == Qt::Key_Q)
-    {
-        p_key_q_active = false;
-    }
-    if (ev->key() == Qt::Key_E)
-    {
-        p_key_e_active = false;
-    }
-    if (ev->key() == Qt::Key_Control)
-    {
-        p_key_ctrl_active = false;
-    }
-    if (ev->key() == Qt::Key_Shift)
+    double time_elapsed_graphics = 0;
+    double time_elapsed_compute  = 0;
+
+    for (int i = 0; i < p_fps_stack.size(); i++)
     {
-        p_key_shift_active = false;
+        time_elapsed_graphics += p_fps_stack[i];
     }
-    if (ev->key() == Qt::Key_Space)
+
+    size_t step_count = 0;
+
+    for (int i = 0; i < p_cps_stack.size(); i++)
     {
-        p_key_space_active = false;
+        time_elapsed_compute += p_cps_stack[i];
+        step_count           += p_cps_step_stack[i];
     }
+
+    // Merging and escaper removal shrink the particle count
+    QString bodies_string = (collision_merging || (ubo_nbody_compute.escape_radius > 0.0f)) ? " - [bodies: " + QString::number(ubo_nbody_compute.particle_count) + "]" : QString();
+
+    emit fpsStringChanged("Qt+Vulkan N-body simulation - [fps: " +
+                          QString::number(static_cast<double> (p_fps_stack.size()) / (time_elapsed_graphics * 1.0e-9), 'f', 0) + " @ " +
+                          QString("%1").arg(time_total_graphics / 1.0e6, -4, 'g', 3, QLatin1Char('0')) + " ms] - [cps: " +
+                          QString::number(static_cast<double> (step_count) / (time_elapsed_compute * 1.0e-9), 'f', 0) + " @ " +
+                          QString("%1").arg(time_total_compute / 1.0e6, -4, 'g', 3, QLatin1Char('0')) + " ms] - [error E: " +
+                          QString::number(energy_error, 'e', 2) + " P: " +
+                          QString::number(momentum_error, 'e', 2) + " L: " +
+                          QString::number(angular_momentum_error, 'e', 2) + "] - [centre of mass: " +
+                          QString::number(centre_of_mass[0], 'f', 3) + ", " +
+                          QString::number(centre_of_mass[1], 'f', 3) + ", " +
+                          QString::number(centre_of_mass[2], 'f', 3) + "]" + bodies_string);
 }
 
 
-void VulkanWindow::wheelEvent(QWheelEvent *ev)
+void VulkanWindow::diagnosticsRead()
 {
-    float move_scaling = 2.0;
+    // Add up the partial sums of the work groups in double precision. The particle count is that of the pass, since the buffers
+    // are not compacted while it is in flight
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_energy[0])));
 
-    if (ev->modifiers() & Qt::ShiftModifier)
+    const DiagnosticsPartialSums *partial_sums = static_cast<const DiagnosticsPartialSums *>(buffer_energy.mapped);
+
+    double energy              = 0.0;
+    double mass                = 0.0;
+    double momentum[4]         = {};
+    double angular_momentum[4] = {};
+    double mass_moment[3]      = {};
+
+    for (uint32_t i = 0; i < work_group_count_x; i++)
     {
-        move_scaling = 5.0;
+        energy += static_cast<double>(partial_sums[i].energy[0]) + static_cast<double>(partial_sums[i].energy[1]);
+        mass   += partial_sums[i].energy[2];
+
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            momentum[k]         += partial_sums[i].momentum[k];
+            angular_momentum[k] += partial_sums[i].angular_momentum[k];
+        }
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            mass_moment[k] += partial_sums[i].mass_moment[k];
+        }
     }
-    else if (ev->modifiers() & Qt::ControlModifier)
+
+    if (!energy_initial_valid)
     {
-        move_scaling = 0.2;
+        energy_initial       = energy;
+        energy_initial_valid = true;
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            momentum_initial[k]         = momentum[k];
+            angular_momentum_initial[k] = angular_momentum[k];
+        }
     }
 
-    double delta;
+    // The momenta of symmetric initial conditions sum to about zero, so their changes are relative to the sum of the magnitudes
+    double momentum_change[3];
+    double angular_momentum_change[3];
 
-    if (ev->delta() > 0)
+    for (uint32_t k = 0; k < 3; k++)
     {
-        delta = 0.1;
-    }
-    else if (ev->delta() < 0)
-    {
-        delta = -0.1;
+        momentum_change[k]         = momentum[k] - momentum_initial[k];
+        angular_momentum_change[k] = angular_momentum[k] - angular_momentum_initial[k];
+        centre_of_mass[k]          = (mass > 0.0) ? mass_moment[k] / mass : 0.0;
     }
-    else
+
+    // Escapers are judged against the bound mass at its centre
+    for (uint32_t k = 0; k < 3; k++)
     {
-        delta = 0;
+        ubo_nbody_compute.escape_centre[k] = static_cast<float>(centre_of_mass[k]);
     }
 
-    delta *= move_scaling;
+    ubo_nbody_compute.escape_centre[3] = static_cast<float>(mass);
+    std::memcpy(uniform_nbody_compute.mapped, &ubo_nbody_compute, sizeof(ubo_nbody_compute));
 
-    if ((delta + rotation_origin_matrix[11] >= -5) && (delta + rotation_origin_matrix[11] <= 0))
-    {
-        rotation_origin_matrix[11] += delta;
-    }
-    uniformBuffersUpdate();
+    energy_error           = (energy_initial != 0.0) ? std::fabs((energy - energy_initial) / energy_initial) : 0.0;
+    momentum_error         = (momentum[3] > 0.0) ? std::sqrt(momentum_change[0] * momentum_change[0] + momentum_change[1] * momentum_change[1] + momentum_change[2] * momentum_change[2]) / momentum[3] : 0.0;
+    angular_momentum_error = (angular_momentum[3] > 0.0) ? std::sqrt(angular_momentum_change[0] * angular_momentum_change[0] + angular_momentum_change[1] * angular_momentum_change[1] + angular_momentum_change[2] * angular_momentum_change[2]) / angular_momentum[3] : 0.0;
 }
 
 
-void VulkanWindow::queryPoolCreate()
+void VulkanWindow::queueComputeSubmit()
 {
+    // Ensure that the previous step has finished and publish its particle buffer for drawing
     {
-        VkQueryPoolCreateInfo info = {};
-        info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-        info.pNext      = nullptr;
-        info.flags      = 0;
-        info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
-        info.queryCount = 14;
-        HANDLE_VK_RESULT(vkCreateQueryPool(vkbase.device(), &info, nullptr, &query_pool_graphics));
-    }
-    {
-        VkQueryPoolCreateInfo info = {};
-        info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-        info.pNext      = nullptr;
-        info.flags      = 0;
-        info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
-        info.queryCount = 4;
-        HANDLE_VK_RESULT(vkCreateQueryPool(vkbase.device(), &info, nullptr, &query_pool_compute));
-    }
-}
+        VkResult result = vkGetFenceStatus(vkbase.device(), fence_compute);
 
+        switch (result)
+        {
+        case VK_NOT_READY:
+            HANDLE_VK_RESULT(vkWaitForFences(vkbase.device(), 1, &fence_compute, VK_TRUE, 1e9));
+            break;
 
-void VulkanWindow::queryPoolDestroy()
-{
-    vkDestroyQueryPool(vkbase.device(), query_pool_graphics, nullptr);
-    vkDestroyQueryPool(vkbase.device(), query_pool_compute, nullptr);
-}
-
+        default:
+            HANDLE_VK_RESULT(result);
+            break;
+        }
 
-void VulkanWindow::swapChainCreate(VkSwapchainKHR old_swapchain)
-{
-    HANDLE_VK_RESULT(vkDeviceWaitIdle(vkbase.device()));
+        nbody_slot_published = nbody_slot_compute;
+    }
 
-    HANDLE_VK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vkbase.physicalDevice(), surface, &surface_capabilities));
+    // Read back the diagnostics once their pass has finished. The compute queue never waits for it
+    if (diagnostics_pending && (vkGetFenceStatus(vkbase.device(), fence_diagnostics) == VK_SUCCESS))
+    {
+        diagnosticsRead();
+        diagnostics_pending = false;
+    }
 
-    // Find a present mode
-    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    // Sliced kicks are only continued while the settings still slice them. Otherwise the step starts over without an offset
+    if ((force_slice > 0) && !integratorSliced())
     {
-        uint32_t present_mode_count = 0;
-        HANDLE_VK_RESULT(vkGetPhysicalDeviceSurfacePresentModesKHR(vkbase.physicalDevice(), surface, &present_mode_count, nullptr));
-        QVector<VkPresentModeKHR> present_mode_list(present_mode_count);
-        HANDLE_VK_RESULT(vkGetPhysicalDeviceSurfacePresentModesKHR(vkbase.physicalDevice(), surface, &present_mode_count, present_mode_list.data()));
-        for (auto m : present_mode_list)
-        {
-            if (m == VK_PRESENT_MODE_MAILBOX_KHR)
-            {
-                present_mode          = m;
-                swapchain_image_count = 3;
-            }
-        }
+        force_slice = 0;
+
+        ubo_nbody_compute.work_group_offset[0] = 0;
+        std::memcpy(uniform_nbody_compute.mapped, &ubo_nbody_compute, sizeof(ubo_nbody_compute));
     }
 
-    if ((surface_capabilities.maxImageCount > 0))
+    // Compact the particle buffers once a percent of the bodies have merged or escaped. The statistics are final since the compute
+    // queue is idle. Not in the middle of a sliced step, nor while the diagnostics read the current particle count
+    if ((collision_merging || (ubo_nbody_compute.escape_radius > 0.0f)) && (force_slice == 0) && !diagnostics_pending && !integratorEnsemble() && !integratorOutOfCore())
     {
-        if ((swapchain_image_count > surface_capabilities.maxImageCount))
+        const CollisionStatistics *statistics = static_cast<const CollisionStatistics *>(buffer_collision_statistics.mapped);
+
+        if ((statistics->removed_count > 0) && (100 * statistics->removed_count >= ubo_nbody_compute.particle_count))
         {
-            swapchain_image_count = surface_capabilities.maxImageCount;
+            particlesCompact();
         }
     }
-    if (swapchain_image_count < surface_capabilities.minImageCount)
+
+    // Diagnose the newest completed state. The pass reads it alongside the next step, which writes to another slot of the ring.
+    // Not out-of-core, where the slots are too large to be bound for the shader
+    if ((diagnostics_interval > 0) && !diagnostics_pending && (steps_since_diagnostics >= diagnostics_interval) && !integratorOutOfCore())
     {
-        swapchain_image_count = surface_capabilities.minImageCount;
-    }
+        HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_diagnostics));
 
-    // Ensure swapchain images respect surface capabilities
-    uint32_t vulkan_surface_width  = surface_capabilities.currentExtent.width;
-    uint32_t vulkan_surface_height = surface_capabilities.currentExtent.height;
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &command_buffer_compute_diagnostics[nbody_slot_published];
 
-    if (vulkan_surface_width > surface_capabilities.maxImageExtent.width)
-    {
-        vulkan_surface_width = surface_capabilities.maxImageExtent.width;
-    }
-    if (vulkan_surface_height > surface_capabilities.maxImageExtent.height)
-    {
-        vulkan_surface_height = surface_capabilities.maxImageExtent.height;
-    }
-    if (vulkan_surface_width < surface_capabilities.minImageExtent.width)
-    {
-        vulkan_surface_width = surface_capabilities.minImageExtent.width;
-    }
-    if (vulkan_surface_height < surface_capabilities.minImageExtent.height)
-    {
-        vulkan_surface_height = surface_capabilities.minImageExtent.height;
-    }
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_diagnostics));
 
-    VkSwapchainCreateInfoKHR info = {};
-    info.sType                 = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    info.pNext                 = nullptr;
-    info.surface               = surface;
-    info.minImageCount         = swapchain_image_count;
-    info.imageFormat           = surface_format.format;
-    info.imageColorSpace       = surface_format.colorSpace;
-    info.imageExtent.width     = vulkan_surface_width;
-    info.imageExtent.height    = vulkan_surface_height;
-    info.imageArrayLayers      = 1;
-    info.imageUsage            = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    info.imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount = 0;
-    info.pQueueFamilyIndices   = nullptr;
-    info.preTransform          = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-    info.compositeAlpha        = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    info.presentMode           = present_mode;
-    info.clipped               = VK_TRUE;
-    info.oldSwapchain          = old_swapchain;
+        diagnostics_pending     = true;
+        steps_since_diagnostics = 0;
+    }
 
-    // (Re)create a swap chain
-    HANDLE_VK_RESULT(vkCreateSwapchainKHR(vkbase.device(), &info, nullptr, &swapchain));
+    // The step overwrites the oldest particle buffer in the ring. Ensure that it is not being drawn from
+    uint32_t nbody_slot_write = (nbody_slot_compute + 1) % NBODY_BUFFER_COUNT;
 
-    if (old_swapchain != VK_NULL_HANDLE)
+    if (nbody_slot_write == nbody_slot_drawing)
     {
-        vkDestroySwapchainKHR(vkbase.device(), old_swapchain, nullptr);
-    }
-}
+        VkResult result = vkGetFenceStatus(vkbase.device(), fence_draw);
 
+        switch (result)
+        {
+        case VK_NOT_READY:
+            HANDLE_VK_RESULT(vkWaitForFences(vkbase.device(), 1, &fence_draw, VK_TRUE, 1e9));
+            break;
 
-void VulkanWindow::swapChainDestroy()
-{
-    vkDestroySwapchainKHR(vkbase.device(), swapchain, nullptr);
-}
+        default:
+            HANDLE_VK_RESULT(result);
+            break;
+        }
+    }
 
+    // Reordering would mix the systems of an ensemble, and out-of-core steps do not keep a tree
+    bool reorder = (force_slice == 0) && (reorder_interval > 0) && (steps_since_reorder >= reorder_interval) && !integratorEnsemble() && !integratorOutOfCore();
 
-void VulkanWindow::swapChainImageViewsCreate()
-{
-    // Swap chain images, managed by swapchain
-    HANDLE_VK_RESULT(vkGetSwapchainImagesKHR(vkbase.device(), swapchain, &swapchain_image_count, nullptr));
+    // A sliced kick takes one submission per slice, so that graphics work can run in between. The offset of the slice is passed
+    // in the uniforms, which the previous slice is done with. The drift completes the step once all slices are done
+    if (!reorder && integratorSliced() && (force_slice < forceSliceCount()))
+    {
+        HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_compute));
 
-    swapchain_images.resize(swapchain_image_count);
+        ubo_nbody_compute.work_group_offset[0] = force_slice * force_slice_size;
+        std::memcpy(uniform_nbody_compute.mapped, &ubo_nbody_compute, sizeof(ubo_nbody_compute));
 
-    HANDLE_VK_RESULT(vkGetSwapchainImagesKHR(vkbase.device(), swapchain, &swapchain_image_count, swapchain_images.data()));
+        force_slice++;
 
-    swapchain_image_views.resize(swapchain_image_count);
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &command_buffer_compute_slice[nbody_slot_compute];
 
-    for (uint32_t i = 0; i < swapchain_image_count; ++i)
-    {
-        VkImageViewCreateInfo info = {};
-        info.sType        = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        info.pNext        = nullptr;
-        info.image        = swapchain_images[i];
-        info.viewType     = VK_IMAGE_VIEW_TYPE_2D;
-        info.format       = surface_format.format;
-        info.components.r = VK_COMPONENT_SWIZZLE_R;
-        info.components.g = VK_COMPONENT_SWIZZLE_G;
-        info.components.b = VK_COMPONENT_SWIZZLE_B;
-        info.components.a = VK_COMPONENT_SWIZZLE_A;
-        info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-        info.subresourceRange.baseMipLevel   = 0;
-        info.subresourceRange.levelCount     = 1;
-        info.subresourceRange.baseArrayLayer = 0;
-        info.subresourceRange.layerCount     = 1;
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute));
 
-        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &info, nullptr, &swapchain_image_views[i]));
+        return;
     }
-}
 
-
-void VulkanWindow::swapChainImageViewsDestroy()
-{
-    for (auto view : swapchain_image_views)
+    // Poll timers. A batch is reported as step 1. The tree and particle mesh splits step 1 into its short-range and long-range parts
     {
-        vkDestroyImageView(vkbase.device(), view, nullptr);
-    }
-}
+        VkResult result_step_1 = vkGetQueryPoolResults(vkbase.device(), query_pool_compute, 0, 2, sizeof(QueryResult) * 2, query_timestamp_compute_leapfrog_step_1.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        VkResult result_step_2 = vkGetQueryPoolResults(vkbase.device(), query_pool_compute, 2, 2, sizeof(QueryResult) * 2, query_timestamp_compute_leapfrog_step_2.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
 
+        if ((result_step_1 != VK_NOT_READY) && (result_step_2 != VK_NOT_READY))
+        {
+            HANDLE_VK_RESULT(result_step_1);
+            HANDLE_VK_RESULT(result_step_2);
 
-void VulkanWindow::fencesCreate()
-{
-    VkFenceCreateInfo info = {};
+            float time_step_1 = static_cast<double>(query_timestamp_compute_leapfrog_step_1[1].time - query_timestamp_compute_leapfrog_step_1[0].time);
+            float time_step_2 = static_cast<double>(query_timestamp_compute_leapfrog_step_2[1].time - query_timestamp_compute_leapfrog_step_2[0].time);
+            float time_total  = time_step_1 + time_step_2;
 
-    info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    info.pNext = nullptr;
-    info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    HANDLE_VK_RESULT(vkCreateFence(vkbase.device(), &info, nullptr, &fence_draw));
-    HANDLE_VK_RESULT(vkCreateFence(vkbase.device(), &info, nullptr, &fence_transfer));
-    HANDLE_VK_RESULT(vkCreateFence(vkbase.device(), &info, nullptr, &fence_compute_step_1));
-}
+            VkResult result_mesh = vkGetQueryPoolResults(vkbase.device(), query_pool_compute, 4, 2, sizeof(QueryResult) * 2, query_timestamp_compute_mesh.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
 
+            if (result_mesh != VK_NOT_READY)
+            {
+                HANDLE_VK_RESULT(result_mesh);
 
-void VulkanWindow::fencesDestroy()
-{
-    vkDestroyFence(vkbase.device(), fence_draw, nullptr);
-    vkDestroyFence(vkbase.device(), fence_transfer, nullptr);
-    vkDestroyFence(vkbase.device(), fence_compute_step_1, nullptr);
-}
+                float time_mesh = static_cast<double>(query_timestamp_compute_mesh[1].time - query_timestamp_compute_mesh[0].time);
 
+                ubo_performance_meter_compute.process_count = 3;
+                ubo_performance_meter_compute.positions[0]  = (time_step_1 - time_mesh) / time_total;
+                ubo_performance_meter_compute.positions[1]  = time_mesh / time_total;
+                ubo_performance_meter_compute.positions[2]  = time_step_2 / time_total;
+            }
+            else
+            {
+                ubo_performance_meter_compute.process_count = 2;
+                ubo_performance_meter_compute.positions[0]  = time_step_1 / time_total;
+                ubo_performance_meter_compute.positions[1]  = time_step_2 / time_total;
+            }
 
-void VulkanWindow::depthStencilCreate()
-{
-    VkImageCreateInfo image_info = {};
+            time_total_compute = time_total;
+        }
+    }
 
-    image_info.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    image_info.pNext       = nullptr;
-    image_info.imageType   = VK_IMAGE_TYPE_2D;
-    image_info.format      = depth_format;
-    image_info.extent      = { surface_capabilities.currentExtent.width, surface_capabilities.currentExtent.height, 1 };
-    image_info.mipLevels   = 1;
-    image_info.arrayLayers = 1;
-    image_info.samples     = VK_SAMPLE_COUNT_1_BIT;
-    image_info.tiling      = VK_IMAGE_TILING_OPTIMAL;
-    image_info.usage       = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    image_info.flags       = 0;
-    //    image_create_info.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // Computations per second (cps). The interval ends with the previous submission, which may have taken several steps or none
+    p_cps_stack.enqueue(cps_timer.nsecsElapsed());
+    p_cps_step_stack.enqueue(cps_steps);
+    if (p_cps_stack.size() > 100)
+    {
+        p_cps_stack.dequeue();
+        p_cps_step_stack.dequeue();
+    }
+    cps_timer.restart();
 
-    VkMemoryAllocateInfo mem_alloc = {};
-    mem_alloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_alloc.pNext           = nullptr;
-    mem_alloc.allocationSize  = 0;
-    mem_alloc.memoryTypeIndex = 0;
+    HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_compute));
 
-    VkImageViewCreateInfo view_info = {};
-    view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    view_info.pNext            = nullptr;
-    view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
-    view_info.format           = depth_format;
-    view_info.subresourceRange = {};
-    view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-    view_info.subresourceRange.baseMipLevel   = 0;
-    view_info.subresourceRange.levelCount     = 1;
-    view_info.subresourceRange.baseArrayLayer = 0;
-    view_info.subresourceRange.layerCount     = 1;
+    if (reorder)
+    {
+        // Sort the particles along the Morton curve in place of a step. It takes a slot of the ring like a step, but not time
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &command_buffer_compute_reorder[nbody_slot_compute];
 
-    HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &vulkan_depth_stencil.image));
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute));
 
-    VkMemoryRequirements memory_requirements;
-    vkGetImageMemoryRequirements(vkbase.device(), vulkan_depth_stencil.image, &memory_requirements);
+        steps_since_reorder = 0;
+        cps_steps           = 0;
+    }
+    else if (integratorOutOfCore())
+    {
+        // The whole step streams through the device in one submission
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &command_buffer_compute_stream[nbody_slot_compute];
 
-    VkMemoryAllocateInfo memory_info = {};
-    memory_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memory_info.allocationSize  = memory_requirements.size;
-    memory_info.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memory_info, nullptr, &vulkan_depth_stencil.mem));
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute));
 
-    HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), vulkan_depth_stencil.image, vulkan_depth_stencil.mem, 0));
+        steps_since_reorder++;
+        steps_since_diagnostics++;
+        cps_steps = 1;
+    }
+    else if (integratorBatched())
+    {
+        // Submit all steps of the batch at once
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &command_buffer_compute_batch[nbody_slot_compute];
 
-    // Change layout of depth stencil image to VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute));
+
+        steps_since_reorder     += steps_per_submit;
+        steps_since_diagnostics += steps_per_submit;
+        cps_steps                = steps_per_submit;
+    }
+    else if (integratorSliced())
     {
-        VkImageSubresourceRange subresourceRange = {};
-        subresourceRange.aspectMask   = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-        subresourceRange.baseMipLevel = 0;
-        subresourceRange.levelCount   = 1;
-        subresourceRange.layerCount   = 1;
+        // All slices of the kick are done. Submit the drift, which starts with a barrier on the kick
+        force_slice = 0;
 
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.pNext            = nullptr;
-        barrier.oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout        = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-        barrier.image            = vulkan_depth_stencil.image;
-        barrier.subresourceRange = subresourceRange;
-        barrier.srcAccessMask    = 0;
-        barrier.dstAccessMask    = barrier.dstAccessMask | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        ubo_nbody_compute.work_group_offset[0] = 0;
+        std::memcpy(uniform_nbody_compute.mapped, &ubo_nbody_compute, sizeof(ubo_nbody_compute));
 
-        // Put barrier inside setup command buffer
-        VkCommandBuffer setup_command_buffer = commandBufferCreate();
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = nullptr;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &command_buffer_compute_step_2[nbody_slot_compute];
 
-        vkCmdPipelineBarrier(
-            setup_command_buffer,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute));
 
-        commandBufferSubmitAndFree(setup_command_buffer);
+        steps_since_reorder++;
+        steps_since_diagnostics++;
+        cps_steps = 1;
     }
+    else
+    {
+        // Submit the first compute step
+        {
+            VkSubmitInfo submit_info = {};
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = nullptr;
+            submit_info.commandBufferCount   = 1;
+            submit_info.pCommandBuffers      = &command_buffer_compute_step_1[nbody_slot_compute];
+            submit_info.pSignalSemaphores    = &semaphore_compute_step_1_complete;
+            submit_info.signalSemaphoreCount = 1;
+
+            HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, VK_NULL_HANDLE));
+        }
 
-    view_info.image = vulkan_depth_stencil.image;
-    HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &vulkan_depth_stencil.view));
-}
+        // Submit the second compute step
+        {
+            VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            VkSubmitInfo         submit_info         = {};
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = nullptr;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers    = &command_buffer_compute_step_2[nbody_slot_compute];
+            submit_info.pWaitSemaphores    = &semaphore_compute_step_1_complete;
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitDstStageMask  = &wait_dst_stage_mask;
+
+            HANDLE_VK_RESULT(vkQueueSubmit(vkbase.computeQueue(), 1, &submit_info, fence_compute));
+        }
 
+        steps_since_reorder++;
+        steps_since_diagnostics++;
+        cps_steps = 1;
+    }
 
-void VulkanWindow::depthStencilDestroy()
-{
-    vkDestroyImageView(vkbase.device(), vulkan_depth_stencil.view, nullptr);
-    vkDestroyImage(vkbase.device(), vulkan_depth_stencil.image, nullptr);
-    vkFreeMemory(vkbase.device(), vulkan_depth_stencil.mem, nullptr);
+    nbody_slot_compute = nbody_slot_write;
 }
 
 
-void VulkanWindow::semaphoresCreate()
+void VulkanWindow::focusOutEvent(QFocusEvent *ev)
 {
-    // Semaphores are used to coordinate operations between queues and between vulkan_substructure.vulkanPresentQueue () submissions within a single vulkan_substructure.vulkanPresentQueue ()
-    VkSemaphoreCreateInfo semaphore_create_info = {};
-
-    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_present_complete));
-    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_post_present_complete));
-    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_compute_step_1_complete));
-    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_draw_complete));
-    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_pre_present_complete));
+    p_key_w_active     = false;
+    p_key_a_active     = false;
+    p_key_s_active     = false;
+    p_key_d_active     = false;
+    p_key_q_active     = false;
+    p_key_e_active     = false;
+    p_key_ctrl_active  = false;
+    p_key_shift_active = false;
+    p_key_space_active = false;
 }
 
 
-void VulkanWindow::semaphoresDestroy()
+void VulkanWindow::queueGraphicsSubmit()
 {
-    vkDestroySemaphore(vkbase.device(), semaphore_present_complete, nullptr);
-    vkDestroySemaphore(vkbase.device(), semaphore_post_present_complete, nullptr);
-    vkDestroySemaphore(vkbase.device(), semaphore_compute_step_1_complete, nullptr);
-    vkDestroySemaphore(vkbase.device(), semaphore_draw_complete, nullptr);
-    vkDestroySemaphore(vkbase.device(), semaphore_pre_present_complete, nullptr);
-}
+    // Update view matrices
+    passiveMove();
 
+    // Aquire the index of the currently active image
+    uint32_t buffer_index;
+    VkResult result = vkAcquireNextImageKHR(vkbase.device(), swapchain, UINT64_MAX, semaphore_present_complete, VK_NULL_HANDLE, &buffer_index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        swapChainRecreate();
+        return;
+    }
+    else
+    {
+        HANDLE_VK_RESULT(result);
+    }
 
-void VulkanWindow::renderPassesCreate()
-{
-    // Low dynamic range
+    // Submit post present cb if present complete
     {
-        QVector<VkAttachmentDescription> attachment_descriptions(2);
+        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        VkSubmitInfo         info = {};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.pNext = nullptr;
+        info.commandBufferCount   = 1;
+        info.pWaitDstStageMask    = &wait_dst_stage_mask;
+        info.waitSemaphoreCount   = 1;
+        info.pWaitSemaphores      = &semaphore_present_complete;
+        info.signalSemaphoreCount = 1;
+        info.pSignalSemaphores    = &semaphore_post_present_complete;
+        info.pCommandBuffers      = &command_buffer_post_present[buffer_index];
 
-        // Color attachment
-        attachment_descriptions[0].flags          = 0;
-        attachment_descriptions[0].format         = surface_format.format;
-        attachment_descriptions[0].samples        = VK_SAMPLE_COUNT_1_BIT;
-        attachment_descriptions[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachment_descriptions[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-        attachment_descriptions[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        attachment_descriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachment_descriptions[0].initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        attachment_descriptions[0].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &info, VK_NULL_HANDLE));
+    }
 
-        // Depth attachment
-        attachment_descriptions[1].flags          = 0;
-        attachment_descriptions[1].format         = depth_format;
-        attachment_descriptions[1].samples        = VK_SAMPLE_COUNT_1_BIT;
-        attachment_descriptions[1].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachment_descriptions[1].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-        attachment_descriptions[1].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        attachment_descriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachment_descriptions[1].initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-        attachment_descriptions[1].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // Submit the draw cb
+    {
+        // Draw the newest particle buffer whose compute step has completed, without waiting for the one in flight
+        {
+            VkResult result = vkGetFenceStatus(vkbase.device(), fence_compute);
 
-        VkAttachmentReference color_attachment_reference;
-        color_attachment_reference.attachment = 0;
-        color_attachment_reference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            switch (result)
+            {
+            case VK_NOT_READY:
+                break;
 
-        VkAttachmentReference depth_attachment_references = {};
-        depth_attachment_references.attachment = 1;
-        depth_attachment_references.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            default:
+                HANDLE_VK_RESULT(result);
 
-        QVector<VkSubpassDescription> subpass_descriptions(1);
-        subpass_descriptions[0].flags                   = 0;
-        subpass_descriptions[0].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass_descriptions[0].inputAttachmentCount    = 0;
-        subpass_descriptions[0].pInputAttachments       = nullptr;
-        subpass_descriptions[0].colorAttachmentCount    = 1;
-        subpass_descriptions[0].pColorAttachments       = &color_attachment_reference;
-        subpass_descriptions[0].pResolveAttachments     = nullptr;
-        subpass_descriptions[0].pDepthStencilAttachment = &depth_attachment_references;
-        subpass_descriptions[0].preserveAttachmentCount = 0;
-        subpass_descriptions[0].pPreserveAttachments    = nullptr;
+                nbody_slot_published = nbody_slot_compute;
+                break;
+            }
 
-        VkRenderPassCreateInfo render_pass_create_info = {};
-        render_pass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_create_info.pNext           = nullptr;
-        render_pass_create_info.flags           = 0;
-        render_pass_create_info.attachmentCount = static_cast<uint32_t> (attachment_descriptions.size());
-        render_pass_create_info.pAttachments    = attachment_descriptions.data();
-        render_pass_create_info.subpassCount    = static_cast<uint32_t> (subpass_descriptions.size());
-        render_pass_create_info.pSubpasses      = subpass_descriptions.data();
-        render_pass_create_info.dependencyCount = 0;
-        render_pass_create_info.pDependencies   = nullptr;
+            nbody_slot_drawing = nbody_slot_published;
+        }
 
-        HANDLE_VK_RESULT(vkCreateRenderPass(vkbase.device(), &render_pass_create_info, nullptr, &render_pass_ldr));
+        HANDLE_VK_RESULT(vkResetFences(vkbase.device(), 1, &fence_draw));
+
+        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo         info = {};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.pNext = nullptr;
+        info.commandBufferCount   = 1;
+        info.pWaitDstStageMask    = &wait_dst_stage_mask;
+        info.waitSemaphoreCount   = 1;
+        info.pWaitSemaphores      = &semaphore_post_present_complete;
+        info.signalSemaphoreCount = 1;
+        info.pSignalSemaphores    = &semaphore_draw_complete;
+        info.pCommandBuffers      = &command_buffer_draw[nbody_slot_drawing * swapchain_image_count + buffer_index];
+
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &info, fence_draw));
     }
-    // High dynamic range with depth attachment in addition
+    // Submit pre present cb when draw cb complete
     {
-        QVector<VkAttachmentDescription> attachment_descriptions(2);
+        VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        VkSubmitInfo         info = {};
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.pNext = nullptr;
+        info.commandBufferCount   = 1;
+        info.pWaitDstStageMask    = &wait_dst_stage_mask;
+        info.waitSemaphoreCount   = 1;
+        info.pWaitSemaphores      = &semaphore_draw_complete;
+        info.signalSemaphoreCount = 1;
+        info.pSignalSemaphores    = &semaphore_pre_present_complete;
+        info.pCommandBuffers      = &command_buffer_pre_present[buffer_index];
 
-        // Color attachment
-        attachment_descriptions[0].flags          = 0;
-        attachment_descriptions[0].format         = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attachment_descriptions[0].samples        = VK_SAMPLE_COUNT_1_BIT;
-        attachment_descriptions[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachment_descriptions[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-        attachment_descriptions[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        attachment_descriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachment_descriptions[0].initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        attachment_descriptions[0].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &info, VK_NULL_HANDLE));
+    }
 
-        // Depth attachment
-        attachment_descriptions[1].flags          = 0;
-        attachment_descriptions[1].format         = depth_format;
-        attachment_descriptions[1].samples        = VK_SAMPLE_COUNT_1_BIT;
-        attachment_descriptions[1].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachment_descriptions[1].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-        attachment_descriptions[1].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        attachment_descriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachment_descriptions[1].initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-        attachment_descriptions[1].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    {
+        // Present the current image to the swap chain
+        VkPresentInfoKHR info = {};
+        info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        info.pNext = nullptr;
+        info.waitSemaphoreCount = 1;
+        info.pWaitSemaphores    = &semaphore_pre_present_complete;
+        info.swapchainCount     = 1;
+        info.pSwapchains        = &swapchain;
+        info.pImageIndices      = &buffer_index;
+        info.pResults           = nullptr;
 
-        QVector<VkAttachmentReference> color_attachment_references;
+        result = vkQueuePresentKHR(vkbase.graphicsQueue(), &info);
+        if (result == VK_SUBOPTIMAL_KHR)
         {
-            VkAttachmentReference reference = {};
-            reference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            reference.attachment = 0;
-
-            color_attachment_references << reference;
+            swapChainRecreate();
+            return;
+        }
+        else
+        {
+            HANDLE_VK_RESULT(result);
         }
+    }
 
-        VkAttachmentReference depth_attachment_reference = {};
-        depth_attachment_reference.attachment = 1;
-        depth_attachment_reference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // Fps
+    p_fps_stack.enqueue(fps_timer.nsecsElapsed());
+    if (p_fps_stack.size() > 100)
+    {
+        p_fps_stack.dequeue();
+    }
+    fps_timer.restart();
 
-        QVector<VkSubpassDescription> subpass_descriptions(1);
-        subpass_descriptions[0].flags                   = 0;
-        subpass_descriptions[0].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass_descriptions[0].inputAttachmentCount    = 0;
-        subpass_descriptions[0].pInputAttachments       = nullptr;
-        subpass_descriptions[0].colorAttachmentCount    = static_cast<uint32_t> (color_attachment_references.size());
-        subpass_descriptions[0].pColorAttachments       = color_attachment_references.data();
-        subpass_descriptions[0].pResolveAttachments     = nullptr;
-        subpass_descriptions[0].pDepthStencilAttachment = &depth_attachment_reference;
-        subpass_descriptions[0].preserveAttachmentCount = 0;
-        subpass_descriptions[0].pPreserveAttachments    = nullptr;
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
 
-        VkRenderPassCreateInfo render_pass_create_info = {};
-        render_pass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_create_info.pNext           = nullptr;
-        render_pass_create_info.flags           = 0;
-        render_pass_create_info.attachmentCount = static_cast<uint32_t> (attachment_descriptions.size());
-        render_pass_create_info.pAttachments    = attachment_descriptions.data();
-        render_pass_create_info.subpassCount    = static_cast<uint32_t> (subpass_descriptions.size());
-        render_pass_create_info.pSubpasses      = subpass_descriptions.data();
-        render_pass_create_info.dependencyCount = 0;
-        render_pass_create_info.pDependencies   = nullptr;
+    // Poll timers and submit performance metrics
+    {
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 0, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_scene.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 2, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_brightness.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 4, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_blur_alpha.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 6, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_blur_beta.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 8, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_combine.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 10, 2, sizeof(QueryResult) * 2, query_timestamp_graphics_tone_map.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
+        HANDLE_VK_RESULT(vkGetQueryPoolResults(vkbase.device(), query_pool_graphics, 12, 2, sizeof(QueryResult) * 2, query_timestamp_graphics.data(), sizeof(QueryResult), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT));
 
-        HANDLE_VK_RESULT(vkCreateRenderPass(vkbase.device(), &render_pass_create_info, nullptr, &render_pass_hdr_color_depth));
+        float time_scene      = static_cast<double>(query_timestamp_graphics_scene[1].time - query_timestamp_graphics_scene[0].time);
+        float time_brightness = static_cast<double>(query_timestamp_graphics_brightness[1].time - query_timestamp_graphics_brightness[0].time);
+        float time_blur_alpha = static_cast<double>(query_timestamp_graphics_blur_alpha[1].time - query_timestamp_graphics_blur_alpha[0].time);
+        float time_blur_beta  = static_cast<double>(query_timestamp_graphics_blur_beta[1].time - query_timestamp_graphics_blur_beta[0].time);
+        float time_combine    = static_cast<double>(query_timestamp_graphics_combine[1].time - query_timestamp_graphics_combine[0].time);
+        float time_tone_map   = static_cast<double>(query_timestamp_graphics_tone_map[1].time - query_timestamp_graphics_tone_map[0].time);
+        time_total_graphics = static_cast<double>(query_timestamp_graphics[1].time - query_timestamp_graphics[0].time);
+        float time_overhead = time_total_graphics - time_scene - time_brightness - time_blur_alpha - time_blur_beta - time_combine - time_tone_map;
+
+        ubo_performance_meter_graphics.process_count = 7;
+        ubo_performance_meter_graphics.positions[0]  = time_scene / time_total_graphics;
+        ubo_performance_meter_graphics.positions[1]  = time_brightness / time_total_graphics;
+        ubo_performance_meter_graphics.positions[2]  = time_blur_alpha / time_total_graphics;
+        ubo_performance_meter_graphics.positions[3]  = time_blur_beta / time_total_graphics;
+        ubo_performance_meter_graphics.positions[4]  = time_combine / time_total_graphics;
+        ubo_performance_meter_graphics.positions[5]  = time_tone_map / time_total_graphics;
+        ubo_performance_meter_graphics.positions[6]  = time_overhead / time_total_graphics;
+
+        if (time_total_compute > time_total_graphics)
+        {
+            ubo_performance_meter_compute.relative_size  = 1.0;
+            ubo_performance_meter_graphics.relative_size = time_total_graphics / time_total_compute;
+        }
+        else
+        {
+            ubo_performance_meter_compute.relative_size  = time_total_compute / time_total_graphics;
+            ubo_performance_meter_graphics.relative_size = 1.0;
+        }
     }
-    // High dynamic range, only color attachment
-    {
-        QVector<VkAttachmentDescription> attachment_descriptions(1);
 
-        // Color attachment
-        attachment_descriptions[0].flags          = 0;
-        attachment_descriptions[0].format         = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attachment_descriptions[0].samples        = VK_SAMPLE_COUNT_1_BIT;
-        attachment_descriptions[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachment_descriptions[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-        attachment_descriptions[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        attachment_descriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachment_descriptions[0].initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        attachment_descriptions[0].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-        VkAttachmentReference color_attachment_reference;
-        color_attachment_reference.attachment = 0;
-        color_attachment_reference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    ubo_nbody_graphics.timestamp = static_cast<double>(uptime.nsecsElapsed()) / 1.0e9;
+}
 
-        QVector<VkSubpassDescription> subpass_descriptions(1);
-        subpass_descriptions[0].flags                   = 0;
-        subpass_descriptions[0].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass_descriptions[0].inputAttachmentCount    = 0;
-        subpass_descriptions[0].pInputAttachments       = nullptr;
-        subpass_descriptions[0].colorAttachmentCount    = 1;
-        subpass_descriptions[0].pColorAttachments       = &color_attachment_reference;
-        subpass_descriptions[0].pResolveAttachments     = nullptr;
-        subpass_descriptions[0].pDepthStencilAttachment = nullptr;
-        subpass_descriptions[0].preserveAttachmentCount = 0;
-        subpass_descriptions[0].pPreserveAttachments    = nullptr;
-
-        VkRenderPassCreateInfo render_pass_create_info = {};
-        render_pass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_create_info.pNext           = nullptr;
-        render_pass_create_info.flags           = 0;
-        render_pass_create_info.attachmentCount = static_cast<uint32_t> (attachment_descriptions.size());
-        render_pass_create_info.pAttachments    = attachment_descriptions.data();
-        render_pass_create_info.subpassCount    = static_cast<uint32_t> (subpass_descriptions.size());
-        render_pass_create_info.pSubpasses      = subpass_descriptions.data();
-        render_pass_create_info.dependencyCount = 0;
-        render_pass_create_info.pDependencies   = nullptr;
-
-        HANDLE_VK_RESULT(vkCreateRenderPass(vkbase.device(), &render_pass_create_info, nullptr, &render_pass_hdr));
-    }
-}
 
-
-void VulkanWindow::renderPassDestroy()
+void VulkanWindow::resizeEvent(QResizeEvent *ev)
 {
-    vkDestroyRenderPass(vkbase.device(), render_pass_ldr, nullptr);
-    vkDestroyRenderPass(vkbase.device(), render_pass_hdr_color_depth, nullptr);
-    vkDestroyRenderPass(vkbase.device(), render_pass_hdr, nullptr);
+    swapChainRecreate();
 }
 
 
-void VulkanWindow::frameBuffersCreate()
+void VulkanWindow::mouseMoveEvent(QMouseEvent *ev)
 {
-    // Swapchain fbos
-    QVector<VkImageView> attachments(2);
-    attachments[1] = vulkan_depth_stencil.view;
-
-    VkFramebufferCreateInfo framebuffer_create_info = {};
-    framebuffer_create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebuffer_create_info.pNext           = nullptr;
-    framebuffer_create_info.flags           = 0;
-    framebuffer_create_info.renderPass      = render_pass_ldr;
-    framebuffer_create_info.attachmentCount = static_cast<uint32_t> (attachments.size());
-    framebuffer_create_info.pAttachments    = attachments.data();
-    framebuffer_create_info.width           = surface_capabilities.currentExtent.width;
-    framebuffer_create_info.height          = surface_capabilities.currentExtent.height;
-    framebuffer_create_info.layers          = 1;
-
-    framebuffers_swapchain.resize(swapchain_image_count);
+    QPoint middle_of_widget(this->width() / 2, this->height() / 2);
+    QPoint middle_of_widget_global = mapToGlobal(middle_of_widget);
 
-    for (auto i = 0; i < framebuffers_swapchain.size(); ++i)
+    if (p_ignore_mousemove_event == true)
     {
-        attachments[0] = swapchain_image_views[i];
-
-        HANDLE_VK_RESULT(vkCreateFramebuffer(vkbase.device(), &framebuffer_create_info, nullptr, &framebuffers_swapchain[i]));
+        ev->ignore();
+        p_ignore_mousemove_event = false;
+        p_last_position          = middle_of_widget;
+        p_pitch_yaw_vector       = QPointF(0, 0);
     }
-
-    // Other fbos, all HDR
-    framebufferSceneHDRCreate(&framebuffer_scene);
-    framebufferStandardHDRCreate(&framebuffer_luminosity, framebuffer_size_blur_pass[0], framebuffer_size_blur_pass[1]);
-    framebufferStandardHDRCreate(&framebuffer_blur_alpha, framebuffer_size_blur_pass[0], framebuffer_size_blur_pass[1]);
-    framebufferStandardHDRCreate(&framebuffer_blur_beta, framebuffer_size_blur_pass[0], framebuffer_size_blur_pass[1]);
-    framebufferStandardHDRCreate(&framebuffer_combine, surface_capabilities.currentExtent.width, surface_capabilities.currentExtent.height);
-
-
-    // Sampler for the HDR framebuffers
-    VkSamplerCreateInfo samplerCreateInfo = {};
-    samplerCreateInfo.sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerCreateInfo.pNext         = nullptr;
-    samplerCreateInfo.magFilter     = VK_FILTER_LINEAR;
-    samplerCreateInfo.minFilter     = VK_FILTER_LINEAR;
-    samplerCreateInfo.mipmapMode    = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerCreateInfo.addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-    samplerCreateInfo.addressModeV  = samplerCreateInfo.addressModeU;
-    samplerCreateInfo.addressModeW  = samplerCreateInfo.addressModeU;
-    samplerCreateInfo.mipLodBias    = 0.0f;
-    samplerCreateInfo.maxAnisotropy = 0;
-    samplerCreateInfo.minLod        = 0.0f;
-    samplerCreateInfo.maxLod        = 0.0f;
-    samplerCreateInfo.borderColor   = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
-    HANDLE_VK_RESULT(vkCreateSampler(vkbase.device(), &samplerCreateInfo, nullptr, &sampler_standard));
-}
-
-
-void VulkanWindow::framebufferStandardHDRCreate(Framebuffer *framebuffer, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkAccessFlags dst_access_mask, VkImageLayout new_layout)
-{
-    framebuffer->width  = width;
-    framebuffer->height = height;
-
-    QVector<VkImageView> attachments;
-
-    // Color attachment
+    else
     {
-        framebuffer->color_attachment.enabled = true;
-
-        // Color attachment
-        VkImageCreateInfo image_info = {};
-        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        image_info.pNext         = nullptr;
-        image_info.imageType     = VK_IMAGE_TYPE_2D;
-        image_info.format        = VK_FORMAT_R32G32B32A32_SFLOAT;
-        image_info.extent.width  = framebuffer->width;
-        image_info.extent.height = framebuffer->height;
-        image_info.extent.depth  = 1;
-        image_info.mipLevels     = 1;
-        image_info.arrayLayers   = 1;
-        image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
-        image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
-        image_info.usage         = usage;
+        if (p_mouse_right_button_active)
+        {
+            if (!p_key_ctrl_active)
+            {
+                // Instant rotation
+                p_pitch_yaw_vector.setX(p_last_position.x() - ev->localPos().x());
+                p_pitch_yaw_vector.setY(p_last_position.y() - ev->localPos().y());
 
-        HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &framebuffer->color_attachment.image));
+                double eta = std::atan2(p_pitch_yaw_vector.y(), p_pitch_yaw_vector.x()) - 0.5 * pi;
+                double magnitude = -mouse_sensitivity *pi *std::sqrt(p_pitch_yaw_vector.x() * p_pitch_yaw_vector.x() + p_pitch_yaw_vector.y() * p_pitch_yaw_vector.y()) / static_cast<double> (this->height());
 
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements(vkbase.device(), framebuffer->color_attachment.image, &memReqs);
+                RotationMatrix<double> pitch_yaw_rotation;
+                pitch_yaw_rotation.setArbRotation(-0.5 * pi, eta, magnitude);
 
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.pNext           = NULL;
-        memAlloc.allocationSize  = 0;
-        memAlloc.memoryTypeIndex = 0;
-        memAlloc.allocationSize  = memReqs.size;
-        memAlloc.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memAlloc, nullptr, &framebuffer->color_attachment.mem));
-        HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), framebuffer->color_attachment.image, framebuffer->color_attachment.mem, 0));
+                rotation_matrix = pitch_yaw_rotation * rotation_matrix;
 
-        VkImageViewCreateInfo view_info = {};
-        view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        view_info.pNext            = nullptr;
-        view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
-        view_info.format           = VK_FORMAT_R32G32B32A32_SFLOAT;
-        view_info.flags            = 0;
-        view_info.subresourceRange = {};
-        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-        view_info.subresourceRange.baseMipLevel   = 0;
-        view_info.subresourceRange.levelCount     = 1;
-        view_info.subresourceRange.baseArrayLayer = 0;
-        view_info.subresourceRange.layerCount     = 1;
-        view_info.image = framebuffer->color_attachment.image;
-        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &framebuffer->color_attachment.view));
+                // If cursor moves to edge of widget, place back at original position and making sure to ignore the resulting event
+                if ((ev->pos().x() <= 10) ||
+                    (ev->pos().x() >= this->width() - 10) ||
+                    (ev->pos().y() <= 10) ||
+                    (ev->pos().y() >= this->height() - 10))
+                {
+                    this->cursor().setPos(middle_of_widget_global);
+                    p_ignore_mousemove_event = true;
+                }
+            }
+            else
+            {
+                // Smooth rotation
+                QPoint middle_of_widget(this->width() / 2, this->height() / 2);
+                QPoint middle_of_widget_global = mapToGlobal(middle_of_widget);
 
-        {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.pNext = nullptr;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-            barrier.image         = framebuffer->color_attachment.image;
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = dst_access_mask;
-            barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
-            barrier.newLayout     = new_layout;
+                p_pitch_yaw_vector.setX(p_last_position.x() - middle_of_widget.x());
+                p_pitch_yaw_vector.setY(p_last_position.y() - middle_of_widget.y());
 
-            VkCommandBuffer command_buffer = commandBufferCreate();
+                double pitch_yaw_magnitude     = std::sqrt(p_pitch_yaw_vector.x() * p_pitch_yaw_vector.x() + p_pitch_yaw_vector.y() * p_pitch_yaw_vector.y());
+                double pitch_yaw_magnitude_max = 0.5 * this->height();
 
-            vkCmdPipelineBarrier(
-                command_buffer,
-                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
+                // Move cursor closer to origin defined by mouse press
+                if (pitch_yaw_magnitude > pitch_yaw_magnitude_max)
+                {
+                    p_pitch_yaw_vector.setX(p_pitch_yaw_vector.x() / pitch_yaw_magnitude * pitch_yaw_magnitude_max * 0.9);
+                    p_pitch_yaw_vector.setY(p_pitch_yaw_vector.y() / pitch_yaw_magnitude * pitch_yaw_magnitude_max * 0.9);
 
-            commandBufferSubmitAndFree(command_buffer);
+                    this->cursor().setPos(QPoint(p_pitch_yaw_vector.x() + middle_of_widget_global.x(), p_pitch_yaw_vector.y() + middle_of_widget_global.y()));
+                }
+            }
         }
+        uniformBuffersUpdate();
+        p_last_position = ev->localPos();
+    }
 
-        attachments << framebuffer->color_attachment.view;
+    if (p_mouse_right_button_active)
+    {
+        this->setCursor(Qt::BlankCursor);
+    }
+    else
+    {
+        this->setCursor(Qt::CrossCursor);
     }
+}
 
-    VkFramebufferCreateInfo fbufCreateInfo = {};
-    fbufCreateInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    fbufCreateInfo.pNext           = nullptr;
-    fbufCreateInfo.renderPass      = render_pass_hdr;
-    fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    fbufCreateInfo.pAttachments    = attachments.data();
-    fbufCreateInfo.width           = framebuffer->width;
-    fbufCreateInfo.height          = framebuffer->height;
-    fbufCreateInfo.layers          = 1;
 
-    HANDLE_VK_RESULT(vkCreateFramebuffer(vkbase.device(), &fbufCreateInfo, nullptr, &framebuffer->framebuffer));
+void VulkanWindow::mouseDoubleClickEvent(QMouseEvent *ev)
+{
 }
 
 
-void VulkanWindow::hdrFramebufferDestroy(VulkanWindow::Framebuffer *framebuffer)
+void VulkanWindow::mousePressEvent(QMouseEvent *ev)
 {
-    vkDestroyImageView(vkbase.device(), framebuffer->color_attachment.view, nullptr);
-    vkDestroyImage(vkbase.device(), framebuffer->color_attachment.image, nullptr);
-    vkFreeMemory(vkbase.device(), framebuffer->color_attachment.mem, nullptr);
+    p_last_position = ev->localPos();
 
-    if (framebuffer->depth_attachment.enabled == true)
+    if (ev->buttons() & Qt::RightButton)
     {
-        vkDestroyImageView(vkbase.device(), framebuffer->depth_attachment.view, nullptr);
-        vkDestroyImage(vkbase.device(), framebuffer->depth_attachment.image, nullptr);
-        vkFreeMemory(vkbase.device(), framebuffer->depth_attachment.mem, nullptr);
+        p_mouse_right_button_active = true;
     }
-
-    vkDestroyFramebuffer(vkbase.device(), framebuffer->framebuffer, nullptr);
 }
 
 
-void VulkanWindow::frameBuffersDestroy()
+void VulkanWindow::mouseReleaseEvent(QMouseEvent *ev)
 {
-    for (auto i = 0; i < framebuffers_swapchain.size(); ++i)
+    if (ev->button() == Qt::RightButton)
     {
-        vkDestroyFramebuffer(vkbase.device(), framebuffers_swapchain[i], nullptr);
+        p_mouse_right_button_active = false;
+        p_pitch_yaw_vector.setX(0);
+        p_pitch_yaw_vector.setY(0);
+        this->setCursor(Qt::CrossCursor);
     }
+}
 
-    hdrFramebufferDestroy(&framebuffer_scene);
-    hdrFramebufferDestroy(&framebuffer_blur_alpha);
-    hdrFramebufferDestroy(&framebuffer_blur_beta);
-    hdrFramebufferDestroy(&framebuffer_luminosity);
-    hdrFramebufferDestroy(&framebuffer_combine);
 
-    vkDestroySampler(vkbase.device(), sampler_standard, nullptr);
+void VulkanWindow::keyPressEvent(QKeyEvent *ev)
+{
+    if (ev->key() == Qt::Key_W)
+    {
+        p_key_w_active = true;
+    }
+    if (ev->key() == Qt::Key_A)
+    {
+        p_key_a_active = true;
+    }
+    if (ev->key() == Qt::Key_S)
+    {
+        p_key_s_active = true;
+    }
+    if (ev->key() == Qt::Key_D)
+    {
+        p_key_d_active = true;
+    }
+    if (ev->key() == Qt::Key_Q)
+    {
+        p_key_q_active = true;
+    }
+    if (ev->key() == Qt::Key_E)
+    {
+        p_key_e_active = true;
+    }
+    if (ev->key() == Qt::Key_Shift)
+    {
+        p_key_shift_active = true;
+    }
+    if (ev->key() == Qt::Key_Control)
+    {
+        p_key_ctrl_active = true;
+    }
+    if (ev->key() == Qt::Key_Space)
+    {
+        p_key_space_active = true;
+    }
+}
+
+
+void VulkanWindow::keyReleaseEvent(QKeyEvent *ev)
+{
+    if (ev->key() == Qt::Key_W)
+    {
+        p_key_w_active = false;
+    }
+    if (ev->key() == Qt::Key_A)
+    {
+        p_key_a_active = false;
+    }
+    if (ev->key() == Qt::Key_S)
+    {
+        p_key_s_active = false;
+    }
+    if (ev->key() == Qt::Key_D)
+    {
+        p_key_d_active = false;
+    }
+    if (ev->key() == Qt::Key_Q)
+    {
+        p_key_q_active = false;
+    }
+    if (ev->key() == Qt::Key_E)
+    {
+        p_key_e_active = false;
+    }
+    if (ev->key() == Qt::Key_Control)
+    {
+        p_key_ctrl_active = false;
+    }
+    if (ev->key() == Qt::Key_Shift)
+    {
+        p_key_shift_active = false;
+    }
+    if (ev->key() == Qt::Key_Space)
+    {
+        p_key_space_active = false;
+    }
+}
+
+
+void VulkanWindow::wheelEvent(QWheelEvent *ev)
+{
+    float move_scaling = 2.0;
+
+    if (ev->modifiers() & Qt::ShiftModifier)
+    {
+        move_scaling = 5.0;
+    }
+    else if (ev->modifiers() & Qt::ControlModifier)
+    {
+        move_scaling = 0.2;
+    }
+
+    double delta;
+
+    if (ev->delta() > 0)
+    {
+        delta = 0.1;
+    }
+    else if (ev->delta() < 0)
+    {
+        delta = -0.1;
+    }
+    else
+    {
+        delta = 0;
+    }
+
+    delta *= move_scaling;
+
+    if ((delta + rotation_origin_matrix[11] >= -5) && (delta + rotation_origin_matrix[11] <= 0))
+    {
+        rotation_origin_matrix[11] += delta;
+    }
+    uniformBuffersUpdate();
+}
+
+
+void VulkanWindow::queryPoolCreate()
+{
+    {
+        VkQueryPoolCreateInfo info = {};
+        info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        info.pNext      = nullptr;
+        info.flags      = 0;
+        info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = 14;
+        HANDLE_VK_RESULT(vkCreateQueryPool(vkbase.device(), &info, nullptr, &query_pool_graphics));
+    }
+    {
+        VkQueryPoolCreateInfo info = {};
+        info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        info.pNext      = nullptr;
+        info.flags      = 0;
+        info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = 6;
+        HANDLE_VK_RESULT(vkCreateQueryPool(vkbase.device(), &info, nullptr, &query_pool_compute));
+    }
+}
+
+
+void VulkanWindow::queryPoolDestroy()
+{
+    vkDestroyQueryPool(vkbase.device(), query_pool_graphics, nullptr);
+    vkDestroyQueryPool(vkbase.device(), query_pool_compute, nullptr);
+}
+
+
+void VulkanWindow::swapChainCreate(VkSwapchainKHR old_swapchain)
+{
+    HANDLE_VK_RESULT(vkDeviceWaitIdle(vkbase.device()));
+
+    HANDLE_VK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vkbase.physicalDevice(), surface, &surface_capabilities));
+
+    // Find a present mode
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    {
+        uint32_t present_mode_count = 0;
+        HANDLE_VK_RESULT(vkGetPhysicalDeviceSurfacePresentModesKHR(vkbase.physicalDevice(), surface, &present_mode_count, nullptr));
+        QVector<VkPresentModeKHR> present_mode_list(present_mode_count);
+        HANDLE_VK_RESULT(vkGetPhysicalDeviceSurfacePresentModesKHR(vkbase.physicalDevice(), surface, &present_mode_count, present_mode_list.data()));
+        for (auto m : present_mode_list)
+        {
+            if (m == VK_PRESENT_MODE_MAILBOX_KHR)
+            {
+                present_mode          = m;
+                swapchain_image_count = 3;
+            }
+        }
+    }
+
+    if ((surface_capabilities.maxImageCount > 0))
+    {
+        if ((swapchain_image_count > surface_capabilities.maxImageCount))
+        {
+            swapchain_image_count = surface_capabilities.maxImageCount;
+        }
+    }
+    if (swapchain_image_count < surface_capabilities.minImageCount)
+    {
+        swapchain_image_count = surface_capabilities.minImageCount;
+    }
+
+    // Ensure swapchain images respect surface capabilities
+    uint32_t vulkan_surface_width  = surface_capabilities.currentExtent.width;
+    uint32_t vulkan_surface_height = surface_capabilities.currentExtent.height;
+
+    if (vulkan_surface_width > surface_capabilities.maxImageExtent.width)
+    {
+        vulkan_surface_width = surface_capabilities.maxImageExtent.width;
+    }
+    if (vulkan_surface_height > surface_capabilities.maxImageExtent.height)
+    {
+        vulkan_surface_height = surface_capabilities.maxImageExtent.height;
+    }
+    if (vulkan_surface_width < surface_capabilities.minImageExtent.width)
+    {
+        vulkan_surface_width = surface_capabilities.minImageExtent.width;
+    }
+    if (vulkan_surface_height < surface_capabilities.minImageExtent.height)
+    {
+        vulkan_surface_height = surface_capabilities.minImageExtent.height;
+    }
+
+    VkSwapchainCreateInfoKHR info = {};
+    info.sType                 = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    info.pNext                 = nullptr;
+    info.surface               = surface;
+    info.minImageCount         = swapchain_image_count;
+    info.imageFormat           = surface_format.format;
+    info.imageColorSpace       = surface_format.colorSpace;
+    info.imageExtent.width     = vulkan_surface_width;
+    info.imageExtent.height    = vulkan_surface_height;
+    info.imageArrayLayers      = 1;
+    info.imageUsage            = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    info.imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = 0;
+    info.pQueueFamilyIndices   = nullptr;
+    info.preTransform          = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    info.compositeAlpha        = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    info.presentMode           = present_mode;
+    info.clipped               = VK_TRUE;
+    info.oldSwapchain          = old_swapchain;
+
+    // (Re)create a swap chain
+    HANDLE_VK_RESULT(vkCreateSwapchainKHR(vkbase.device(), &info, nullptr, &swapchain));
+
+    if (old_swapchain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(vkbase.device(), old_swapchain, nullptr);
+    }
+}
+
+
+void VulkanWindow::swapChainDestroy()
+{
+    vkDestroySwapchainKHR(vkbase.device(), swapchain, nullptr);
+}
+
+
+void VulkanWindow::swapChainImageViewsCreate()
+{
+    // Swap chain images, managed by swapchain
+    HANDLE_VK_RESULT(vkGetSwapchainImagesKHR(vkbase.device(), swapchain, &swapchain_image_count, nullptr));
+
+    swapchain_images.resize(swapchain_image_count);
+
+    HANDLE_VK_RESULT(vkGetSwapchainImagesKHR(vkbase.device(), swapchain, &swapchain_image_count, swapchain_images.data()));
+
+    swapchain_image_views.resize(swapchain_image_count);
+
+    for (uint32_t i = 0; i < swapchain_image_count; ++i)
+    {
+        VkImageViewCreateInfo info = {};
+        info.sType        = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        info.pNext        = nullptr;
+        info.image        = swapchain_images[i];
+        info.viewType     = VK_IMAGE_VIEW_TYPE_2D;
+        info.format       = surface_format.format;
+        info.components.r = VK_COMPONENT_SWIZZLE_R;
+        info.components.g = VK_COMPONENT_SWIZZLE_G;
+        info.components.b = VK_COMPONENT_SWIZZLE_B;
+        info.components.a = VK_COMPONENT_SWIZZLE_A;
+        info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        info.subresourceRange.baseMipLevel   = 0;
+        info.subresourceRange.levelCount     = 1;
+        info.subresourceRange.baseArrayLayer = 0;
+        info.subresourceRange.layerCount     = 1;
+
+        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &info, nullptr, &swapchain_image_views[i]));
+    }
+}
+
+
+void VulkanWindow::swapChainImageViewsDestroy()
+{
+    for (auto view : swapchain_image_views)
+    {
+        vkDestroyImageView(vkbase.device(), view, nullptr);
+    }
+}
+
+
+void VulkanWindow::fencesCreate()
+{
+    VkFenceCreateInfo info = {};
+
+    info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    HANDLE_VK_RESULT(vkCreateFence(vkbase.device(), &info, nullptr, &fence_draw));
+    HANDLE_VK_RESULT(vkCreateFence(vkbase.device(), &info, nullptr, &fence_compute));
+    HANDLE_VK_RESULT(vkCreateFence(vkbase.device(), &info, nullptr, &fence_diagnostics));
+}
+
+
+void VulkanWindow::fencesDestroy()
+{
+    vkDestroyFence(vkbase.device(), fence_draw, nullptr);
+    vkDestroyFence(vkbase.device(), fence_compute, nullptr);
+    vkDestroyFence(vkbase.device(), fence_diagnostics, nullptr);
+}
+
+
+void VulkanWindow::depthStencilCreate()
+{
+    VkImageCreateInfo image_info = {};
+
+    image_info.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.pNext       = nullptr;
+    image_info.imageType   = VK_IMAGE_TYPE_2D;
+    image_info.format      = depth_format;
+    image_info.extent      = { surface_capabilities.currentExtent.width, surface_capabilities.currentExtent.height, 1 };
+    image_info.mipLevels   = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples     = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling      = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage       = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_info.flags       = 0;
+    //    image_create_info.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkMemoryAllocateInfo mem_alloc = {};
+    mem_alloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_alloc.pNext           = nullptr;
+    mem_alloc.allocationSize  = 0;
+    mem_alloc.memoryTypeIndex = 0;
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.pNext            = nullptr;
+    view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format           = depth_format;
+    view_info.subresourceRange = {};
+    view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    view_info.subresourceRange.baseMipLevel   = 0;
+    view_info.subresourceRange.levelCount     = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount     = 1;
+
+    HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &vulkan_depth_stencil.image));
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(vkbase.device(), vulkan_depth_stencil.image, &memory_requirements);
+
+    VkMemoryAllocateInfo memory_info = {};
+    memory_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memory_info.allocationSize  = memory_requirements.size;
+    memory_info.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memory_info, nullptr, &vulkan_depth_stencil.mem));
+
+    HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), vulkan_depth_stencil.image, vulkan_depth_stencil.mem, 0));
+
+    // Change layout of depth stencil image to VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    {
+        VkImageSubresourceRange subresourceRange = {};
+        subresourceRange.aspectMask   = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        subresourceRange.baseMipLevel = 0;
+        subresourceRange.levelCount   = 1;
+        subresourceRange.layerCount   = 1;
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext            = nullptr;
+        barrier.oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout        = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barrier.image            = vulkan_depth_stencil.image;
+        barrier.subresourceRange = subresourceRange;
+        barrier.srcAccessMask    = 0;
+        barrier.dstAccessMask    = barrier.dstAccessMask | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        // Put barrier inside setup command buffer
+        VkCommandBuffer setup_command_buffer = commandBufferCreate();
+
+        vkCmdPipelineBarrier(
+            setup_command_buffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        commandBufferSubmitAndFree(setup_command_buffer);
+    }
+
+    view_info.image = vulkan_depth_stencil.image;
+    HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &vulkan_depth_stencil.view));
+}
+
+
+void VulkanWindow::depthStencilDestroy()
+{
+    vkDestroyImageView(vkbase.device(), vulkan_depth_stencil.view, nullptr);
+    vkDestroyImage(vkbase.device(), vulkan_depth_stencil.image, nullptr);
+    vkFreeMemory(vkbase.device(), vulkan_depth_stencil.mem, nullptr);
+}
+
+
+void VulkanWindow::semaphoresCreate()
+{
+    // Semaphores are used to coordinate operations between queues and between vulkan_substructure.vulkanPresentQueue () submissions within a single vulkan_substructure.vulkanPresentQueue ()
+    VkSemaphoreCreateInfo semaphore_create_info = {};
+
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_present_complete));
+    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_post_present_complete));
+    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_compute_step_1_complete));
+    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_draw_complete));
+    HANDLE_VK_RESULT(vkCreateSemaphore(vkbase.device(), &semaphore_create_info, nullptr, &semaphore_pre_present_complete));
+}
+
+
+void VulkanWindow::semaphoresDestroy()
+{
+    vkDestroySemaphore(vkbase.device(), semaphore_present_complete, nullptr);
+    vkDestroySemaphore(vkbase.device(), semaphore_post_present_complete, nullptr);
+    vkDestroySemaphore(vkbase.device(), semaphore_compute_step_1_complete, nullptr);
+    vkDestroySemaphore(vkbase.device(), semaphore_draw_complete, nullptr);
+    vkDestroySemaphore(vkbase.device(), semaphore_pre_present_complete, nullptr);
+}
+
+
+void VulkanWindow::renderPassesCreate()
+{
+    // Low dynamic range
+    {
+        QVector<VkAttachmentDescription> attachment_descriptions(2);
+
+        // Color attachment
+        attachment_descriptions[0].flags          = 0;
+        attachment_descriptions[0].format         = surface_format.format;
+        attachment_descriptions[0].samples        = VK_SAMPLE_COUNT_1_BIT;
+        attachment_descriptions[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment_descriptions[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment_descriptions[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment_descriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment_descriptions[0].initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachment_descriptions[0].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        // Depth attachment
+        attachment_descriptions[1].flags          = 0;
+        attachment_descriptions[1].format         = depth_format;
+        attachment_descriptions[1].samples        = VK_SAMPLE_COUNT_1_BIT;
+        attachment_descriptions[1].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment_descriptions[1].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment_descriptions[1].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment_descriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment_descriptions[1].initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachment_descriptions[1].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference color_attachment_reference;
+        color_attachment_reference.attachment = 0;
+        color_attachment_reference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depth_attachment_references = {};
+        depth_attachment_references.attachment = 1;
+        depth_attachment_references.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        QVector<VkSubpassDescription> subpass_descriptions(1);
+        subpass_descriptions[0].flags                   = 0;
+        subpass_descriptions[0].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass_descriptions[0].inputAttachmentCount    = 0;
+        subpass_descriptions[0].pInputAttachments       = nullptr;
+        subpass_descriptions[0].colorAttachmentCount    = 1;
+        subpass_descriptions[0].pColorAttachments       = &color_attachment_reference;
+        subpass_descriptions[0].pResolveAttachments     = nullptr;
+        subpass_descriptions[0].pDepthStencilAttachment = &depth_attachment_references;
+        subpass_descriptions[0].preserveAttachmentCount = 0;
+        subpass_descriptions[0].pPreserveAttachments    = nullptr;
+
+        VkRenderPassCreateInfo render_pass_create_info = {};
+        render_pass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        render_pass_create_info.pNext           = nullptr;
+        render_pass_create_info.flags           = 0;
+        render_pass_create_info.attachmentCount = static_cast<uint32_t> (attachment_descriptions.size());
+        render_pass_create_info.pAttachments    = attachment_descriptions.data();
+        render_pass_create_info.subpassCount    = static_cast<uint32_t> (subpass_descriptions.size());
+        render_pass_create_info.pSubpasses      = subpass_descriptions.data();
+        render_pass_create_info.dependencyCount = 0;
+        render_pass_create_info.pDependencies   = nullptr;
+
+        HANDLE_VK_RESULT(vkCreateRenderPass(vkbase.device(), &render_pass_create_info, nullptr, &render_pass_ldr));
+    }
+    // High dynamic range with depth attachment in addition
+    {
+        QVector<VkAttachmentDescription> attachment_descriptions(2);
+
+        // Color attachment
+        attachment_descriptions[0].flags          = 0;
+        attachment_descriptions[0].format         = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attachment_descriptions[0].samples        = VK_SAMPLE_COUNT_1_BIT;
+        attachment_descriptions[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment_descriptions[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment_descriptions[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment_descriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment_descriptions[0].initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachment_descriptions[0].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        // Depth attachment
+        attachment_descriptions[1].flags          = 0;
+        attachment_descriptions[1].format         = depth_format;
+        attachment_descriptions[1].samples        = VK_SAMPLE_COUNT_1_BIT;
+        attachment_descriptions[1].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment_descriptions[1].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment_descriptions[1].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment_descriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment_descriptions[1].initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachment_descriptions[1].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        QVector<VkAttachmentReference> color_attachment_references;
+        {
+            VkAttachmentReference reference = {};
+            reference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            reference.attachment = 0;
+
+            color_attachment_references << reference;
+        }
+
+        VkAttachmentReference depth_attachment_reference = {};
+        depth_attachment_reference.attachment = 1;
+        depth_attachment_reference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        QVector<VkSubpassDescription> subpass_descriptions(1);
+        subpass_descriptions[0].flags                   = 0;
+        subpass_descriptions[0].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass_descriptions[0].inputAttachmentCount    = 0;
+        subpass_descriptions[0].pInputAttachments       = nullptr;
+        subpass_descriptions[0].colorAttachmentCount    = static_cast<uint32_t> (color_attachment_references.size());
+        subpass_descriptions[0].pColorAttachments       = color_attachment_references.data();
+        subpass_descriptions[0].pResolveAttachments     = nullptr;
+        subpass_descriptions[0].pDepthStencilAttachment = &depth_attachment_reference;
+        subpass_descriptions[0].preserveAttachmentCount = 0;
+        subpass_descriptions[0].pPreserveAttachments    = nullptr;
+
+        VkRenderPassCreateInfo render_pass_create_info = {};
+        render_pass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        render_pass_create_info.pNext           = nullptr;
+        render_pass_create_info.flags           = 0;
+        render_pass_create_info.attachmentCount = static_cast<uint32_t> (attachment_descriptions.size());
+        render_pass_create_info.pAttachments    = attachment_descriptions.data();
+        render_pass_create_info.subpassCount    = static_cast<uint32_t> (subpass_descriptions.size());
+        render_pass_create_info.pSubpasses      = subpass_descriptions.data();
+        render_pass_create_info.dependencyCount = 0;
+        render_pass_create_info.pDependencies   = nullptr;
+
+        HANDLE_VK_RESULT(vkCreateRenderPass(vkbase.device(), &render_pass_create_info, nullptr, &render_pass_hdr_color_depth));
+    }
+    // High dynamic range, only color attachment
+    {
+        QVector<VkAttachmentDescription> attachment_descriptions(1);
+
+        // Color attachment
+        attachment_descriptions[0].flags          = 0;
+        attachment_descriptions[0].format         = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attachment_descriptions[0].samples        = VK_SAMPLE_COUNT_1_BIT;
+        attachment_descriptions[0].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment_descriptions[0].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment_descriptions[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment_descriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment_descriptions[0].initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachment_descriptions[0].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference color_attachment_reference;
+        color_attachment_reference.attachment = 0;
+        color_attachment_reference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        QVector<VkSubpassDescription> subpass_descriptions(1);
+        subpass_descriptions[0].flags                   = 0;
+        subpass_descriptions[0].pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass_descriptions[0].inputAttachmentCount    = 0;
+        subpass_descriptions[0].pInputAttachments       = nullptr;
+        subpass_descriptions[0].colorAttachmentCount    = 1;
+        subpass_descriptions[0].pColorAttachments       = &color_attachment_reference;
+        subpass_descriptions[0].pResolveAttachments     = nullptr;
+        subpass_descriptions[0].pDepthStencilAttachment = nullptr;
+        subpass_descriptions[0].preserveAttachmentCount = 0;
+        subpass_descriptions[0].pPreserveAttachments    = nullptr;
+
+        VkRenderPassCreateInfo render_pass_create_info = {};
+        render_pass_create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        render_pass_create_info.pNext           = nullptr;
+        render_pass_create_info.flags           = 0;
+        render_pass_create_info.attachmentCount = static_cast<uint32_t> (attachment_descriptions.size());
+        render_pass_create_info.pAttachments    = attachment_descriptions.data();
+        render_pass_create_info.subpassCount    = static_cast<uint32_t> (subpass_descriptions.size());
+        render_pass_create_info.pSubpasses      = subpass_descriptions.data();
+        render_pass_create_info.dependencyCount = 0;
+        render_pass_create_info.pDependencies   = nullptr;
+
+        HANDLE_VK_RESULT(vkCreateRenderPass(vkbase.device(), &render_pass_create_info, nullptr, &render_pass_hdr));
+    }
+}
+
+
+void VulkanWindow::renderPassDestroy()
+{
+    vkDestroyRenderPass(vkbase.device(), render_pass_ldr, nullptr);
+    vkDestroyRenderPass(vkbase.device(), render_pass_hdr_color_depth, nullptr);
+    vkDestroyRenderPass(vkbase.device(), render_pass_hdr, nullptr);
+}
+
+
+void VulkanWindow::frameBuffersCreate()
+{
+    // Swapchain fbos
+    QVector<VkImageView> attachments(2);
+    attachments[1] = vulkan_depth_stencil.view;
+
+    VkFramebufferCreateInfo framebuffer_create_info = {};
+    framebuffer_create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_create_info.pNext           = nullptr;
+    framebuffer_create_info.flags           = 0;
+    framebuffer_create_info.renderPass      = render_pass_ldr;
+    framebuffer_create_info.attachmentCount = static_cast<uint32_t> (attachments.size());
+    framebuffer_create_info.pAttachments    = attachments.data();
+    framebuffer_create_info.width           = surface_capabilities.currentExtent.width;
+    framebuffer_create_info.height          = surface_capabilities.currentExtent.height;
+    framebuffer_create_info.layers          = 1;
+
+    framebuffers_swapchain.resize(swapchain_image_count);
+
+    for (auto i = 0; i < framebuffers_swapchain.size(); ++i)
+    {
+        attachments[0] = swapchain_image_views[i];
+
+        HANDLE_VK_RESULT(vkCreateFramebuffer(vkbase.device(), &framebuffer_create_info, nullptr, &framebuffers_swapchain[i]));
+    }
+
+    // Other fbos, all HDR
+    framebufferSceneHDRCreate(&framebuffer_scene);
+    framebufferStandardHDRCreate(&framebuffer_luminosity, framebuffer_size_blur_pass[0], framebuffer_size_blur_pass[1]);
+    framebufferStandardHDRCreate(&framebuffer_blur_alpha, framebuffer_size_blur_pass[0], framebuffer_size_blur_pass[1]);
+    framebufferStandardHDRCreate(&framebuffer_blur_beta, framebuffer_size_blur_pass[0], framebuffer_size_blur_pass[1]);
+    framebufferStandardHDRCreate(&framebuffer_combine, surface_capabilities.currentExtent.width, surface_capabilities.currentExtent.height);
+
+
+    // Sampler for the HDR framebuffers
+    VkSamplerCreateInfo samplerCreateInfo = {};
+    samplerCreateInfo.sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.pNext         = nullptr;
+    samplerCreateInfo.magFilter     = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter     = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode    = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerCreateInfo.addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerCreateInfo.addressModeV  = samplerCreateInfo.addressModeU;
+    samplerCreateInfo.addressModeW  = samplerCreateInfo.addressModeU;
+    samplerCreateInfo.mipLodBias    = 0.0f;
+    samplerCreateInfo.maxAnisotropy = 0;
+    samplerCreateInfo.minLod        = 0.0f;
+    samplerCreateInfo.maxLod        = 0.0f;
+    samplerCreateInfo.borderColor   = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    HANDLE_VK_RESULT(vkCreateSampler(vkbase.device(), &samplerCreateInfo, nullptr, &sampler_standard));
+}
+
+
+void VulkanWindow::framebufferStandardHDRCreate(Framebuffer *framebuffer, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkAccessFlags dst_access_mask, VkImageLayout new_layout)
+{
+    framebuffer->width  = width;
+    framebuffer->height = height;
+
+    QVector<VkImageView> attachments;
+
+    // Color attachment
+    {
+        framebuffer->color_attachment.enabled = true;
+
+        // Color attachment
+        VkImageCreateInfo image_info = {};
+        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.pNext         = nullptr;
+        image_info.imageType     = VK_IMAGE_TYPE_2D;
+        image_info.format        = VK_FORMAT_R32G32B32A32_SFLOAT;
+        image_info.extent.width  = framebuffer->width;
+        image_info.extent.height = framebuffer->height;
+        image_info.extent.depth  = 1;
+        image_info.mipLevels     = 1;
+        image_info.arrayLayers   = 1;
+        image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage         = usage;
+
+        HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &framebuffer->color_attachment.image));
+
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(vkbase.device(), framebuffer->color_attachment.image, &memReqs);
+
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.pNext           = NULL;
+        memAlloc.allocationSize  = 0;
+        memAlloc.memoryTypeIndex = 0;
+        memAlloc.allocationSize  = memReqs.size;
+        memAlloc.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memAlloc, nullptr, &framebuffer->color_attachment.mem));
+        HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), framebuffer->color_attachment.image, framebuffer->color_attachment.mem, 0));
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.pNext            = nullptr;
+        view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format           = VK_FORMAT_R32G32B32A32_SFLOAT;
+        view_info.flags            = 0;
+        view_info.subresourceRange = {};
+        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel   = 0;
+        view_info.subresourceRange.levelCount     = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount     = 1;
+        view_info.image = framebuffer->color_attachment.image;
+        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &framebuffer->color_attachment.view));
+
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            barrier.image         = framebuffer->color_attachment.image;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dst_access_mask;
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout     = new_layout;
+
+            VkCommandBuffer command_buffer = commandBufferCreate();
+
+            vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
+
+            commandBufferSubmitAndFree(command_buffer);
+        }
+
+        attachments << framebuffer->color_attachment.view;
+    }
+
+    VkFramebufferCreateInfo fbufCreateInfo = {};
+    fbufCreateInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fbufCreateInfo.pNext           = nullptr;
+    fbufCreateInfo.renderPass      = render_pass_hdr;
+    fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    fbufCreateInfo.pAttachments    = attachments.data();
+    fbufCreateInfo.width           = framebuffer->width;
+    fbufCreateInfo.height          = framebuffer->height;
+    fbufCreateInfo.layers          = 1;
+
+    HANDLE_VK_RESULT(vkCreateFramebuffer(vkbase.device(), &fbufCreateInfo, nullptr, &framebuffer->framebuffer));
+}
+
+
+void VulkanWindow::hdrFramebufferDestroy(VulkanWindow::Framebuffer *framebuffer)
+{
+    vkDestroyImageView(vkbase.device(), framebuffer->color_attachment.view, nullptr);
+    vkDestroyImage(vkbase.device(), framebuffer->color_attachment.image, nullptr);
+    vkFreeMemory(vkbase.device(), framebuffer->color_attachment.mem, nullptr);
+
+    if (framebuffer->depth_attachment.enabled == true)
+    {
+        vkDestroyImageView(vkbase.device(), framebuffer->depth_attachment.view, nullptr);
+        vkDestroyImage(vkbase.device(), framebuffer->depth_attachment.image, nullptr);
+        vkFreeMemory(vkbase.device(), framebuffer->depth_attachment.mem, nullptr);
+    }
+
+    vkDestroyFramebuffer(vkbase.device(), framebuffer->framebuffer, nullptr);
+}
+
+
+void VulkanWindow::frameBuffersDestroy()
+{
+    for (auto i = 0; i < framebuffers_swapchain.size(); ++i)
+    {
+        vkDestroyFramebuffer(vkbase.device(), framebuffers_swapchain[i], nullptr);
+    }
+
+    hdrFramebufferDestroy(&framebuffer_scene);
+    hdrFramebufferDestroy(&framebuffer_blur_alpha);
+    hdrFramebufferDestroy(&framebuffer_blur_beta);
+    hdrFramebufferDestroy(&framebuffer_luminosity);
+    hdrFramebufferDestroy(&framebuffer_combine);
+
+    vkDestroySampler(vkbase.device(), sampler_standard, nullptr);
+}
+
+
+void VulkanWindow::framebufferSceneHDRCreate(VulkanWindow::Framebuffer *framebuffer)
+{
+    framebuffer->width  = surface_capabilities.currentExtent.width;
+    framebuffer->height = surface_capabilities.currentExtent.height;
+
+    QVector<VkImageView> attachments;
+
+    // Color attachment
+    {
+        framebuffer->color_attachment.enabled = true;
+
+        // Color attachment
+        VkImageCreateInfo image_info = {};
+        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.pNext         = nullptr;
+        image_info.imageType     = VK_IMAGE_TYPE_2D;
+        image_info.format        = VK_FORMAT_R32G32B32A32_SFLOAT;
+        image_info.extent.width  = framebuffer->width;
+        image_info.extent.height = framebuffer->height;
+        image_info.extent.depth  = 1;
+        image_info.mipLevels     = 1;
+        image_info.arrayLayers   = 1;
+        image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+        HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &framebuffer->color_attachment.image));
+
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(vkbase.device(), framebuffer->color_attachment.image, &memReqs);
+
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.pNext           = NULL;
+        memAlloc.allocationSize  = 0;
+        memAlloc.memoryTypeIndex = 0;
+        memAlloc.allocationSize  = memReqs.size;
+        memAlloc.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memAlloc, nullptr, &framebuffer->color_attachment.mem));
+        HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), framebuffer->color_attachment.image, framebuffer->color_attachment.mem, 0));
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.pNext            = nullptr;
+        view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format           = VK_FORMAT_R32G32B32A32_SFLOAT;
+        view_info.flags            = 0;
+        view_info.subresourceRange = {};
+        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel   = 0;
+        view_info.subresourceRange.levelCount     = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount     = 1;
+        view_info.image = framebuffer->color_attachment.image;
+        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &framebuffer->color_attachment.view));
+
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            barrier.image         = framebuffer->color_attachment.image;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+            VkCommandBuffer command_buffer = commandBufferCreate();
+
+            vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
+
+            commandBufferSubmitAndFree(command_buffer);
+        }
+
+        attachments << framebuffer->color_attachment.view;
+    }
+
+    // Depth stencil attachment
+    {
+        framebuffer->depth_attachment.enabled = true;
+
+        VkImageCreateInfo image_info = {};
+        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.pNext         = nullptr;
+        image_info.imageType     = VK_IMAGE_TYPE_2D;
+        image_info.extent.width  = framebuffer->width;
+        image_info.extent.height = framebuffer->height;
+        image_info.extent.depth  = 1;
+        image_info.mipLevels     = 1;
+        image_info.arrayLayers   = 1;
+        image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        image_info.format        = depth_format;
+        image_info.usage         = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &framebuffer->depth_attachment.image));
+
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(vkbase.device(), framebuffer->depth_attachment.image, &memReqs);
+
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.pNext           = NULL;
+        memAlloc.allocationSize  = 0;
+        memAlloc.memoryTypeIndex = 0;
+        memAlloc.allocationSize  = memReqs.size;
+        memAlloc.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memAlloc, nullptr, &framebuffer->depth_attachment.mem));
+        HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), framebuffer->depth_attachment.image, framebuffer->depth_attachment.mem, 0));
+
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange    = { VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 };
+            barrier.image         = framebuffer->depth_attachment.image;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+            VkCommandBuffer command_buffer = commandBufferCreate();
+
+            vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
+
+            commandBufferSubmitAndFree(command_buffer);
+        }
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.pNext            = nullptr;
+        view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format           = depth_format;
+        view_info.flags            = 0;
+        view_info.subresourceRange = {};
+        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        view_info.subresourceRange.baseMipLevel   = 0;
+        view_info.subresourceRange.levelCount     = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount     = 1;
+        view_info.image = framebuffer->depth_attachment.image;
+        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &framebuffer->depth_attachment.view));
+
+        attachments << framebuffer->depth_attachment.view;
+    }
+
+    VkFramebufferCreateInfo fbufCreateInfo = {};
+    fbufCreateInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fbufCreateInfo.pNext           = nullptr;
+    fbufCreateInfo.renderPass      = render_pass_hdr_color_depth;
+    fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    fbufCreateInfo.pAttachments    = attachments.data();
+    fbufCreateInfo.width           = framebuffer->width;
+    fbufCreateInfo.height          = framebuffer->height;
+    fbufCreateInfo.layers          = 1;
+
+    HANDLE_VK_RESULT(vkCreateFramebuffer(vkbase.device(), &fbufCreateInfo, nullptr, &framebuffer->framebuffer));
+}
+
+
+void VulkanWindow::commandPoolCreate()
+{
+    // Create command pool
+    VkCommandPoolCreateInfo pool_create_info = {};
+
+    pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_create_info.queueFamilyIndex = vkbase.queueFamilyIndex();
+    pool_create_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    HANDLE_VK_RESULT(vkCreateCommandPool(vkbase.device(), &pool_create_info, nullptr, &command_pool));
+}
+
+
+void VulkanWindow::commandPoolDestroy()
+{
+    HANDLE_VK_RESULT(vkDeviceWaitIdle(vkbase.device()));
+
+    vkDestroyCommandPool(vkbase.device(), command_pool, nullptr);
+}
+
+
+void VulkanWindow::commandBuffersAllocate()
+{
+    command_buffer_draw.resize(swapchain_image_count * NBODY_BUFFER_COUNT); // One per swapchain image and particle buffer
+    command_buffer_pre_present.resize(swapchain_image_count);
+    command_buffer_post_present.resize(swapchain_image_count);
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool        = command_pool;
+    command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = swapchain_image_count;
+
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_pre_present.data()));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_post_present.data()));
+
+    command_buffer_allocate_info.commandBufferCount = static_cast<uint32_t> (command_buffer_draw.size());
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_draw.data()));
+
+    command_buffer_allocate_info.commandBufferCount = NBODY_BUFFER_COUNT;
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_step_1));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_step_2));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_batch));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_reorder));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_slice));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_diagnostics));
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_compute_stream));
+}
+
+
+void VulkanWindow::commandBuffersPresentRecord()
+{
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = nullptr;
+
+    for (uint32_t i = 0; i < swapchain_image_count; i++)
+    {
+        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_post_present[i], &cmdBufferBeginInfo));
+
+        VkImageMemoryBarrier postPresentBarrier = {};
+        postPresentBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        postPresentBarrier.pNext               = nullptr;
+        postPresentBarrier.srcAccessMask       = 0;
+        postPresentBarrier.dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        postPresentBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        postPresentBarrier.newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        postPresentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        postPresentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        postPresentBarrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        postPresentBarrier.image               = swapchain_images[i];
+
+        vkCmdPipelineBarrier(
+            command_buffer_post_present[i],
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &postPresentBarrier);
+
+        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_post_present[i]));
+
+        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_pre_present[i], &cmdBufferBeginInfo));
+
+        VkImageMemoryBarrier prePresentBarrier = {};
+        prePresentBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        prePresentBarrier.pNext               = nullptr;
+        prePresentBarrier.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        prePresentBarrier.dstAccessMask       = VK_ACCESS_MEMORY_READ_BIT;
+        prePresentBarrier.oldLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        prePresentBarrier.newLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        prePresentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        prePresentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        prePresentBarrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        prePresentBarrier.image               = swapchain_images[i];
+
+        vkCmdPipelineBarrier(
+            command_buffer_pre_present[i],
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &prePresentBarrier);
+
+        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_pre_present[i]));
+    }
+}
+
+
+VkCommandBuffer VulkanWindow::commandBufferCreate()
+{
+    VkCommandBuffer command_buffer;
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+
+    command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool        = command_pool;
+    command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = 1;
+
+    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, &command_buffer));
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = nullptr;
+    HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmdBufferBeginInfo));
+
+    return command_buffer;
+}
+
+
+void VulkanWindow::commandBufferSubmitAndFree(VkCommandBuffer command_buffer)
+{
+    if (command_buffer == VK_NULL_HANDLE)
+    {
+        qWarning("A command buffer that was a null handle was sent to be freed");
+        return;
+    }
+
+    HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &command_buffer;
+
+    HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
+
+    vkFreeCommandBuffers(vkbase.device(), command_pool, 1, &command_buffer);
+}
+
+
+void VulkanWindow::commandBuffersGraphicsRecord()
+{
+    VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
+
+    cmd_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmd_buffer_begin_info.pNext            = nullptr;
+    cmd_buffer_begin_info.pInheritanceInfo = nullptr;
+
+    for (uint32_t i = 0; i < static_cast<uint32_t> (command_buffer_draw.size()); ++i)
+    {
+        // One command buffer per swapchain image and particle buffer
+        uint32_t image_index = i % swapchain_image_count;
+        uint32_t nbody_slot  = i / swapchain_image_count;
+
+        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_draw[i], &cmd_buffer_begin_info));
+
+        vkCmdResetQueryPool(command_buffer_draw[i], query_pool_graphics, 0, 14);
+        vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, query_pool_graphics, 12);
+
+        // Scene
+        {
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 0);
+
+            VkViewport viewport = {};
+            viewport.width    = static_cast<float> (framebuffer_scene.width);
+            viewport.height   = static_cast<float> (framebuffer_scene.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor = {};
+            scissor.extent.width  = framebuffer_scene.width;
+            scissor.extent.height = framebuffer_scene.height;
+            scissor.offset.x      = 0;
+            scissor.offset.y      = 0;
+
+            VkClearValue clear_values[3];
+            clear_values[0].color        = { 0.0f, 0.0f, 0.0f, 0.0f };
+            clear_values[1].color        = { 0.0f, 0.0f, 0.0f, 0.0f };
+            clear_values[2].depthStencil = { 1.0f, 0 };
+
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.pNext = nullptr;
+            render_pass_begin_info.renderArea.offset.x      = 0;
+            render_pass_begin_info.renderArea.offset.y      = 0;
+            render_pass_begin_info.renderPass               = render_pass_hdr_color_depth;
+            render_pass_begin_info.renderArea.extent.width  = framebuffer_scene.width;
+            render_pass_begin_info.renderArea.extent.height = framebuffer_scene.height;
+            render_pass_begin_info.clearValueCount          = 3;
+            render_pass_begin_info.pClearValues             = clear_values;
+
+            // Change layout of framebuffer attachments
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.image         = framebuffer_scene.color_attachment.image;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                vkCmdPipelineBarrier(
+                    command_buffer_draw[i],
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    0,
+                    0, nullptr,
+                    0, nullptr,
+                    1, &barrier);
+            }
+
+            render_pass_begin_info.framebuffer = framebuffer_scene.framebuffer;
+
+            // Clear the color and depth attachment
+            vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+            vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
+            vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+
+            // Draw particles
+            vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_nbody);
+            vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_nbody, 0, 1, &descriptor_nbody, 0, nullptr);
+
+            VkDeviceSize offsets[1]          = { 0 };
+            VkDeviceSize offsets_velocity[1] = { static_cast<VkDeviceSize>(ubo_nbody_compute.particle_count) * 4 * sizeof(float) };
+            vkCmdBindVertexBuffers(command_buffer_draw[i],
+                                   INSTANCE_BUFFER_BIND_ID,
+                                   1,
+                                   &buffer_nbody[nbody_slot].buffer,
+                                   offsets);
+            vkCmdBindVertexBuffers(command_buffer_draw[i],
+                                   INSTANCE_VELOCITY_BUFFER_BIND_ID,
+                                   1,
+                                   &buffer_nbody[nbody_slot].buffer,
+                                   offsets_velocity);
+            vkCmdBindVertexBuffers(command_buffer_draw[i],
+                                   VERTEX_BUFFER_BIND_ID,
+                                   1,
+                                   &vertices_corner.buffer,
+                                   offsets);
+            vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+
+            vkCmdDrawIndexed(command_buffer_draw[i], 6, ubo_nbody_compute.particle_count, 0, 0, 0);
+
+            // End render pass
+            vkCmdEndRenderPass(command_buffer_draw[i]);
+
+            // Change layout of framebuffer attachments
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.image         = framebuffer_scene.color_attachment.image;
+                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+                vkCmdPipelineBarrier(
+                    command_buffer_draw[i],
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    0,
+                    0, nullptr,
+                    0, nullptr,
+                    1, &barrier);
+            }
+
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 1);
+        }
+
+
+        // Luminosity
+        {
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 2);
+
+            VkViewport viewport = {};
+            viewport.width    = static_cast<float> (framebuffer_luminosity.width);
+            viewport.height   = static_cast<float> (framebuffer_luminosity.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor = {};
+            scissor.extent.width  = framebuffer_luminosity.width;
+            scissor.extent.height = framebuffer_luminosity.height;
+            scissor.offset.x      = 0;
+            scissor.offset.y      = 0;
+
+            VkClearValue clear_values[1];
+            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.pNext = nullptr;
+            render_pass_begin_info.renderArea.offset.x      = 0;
+            render_pass_begin_info.renderArea.offset.y      = 0;
+            render_pass_begin_info.renderPass               = render_pass_hdr;
+            render_pass_begin_info.renderArea.extent.width  = framebuffer_luminosity.width;
+            render_pass_begin_info.renderArea.extent.height = framebuffer_luminosity.height;
+            render_pass_begin_info.clearValueCount          = 1;
+            render_pass_begin_info.pClearValues             = clear_values;
+
+            // Change layout of output framebuffer
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.image         = framebuffer_luminosity.color_attachment.image;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                vkCmdPipelineBarrier(
+                    command_buffer_draw[i],
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    0,
+                    0, nullptr,
+                    0, nullptr,
+                    1, &barrier);
+            }
+
+            // Execute shader
+            {
+                render_pass_begin_info.framebuffer = framebuffer_luminosity.framebuffer;
+
+                // Clear the color and depth attachment
+                vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
+                vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+
+                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_luminosity);
+                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_normal_texture, 0, 1, &descriptor_luminosity, 0, nullptr);
+
+                VkDeviceSize offsets[1] = { 0 };
+                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+
+                // Bind index buffer
+                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                // Draw vertices
+                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                // End render pass
+                vkCmdEndRenderPass(command_buffer_draw[i]);
+            }
+
+            // Change layout of output framebuffer
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.image         = framebuffer_luminosity.color_attachment.image;
+                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+                vkCmdPipelineBarrier(
+                    command_buffer_draw[i],
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    0,
+                    0, nullptr,
+                    0, nullptr,
+                    1, &barrier);
+            }
+
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 3);
+        }
+
+        // Bloom (two blur passes)
+        {
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 4);
+
+            VkViewport viewport = {};
+            viewport.width    = static_cast<float> (framebuffer_blur_alpha.width);
+            viewport.height   = static_cast<float> (framebuffer_blur_alpha.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor = {};
+            scissor.extent.width  = framebuffer_blur_alpha.width;
+            scissor.extent.height = framebuffer_blur_alpha.height;
+            scissor.offset.x      = 0;
+            scissor.offset.y      = 0;
+
+            VkClearValue clear_values[1];
+            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.pNext = nullptr;
+            render_pass_begin_info.renderArea.offset.x      = 0;
+            render_pass_begin_info.renderArea.offset.y      = 0;
+            render_pass_begin_info.renderPass               = render_pass_hdr;
+            render_pass_begin_info.renderArea.extent.width  = framebuffer_blur_alpha.width;
+            render_pass_begin_info.renderArea.extent.height = framebuffer_blur_alpha.height;
+            render_pass_begin_info.clearValueCount          = 1;
+            render_pass_begin_info.pClearValues             = clear_values;
+
+            // Blur in one direction
+            {
+                // Change layout of output framebuffer
+                {
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.pNext = nullptr;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                    barrier.image         = framebuffer_blur_alpha.color_attachment.image;
+                    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                    barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                    vkCmdPipelineBarrier(
+                        command_buffer_draw[i],
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        0, nullptr,
+                        0, nullptr,
+                        1, &barrier);
+                }
+
+                // Execute shader
+                {
+                    render_pass_begin_info.framebuffer = framebuffer_blur_alpha.framebuffer;
+
+                    // Clear the color and depth attachment
+                    vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
+                    vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+
+                    push_constants.horizontal = 1;
+
+                    vkCmdPushConstants(
+                        command_buffer_draw[i],
+                        pipeline_layout_blur,
+                        VK_SHADER_STAGE_FRAGMENT_BIT,
+                        0,
+                        sizeof(push_constants),
+                        &push_constants);
+
+                    vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_blur);
+                    vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_blur, 0, 1, &descriptor_blur_alpha, 0, nullptr);
+
+                    VkDeviceSize offsets[1] = { 0 };
+                    vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+
+                    // Bind index buffer
+                    vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                    // Draw vertices
+                    vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                    // End render pass
+                    vkCmdEndRenderPass(command_buffer_draw[i]);
+                }
+
+                // Change layout of output framebuffer
+                {
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.pNext = nullptr;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                    barrier.image         = framebuffer_blur_alpha.color_attachment.image;
+                    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+                    vkCmdPipelineBarrier(
+                        command_buffer_draw[i],
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        0, nullptr,
+                        0, nullptr,
+                        1, &barrier);
+                }
+            }
+
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 5);
+        }
+        // Blur in the other direction, using the previous framebuffers as inputs
+        {
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 6);
+
+            VkViewport viewport = {};
+            viewport.width    = static_cast<float> (framebuffer_blur_beta.width);
+            viewport.height   = static_cast<float> (framebuffer_blur_beta.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor = {};
+            scissor.extent.width  = framebuffer_blur_beta.width;
+            scissor.extent.height = framebuffer_blur_beta.height;
+            scissor.offset.x      = 0;
+            scissor.offset.y      = 0;
+
+            VkClearValue clear_values[1];
+            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.pNext = nullptr;
+            render_pass_begin_info.renderArea.offset.x      = 0;
+            render_pass_begin_info.renderArea.offset.y      = 0;
+            render_pass_begin_info.renderPass               = render_pass_hdr;
+            render_pass_begin_info.renderArea.extent.width  = framebuffer_blur_beta.width;
+            render_pass_begin_info.renderArea.extent.height = framebuffer_blur_beta.height;
+            render_pass_begin_info.clearValueCount          = 1;
+            render_pass_begin_info.pClearValues             = clear_values;
+
+            {
+                // Change layout of output framebuffer
+                {
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.pNext = nullptr;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                    barrier.image         = framebuffer_blur_beta.color_attachment.image;
+                    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                    barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                    vkCmdPipelineBarrier(
+                        command_buffer_draw[i],
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        0, nullptr,
+                        0, nullptr,
+                        1, &barrier);
+                }
+
+                // Execute shader
+                {
+                    render_pass_begin_info.framebuffer = framebuffer_blur_beta.framebuffer;
+
+                    // Clear the color and depth attachment
+                    vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
+                    vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+
+                    vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_blur);
+
+                    VkDeviceSize offsets[1] = { 0 };
+                    vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+
+                    // Bind index buffer
+                    vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+
+                    push_constants.horizontal = 0;
+
+                    vkCmdPushConstants(
+                        command_buffer_draw[i],
+                        pipeline_layout_blur,
+                        VK_SHADER_STAGE_FRAGMENT_BIT,
+                        0,
+                        sizeof(push_constants),
+                        &push_constants);
+
+                    vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_blur, 0, 1, &descriptor_blur_beta, 0, nullptr);
+
+                    // Draw vertices
+                    vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                    // End render pass
+                    vkCmdEndRenderPass(command_buffer_draw[i]);
+                }
+
+                // Change layout of framebuffer
+                {
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.pNext = nullptr;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                    barrier.image         = framebuffer_blur_beta.color_attachment.image;
+                    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+                    vkCmdPipelineBarrier(
+                        command_buffer_draw[i],
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        0, nullptr,
+                        0, nullptr,
+                        1, &barrier);
+                }
+            }
+
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 7);
+        }
+
+        // Combine
+        {
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 8);
+
+            VkViewport viewport = {};
+            viewport.width    = static_cast<float> (framebuffer_combine.width);
+            viewport.height   = static_cast<float> (framebuffer_combine.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor = {};
+            scissor.extent.width  = framebuffer_combine.width;
+            scissor.extent.height = framebuffer_combine.height;
+            scissor.offset.x      = 0;
+            scissor.offset.y      = 0;
+
+            VkClearValue clear_values[1];
+            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.pNext = nullptr;
+            render_pass_begin_info.renderArea.offset.x      = 0;
+            render_pass_begin_info.renderArea.offset.y      = 0;
+            render_pass_begin_info.renderPass               = render_pass_hdr;
+            render_pass_begin_info.renderArea.extent.width  = framebuffer_combine.width;
+            render_pass_begin_info.renderArea.extent.height = framebuffer_combine.height;
+            render_pass_begin_info.clearValueCount          = 1;
+            render_pass_begin_info.pClearValues             = clear_values;
+
+            // Change layout of output framebuffer
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.image         = framebuffer_combine.color_attachment.image;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                vkCmdPipelineBarrier(
+                    command_buffer_draw[i],
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    0,
+                    0, nullptr,
+                    0, nullptr,
+                    1, &barrier);
+            }
+
+            // Execute shader
+            {
+                render_pass_begin_info.framebuffer = framebuffer_combine.framebuffer;
+
+                // Clear the color and depth attachment
+                vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
+                vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+
+                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_normal_texture);
+
+                VkDeviceSize offsets[1] = { 0 };
+                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+
+                // Bind index buffer
+                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                // Draw blur fbo
+                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_normal_texture, 0, 1, &descriptor_normal_texture_blur, 0, nullptr);
+                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                // Draw scene fbo
+                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_normal_texture, 0, 1, &descriptor_normal_texture_scene, 0, nullptr);
+                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                // Draw Performance meter for graphics
+                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_performance);
+                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_performance, 0, 1, &descriptor_performance_graphics, 0, nullptr);
+
+                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_performance_meter_graphics.buffer, offsets);
+                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                // Draw Performance meter for compute
+                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_performance, 0, 1, &descriptor_performance_compute, 0, nullptr);
+
+                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_performance_meter_compute.buffer, offsets);
+                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                // End render pass
+                vkCmdEndRenderPass(command_buffer_draw[i]);
+            }
+
+            // Change layout of output framebuffer
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.image         = framebuffer_combine.color_attachment.image;
+                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+                vkCmdPipelineBarrier(
+                    command_buffer_draw[i],
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    0,
+                    0, nullptr,
+                    0, nullptr,
+                    1, &barrier);
+            }
+
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 9);
+        }
+
+        // Tone mapping
+        {
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 10);
+
+            VkViewport viewport = {};
+            viewport.width    = static_cast<float> (surface_capabilities.currentExtent.width);
+            viewport.height   = static_cast<float> (surface_capabilities.currentExtent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+
+            VkRect2D scissor = {};
+            scissor.extent.width  = surface_capabilities.currentExtent.width;
+            scissor.extent.height = surface_capabilities.currentExtent.height;
+            scissor.offset.x      = 0;
+            scissor.offset.y      = 0;
+
+            VkClearValue clear_values[2];
+            clear_values[0].color        = { 0.0f, 0.0f, 0.0f, 0.0f };
+            clear_values[1].depthStencil = { 1.0f, 0 };
+
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.pNext = nullptr;
+            render_pass_begin_info.renderArea.offset.x      = 0;
+            render_pass_begin_info.renderArea.offset.y      = 0;
+            render_pass_begin_info.renderPass               = render_pass_ldr;
+            render_pass_begin_info.renderArea.extent.width  = surface_capabilities.currentExtent.width;
+            render_pass_begin_info.renderArea.extent.height = surface_capabilities.currentExtent.height;
+            render_pass_begin_info.clearValueCount          = 2;
+            render_pass_begin_info.pClearValues             = clear_values;
+
+            // Execute shader
+            {
+                render_pass_begin_info.framebuffer = framebuffers_swapchain[image_index];
+
+                // Clear the color and depth attachment
+                vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
+                vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+
+                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_tone_mapping);
+                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_tone_mapping, 0, 1, &descriptor_tone_mapping, 0, nullptr);
+
+                VkDeviceSize offsets[1] = { 0 };
+                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+
+                // Draw post processed scene
+                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+
+                vkCmdEndRenderPass(command_buffer_draw[i]);
+            }
+
+            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 11);
+        }
+
+        vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 13);
+
+        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_draw[i]));
+    }
 }
 
 
-void VulkanWindow::framebufferSceneHDRCreate(VulkanWindow::Framebuffer *framebuffer)
+void VulkanWindow::commandBuffersComputeRecord()
 {
-    framebuffer->width  = surface_capabilities.currentExtent.width;
-    framebuffer->height = surface_capabilities.currentExtent.height;
+    VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
 
-    QVector<VkImageView> attachments;
+    cmd_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmd_buffer_begin_info.pNext            = nullptr;
+    cmd_buffer_begin_info.pInheritanceInfo = nullptr;
 
-    // Color attachment
+    // Compute to compute barrier between the kick and drift passes and between the steps of a batch
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    // Barrier between the steps of a batch, whose next step may start with a transfer: the block copy reads the state written
+    // by the previous step, and the tree pass clears its bounds buffer
+    VkMemoryBarrier step_barrier = {};
+    step_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    step_barrier.pNext         = nullptr;
+    step_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    step_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    // One set of command buffers per particle buffer in the ring. Each reads slot i and writes slot i + 1
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
     {
-        framebuffer->color_attachment.enabled = true;
+        uint32_t nbody_slot_write = (i + 1) % NBODY_BUFFER_COUNT;
 
-        // Color attachment
-        VkImageCreateInfo image_info = {};
-        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        image_info.pNext         = nullptr;
-        image_info.imageType     = VK_IMAGE_TYPE_2D;
-        image_info.format        = VK_FORMAT_R32G32B32A32_SFLOAT;
-        image_info.extent.width  = framebuffer->width;
-        image_info.extent.height = framebuffer->height;
-        image_info.extent.depth  = 1;
-        image_info.mipLevels     = 1;
-        image_info.arrayLayers   = 1;
-        image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
-        image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
-        image_info.usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        // Compute command buffer step 1
+        {
+            VkCommandBuffer command_buffer = command_buffer_compute_step_1[i];
 
-        HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &framebuffer->color_attachment.image));
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
 
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements(vkbase.device(), framebuffer->color_attachment.image, &memReqs);
+            vkCmdResetQueryPool(command_buffer, query_pool_compute, 0, 2);
+            vkCmdResetQueryPool(command_buffer, query_pool_compute, 4, 2);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 0);
 
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.pNext           = NULL;
-        memAlloc.allocationSize  = 0;
-        memAlloc.memoryTypeIndex = 0;
-        memAlloc.allocationSize  = memReqs.size;
-        memAlloc.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memAlloc, nullptr, &framebuffer->color_attachment.mem));
-        HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), framebuffer->color_attachment.image, framebuffer->color_attachment.mem, 0));
+            commandBufferComputeKickRecord(command_buffer, descriptor_leapfrog[i], descriptor_tree[i], 0, true);
 
-        VkImageViewCreateInfo view_info = {};
-        view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        view_info.pNext            = nullptr;
-        view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
-        view_info.format           = VK_FORMAT_R32G32B32A32_SFLOAT;
-        view_info.flags            = 0;
-        view_info.subresourceRange = {};
-        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-        view_info.subresourceRange.baseMipLevel   = 0;
-        view_info.subresourceRange.levelCount     = 1;
-        view_info.subresourceRange.baseArrayLayer = 0;
-        view_info.subresourceRange.layerCount     = 1;
-        view_info.image = framebuffer->color_attachment.image;
-        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &framebuffer->color_attachment.view));
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 1);
 
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+        }
+        // Compute command buffer of a kick slice. The work group offset of the slice is set in the uniforms at submission
         {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.pNext = nullptr;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-            barrier.image         = framebuffer->color_attachment.image;
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
-            barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            VkCommandBuffer command_buffer = command_buffer_compute_slice[i];
 
-            VkCommandBuffer command_buffer = commandBufferCreate();
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
 
-            vkCmdPipelineBarrier(
-                command_buffer,
-                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
+            commandBufferComputeKickRecord(command_buffer, descriptor_leapfrog[i], descriptor_tree[i], force_slice_size);
 
-            commandBufferSubmitAndFree(command_buffer);
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
         }
+        // Compute command buffer step 2
+        {
+            VkCommandBuffer command_buffer = command_buffer_compute_step_2[i];
 
-        attachments << framebuffer->color_attachment.view;
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
+
+            vkCmdResetQueryPool(command_buffer, query_pool_compute, 2, 2);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 2);
+
+            // Sliced kicks are submitted without a semaphore, so the drift waits for them here
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+
+            commandBufferParticleIdsCopyRecord(command_buffer, i, nbody_slot_write);
+            commandBufferComputeDriftRecord(command_buffer, descriptor_leapfrog[i]);
+
+            if (collision_merging && !integratorEnsemble())
+            {
+                commandBufferComputeCollisionRecord(command_buffer, descriptor_collision[nbody_slot_write]);
+            }
+
+            if ((ubo_nbody_compute.escape_radius > 0.0f) && !integratorEnsemble())
+            {
+                commandBufferComputeEscapeRecord(command_buffer, descriptor_compaction[nbody_slot_write]);
+            }
+
+            commandBufferPublishRecord(command_buffer, nbody_slot_write);
+
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 3);
+
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+        }
+        // Batch command buffer. The steps ping-pong between the scratch buffer and the destination slot such that
+        // the last one lands in the destination slot. The source slot is only read, so it can be drawn meanwhile
+        {
+            VkCommandBuffer command_buffer = command_buffer_compute_batch[i];
+
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
+
+            vkCmdResetQueryPool(command_buffer, query_pool_compute, 0, 6);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 0);
+
+            // The block integrator copies whole buffers, ids included
+            if (!integratorBlock())
+            {
+                commandBufferParticleIdsCopyRecord(command_buffer, i, nbody_slot_write);
+            }
+
+            for (uint32_t step = 0; step < steps_per_submit; step++)
+            {
+                bool read_source   = (step == 0);
+                bool write_scratch = ((steps_per_submit - 1 - step) % 2) == 1;
+
+                VkDescriptorSet descriptor_set_leapfrog;
+                VkDescriptorSet descriptor_set_tree;
+                VkDescriptorSet descriptor_set_block;
+                UniformData    *source;
+                UniformData    *destination;
+
+                if (read_source && !write_scratch)
+                {
+                    descriptor_set_leapfrog = descriptor_leapfrog[i];
+                    descriptor_set_tree     = descriptor_tree[i];
+                    descriptor_set_block    = descriptor_block[nbody_slot_write];
+                    source                  = &buffer_nbody[i];
+                    destination             = &buffer_nbody[nbody_slot_write];
+                }
+                else if (write_scratch)
+                {
+                    uint32_t nbody_slot_read = read_source ? i : nbody_slot_write;
+
+                    descriptor_set_leapfrog = descriptor_leapfrog_to_scratch[nbody_slot_read];
+                    descriptor_set_tree     = descriptor_tree_to_scratch[nbody_slot_read];
+                    descriptor_set_block    = descriptor_block_scratch;
+                    source                  = &buffer_nbody[nbody_slot_read];
+                    destination             = &buffer_nbody_scratch;
+                }
+                else
+                {
+                    descriptor_set_leapfrog = descriptor_leapfrog_from_scratch[nbody_slot_write];
+                    descriptor_set_tree     = descriptor_tree_from_scratch[nbody_slot_write];
+                    descriptor_set_block    = descriptor_block[nbody_slot_write];
+                    source                  = &buffer_nbody_scratch;
+                    destination             = &buffer_nbody[nbody_slot_write];
+                }
+
+                if (step > 0)
+                {
+                    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &step_barrier, 0, nullptr, 0, nullptr);
+                }
+
+                if (integratorBlock())
+                {
+                    commandBufferComputeBlockRecord(command_buffer, *source, *destination, descriptor_set_block);
+                }
+                else if (integratorHermite())
+                {
+                    commandBufferComputeHermiteRecord(command_buffer, descriptor_set_leapfrog);
+                }
+                else if (integratorYoshida())
+                {
+                    commandBufferComputeYoshidaRecord(command_buffer, descriptor_set_leapfrog);
+                }
+                else if (integratorFused())
+                {
+                    commandBufferComputeFusedRecord(command_buffer, descriptor_set_leapfrog);
+                }
+                else
+                {
+                    commandBufferComputeKickRecord(command_buffer, descriptor_set_leapfrog, descriptor_set_tree);
+                    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+                    commandBufferComputeDriftRecord(command_buffer, descriptor_set_leapfrog);
+                }
+            }
+
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 1);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 2);
+
+            // Collisions are merged and escapers removed once per batch
+            if (collision_merging && !integratorEnsemble())
+            {
+                commandBufferComputeCollisionRecord(command_buffer, descriptor_collision[nbody_slot_write]);
+            }
+
+            if ((ubo_nbody_compute.escape_radius > 0.0f) && !integratorEnsemble())
+            {
+                commandBufferComputeEscapeRecord(command_buffer, descriptor_compaction[nbody_slot_write]);
+            }
+
+            commandBufferPublishRecord(command_buffer, nbody_slot_write);
+
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 3);
+
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+        }
+        // Reorder command buffer. Sorts the particles by Morton key and gathers them in that order into the destination slot
+        {
+            VkCommandBuffer command_buffer = command_buffer_compute_reorder[i];
+
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
+
+            commandBufferComputeSortRecord(command_buffer, descriptor_tree[i]);
+
+            push_constants_tree_sort.count = ubo_nbody_compute.particle_count;
+
+            uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_tree[0])));
+
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_reorder);
+            vkCmdPushConstants(command_buffer, pipeline_layout_tree, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_tree_sort), &push_constants_tree_sort);
+            vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+
+            // The Hermite derivatives are stored per particle index, so evaluate them anew in the new order
+            if (integratorHermite())
+            {
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+                commandBufferHermiteInitializeRecord(command_buffer, descriptor_leapfrog[i]);
+            }
+
+            commandBufferPublishRecord(command_buffer, nbody_slot_write);
+
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+        }
+        // Diagnostics command buffer. Sums the conserved quantities of the slot into the host visible partial sums
+        {
+            VkCommandBuffer command_buffer = command_buffer_compute_diagnostics[i];
+
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
+
+            uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_energy[0])));
+
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_energy);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_energy[i], 0, 0);
+            vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+
+            // Later steps that overwrite the slot wait for the reads, and the host reads the sums once the fence is signaled
+            VkMemoryBarrier barrier = {};
+            barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.pNext         = nullptr;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+        }
+        // Out-of-core command buffer. Streams the step from slot i in host memory into slot i + 1
+        if (integratorOutOfCore())
+        {
+            VkCommandBuffer command_buffer = command_buffer_compute_stream[i];
+
+            HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmd_buffer_begin_info));
+
+            vkCmdResetQueryPool(command_buffer, query_pool_compute, 0, 6);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 0);
+
+            commandBufferComputeStreamRecord(command_buffer, i, nbody_slot_write);
+
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 1);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 2);
+
+            commandBufferPublishRecord(command_buffer, nbody_slot_write);
+
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 3);
+
+            HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
+        }
+    }
+}
+
+
+void VulkanWindow::commandBufferComputeKickRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog, VkDescriptorSet descriptor_set_tree, uint32_t work_group_count_slice, bool timestamps_mesh)
+{
+    // Velocity update from the particle positions
+    if (integratorEnsemble())
+    {
+        uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_ensemble[0])));
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_ensemble[0]);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
+        vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+    }
+    else if (force_solver == FORCE_SOLVER_BARNES_HUT)
+    {
+        commandBufferComputeTreeRecord(command_buffer, descriptor_set_tree);
     }
+    else if (force_solver == FORCE_SOLVER_PARTICLE_MESH)
+    {
+        commandBufferComputeMeshRecord(command_buffer, descriptor_set_tree);
+    }
+    else if (force_solver == FORCE_SOLVER_TREE_MESH)
+    {
+        // Long-range part on the mesh, then the short-range part of the tree walk on top of its velocities. The mesh is timed
+        // separately in step one, whose queries are reset for it
+        if (timestamps_mesh)
+        {
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 4);
+        }
 
-    // Depth stencil attachment
+        commandBufferComputeMeshRecord(command_buffer, descriptor_set_tree);
+
+        if (timestamps_mesh)
+        {
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 5);
+        }
+
+        // The tree walk reads the velocities of the mesh kick, and the bounds are reset by a transfer once the mesh kick has read them
+        VkMemoryBarrier barrier = {};
+        barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext         = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        commandBufferComputeTreeRecord(command_buffer, descriptor_set_tree);
+    }
+    else if (force_kernel == FORCE_KERNEL_SYMMETRIC)
     {
-        framebuffer->depth_attachment.enabled = true;
+        commandBufferComputeSymmetricRecord(command_buffer, descriptor_set_leapfrog);
+    }
+    else
+    {
+        VkPipeline pipelines_step_1[3] =
+        {
+            pipeline_compute_leapfrog_step_1,
+            pipeline_compute_leapfrog_step_1_half,
+            pipeline_compute_leapfrog_step_1_broadcast
+        };
 
-        VkImageCreateInfo image_info = {};
-        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        image_info.pNext         = nullptr;
-        image_info.imageType     = VK_IMAGE_TYPE_2D;
-        image_info.extent.width  = framebuffer->width;
-        image_info.extent.height = framebuffer->height;
-        image_info.extent.depth  = 1;
-        image_info.mipLevels     = 1;
-        image_info.arrayLayers   = 1;
-        image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
-        image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
-        image_info.format        = depth_format;
-        image_info.usage         = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-        HANDLE_VK_RESULT(vkCreateImage(vkbase.device(), &image_info, nullptr, &framebuffer->depth_attachment.image));
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines_step_1[force_kernel]);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
 
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements(vkbase.device(), framebuffer->depth_attachment.image, &memReqs);
+        // Dispatch part of the compute job. Each invocation handles several bodies
+        uint32_t work_group_count_x  = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0] * specialization_nbody.bodies_per_thread)));
+        uint32_t work_group_count[3] = { work_group_count_x, 1, 1 };
 
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.pNext           = NULL;
-        memAlloc.allocationSize  = 0;
-        memAlloc.memoryTypeIndex = 0;
-        memAlloc.allocationSize  = memReqs.size;
-        memAlloc.memoryTypeIndex = vulkan_helper->memoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        HANDLE_VK_RESULT(vkAllocateMemory(vkbase.device(), &memAlloc, nullptr, &framebuffer->depth_attachment.mem));
-        HANDLE_VK_RESULT(vkBindImageMemory(vkbase.device(), framebuffer->depth_attachment.image, framebuffer->depth_attachment.mem, 0));
+        // A slice covers part of the work groups, starting at the offset in the uniforms. Work groups past the end have nothing to do
+        if (work_group_count_slice > 0)
+        {
+            work_group_count[0] = std::min(work_group_count_slice, work_group_count_x);
+        }
+
+        vkCmdDispatch(command_buffer, work_group_count[0], work_group_count[1], work_group_count[2]);
+    }
+}
+
+
+void VulkanWindow::commandBufferComputeSymmetricRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog)
+{
+    // The diagonal pass initializes the output velocities, then each round adds the pairs of tiles it owns.
+    // Consecutive rounds update the same velocities, so they are separated by barriers
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    uint32_t tile_count      = (ubo_nbody_compute.particle_count + tile_size_symmetric - 1) / tile_size_symmetric;
+    uint32_t tile_count_even = tile_count + (tile_count & 1);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_symmetric);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_symmetric, 0, 1, &descriptor_set_leapfrog, 0, 0);
+
+    push_constants_symmetric.round = SYMMETRIC_ROUND_DIAGONAL;
+    vkCmdPushConstants(command_buffer, pipeline_layout_symmetric, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_symmetric), &push_constants_symmetric);
+    vkCmdDispatch(command_buffer, tile_count, 1, 1);
 
-        {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.pNext = nullptr;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.subresourceRange    = { VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 };
-            barrier.image         = framebuffer->depth_attachment.image;
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
-            barrier.newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    for (uint32_t round = 0; (tile_count > 1) && (round < tile_count_even - 1); round++)
+    {
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
 
-            VkCommandBuffer command_buffer = commandBufferCreate();
+        push_constants_symmetric.round = round;
+        vkCmdPushConstants(command_buffer, pipeline_layout_symmetric, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_symmetric), &push_constants_symmetric);
+        vkCmdDispatch(command_buffer, tile_count_even / 2, 1, 1);
+    }
+}
 
-            vkCmdPipelineBarrier(
-                command_buffer,
-                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
 
-            commandBufferSubmitAndFree(command_buffer);
-        }
+void VulkanWindow::commandBufferComputeDriftRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog)
+{
+    // Position update from the velocities written by the kick. The systems of an ensemble have their own time steps
+    if (integratorEnsemble())
+    {
+        uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_ensemble[0])));
 
-        VkImageViewCreateInfo view_info = {};
-        view_info.sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        view_info.pNext            = nullptr;
-        view_info.viewType         = VK_IMAGE_VIEW_TYPE_2D;
-        view_info.format           = depth_format;
-        view_info.flags            = 0;
-        view_info.subresourceRange = {};
-        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-        view_info.subresourceRange.baseMipLevel   = 0;
-        view_info.subresourceRange.levelCount     = 1;
-        view_info.subresourceRange.baseArrayLayer = 0;
-        view_info.subresourceRange.layerCount     = 1;
-        view_info.image = framebuffer->depth_attachment.image;
-        HANDLE_VK_RESULT(vkCreateImageView(vkbase.device(), &view_info, nullptr, &framebuffer->depth_attachment.view));
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_ensemble[1]);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
+        vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
 
-        attachments << framebuffer->depth_attachment.view;
+        return;
     }
 
-    VkFramebufferCreateInfo fbufCreateInfo = {};
-    fbufCreateInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    fbufCreateInfo.pNext           = nullptr;
-    fbufCreateInfo.renderPass      = render_pass_hdr_color_depth;
-    fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    fbufCreateInfo.pAttachments    = attachments.data();
-    fbufCreateInfo.width           = framebuffer->width;
-    fbufCreateInfo.height          = framebuffer->height;
-    fbufCreateInfo.layers          = 1;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_step_2);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
 
-    HANDLE_VK_RESULT(vkCreateFramebuffer(vkbase.device(), &fbufCreateInfo, nullptr, &framebuffer->framebuffer));
+    // Find required number of work groups
+    uint32_t work_group_count_x  = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0])));
+    uint32_t work_group_count[3] = { work_group_count_x, 1, 1 };
+
+    vkCmdDispatch(command_buffer, work_group_count[0], work_group_count[1], work_group_count[2]);
 }
 
 
-void VulkanWindow::commandPoolCreate()
+void VulkanWindow::commandBufferComputeFusedRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog)
 {
-    // Create command pool
-    VkCommandPoolCreateInfo pool_create_info = {};
+    // Kick and drift in a single dispatch
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_fused);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
 
-    pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    pool_create_info.queueFamilyIndex = vkbase.queueFamilyIndex();
-    pool_create_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    HANDLE_VK_RESULT(vkCreateCommandPool(vkbase.device(), &pool_create_info, nullptr, &command_pool));
+    uint32_t work_group_count_x  = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0] * specialization_nbody.bodies_per_thread)));
+    uint32_t work_group_count[3] = { work_group_count_x, 1, 1 };
+
+    vkCmdDispatch(command_buffer, work_group_count[0], work_group_count[1], work_group_count[2]);
 }
 
 
-void VulkanWindow::commandPoolDestroy()
+void VulkanWindow::commandBufferComputeHermiteRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog)
 {
-    HANDLE_VK_RESULT(vkDeviceWaitIdle(vkbase.device()));
+    // Fourth-order Hermite: predict positions and velocities, evaluate acceleration and jerk there, then correct
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkPipeline pipelines[3] =
+    {
+        pipeline_compute_hermite_predict,
+        pipeline_compute_hermite_evaluate,
+        pipeline_compute_hermite_correct
+    };
 
-    vkDestroyCommandPool(vkbase.device(), command_pool, nullptr);
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0])));
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        if (i > 0)
+        {
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+        vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+    }
 }
 
 
-void VulkanWindow::commandBuffersAllocate()
+void VulkanWindow::commandBufferComputeYoshidaRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog)
 {
-    command_buffer_draw.resize(swapchain_image_count);
-    command_buffer_pre_present.resize(swapchain_image_count);
-    command_buffer_post_present.resize(swapchain_image_count);
+    // Fourth-order Yoshida: four drifts interleaved with three kicks. The first drift copies the input into the output buffer,
+    // all later passes work in place on the output buffer
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
-    command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    command_buffer_allocate_info.commandPool        = command_pool;
-    command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    command_buffer_allocate_info.commandBufferCount = swapchain_image_count;
+    uint32_t work_group_count_drift = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0])));
+    uint32_t work_group_count_kick  = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0] * specialization_nbody.bodies_per_thread)));
 
-    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_draw.data()));
-    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_pre_present.data()));
-    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, command_buffer_post_present.data()));
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_set_leapfrog, 0, 0);
 
-    command_buffer_allocate_info.commandBufferCount = 1;
-    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, &command_buffer_compute_step_1));
-    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, &command_buffer_compute_step_2));
+    for (uint32_t stage = 0; stage < 4; stage++)
+    {
+        if (stage > 0)
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_yoshida_kick[stage - 1]);
+            vkCmdDispatch(command_buffer, work_group_count_kick, 1, 1);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_yoshida_drift[stage]);
+        vkCmdDispatch(command_buffer, work_group_count_drift, 1, 1);
+
+        if (stage < 3)
+        {
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
+    }
 }
 
 
-void VulkanWindow::commandBuffersPresentRecord()
+void VulkanWindow::commandBufferComputeBlockRecord(VkCommandBuffer command_buffer, const UniformData& source, const UniformData& destination, VkDescriptorSet descriptor_set_block)
 {
-    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    // Block timesteps: each substep selects the particles whose time bin is synchronized, kicks only those through an
+    // indirect dispatch sized by the selection, and drifts all particles by the smallest step
+    static const uint32_t arguments_reset[4] = { 0, 1, 1, 0 }; // Work group counts x, y, z and active count
 
-    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufferBeginInfo.pNext = nullptr;
+    uint32_t substep_count             = 1u << ubo_nbody_compute.block_level_max;
+    uint32_t work_group_count_particles = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_block[0])));
 
-    for (uint32_t i = 0; i < swapchain_image_count; i++)
+    VkMemoryBarrier compute_to_transfer_barrier = {};
+    compute_to_transfer_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_to_transfer_barrier.pNext         = nullptr;
+    compute_to_transfer_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_to_transfer_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkMemoryBarrier transfer_to_compute_barrier = {};
+    transfer_to_compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    transfer_to_compute_barrier.pNext         = nullptr;
+    transfer_to_compute_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    transfer_to_compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkMemoryBarrier indirect_barrier = {};
+    indirect_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    indirect_barrier.pNext         = nullptr;
+    indirect_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    indirect_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    // Copy the state into the destination, which the substeps then integrate in place
     {
-        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_post_present[i], &cmdBufferBeginInfo));
+        VkBufferCopy copy_region = {};
+        copy_region.size = source.descriptor.range;
 
-        VkImageMemoryBarrier postPresentBarrier = {};
-        postPresentBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        postPresentBarrier.pNext               = nullptr;
-        postPresentBarrier.srcAccessMask       = 0;
-        postPresentBarrier.dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        postPresentBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-        postPresentBarrier.newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        postPresentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        postPresentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        postPresentBarrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-        postPresentBarrier.image               = swapchain_images[i];
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_transfer_barrier, 0, nullptr, 0, nullptr);
+        vkCmdCopyBuffer(command_buffer, source.buffer, destination.buffer, 1, &copy_region);
+    }
 
-        vkCmdPipelineBarrier(
-            command_buffer_post_present[i],
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &postPresentBarrier);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_block, 0, 1, &descriptor_set_block, 0, 0);
 
-        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_post_present[i]));
+    for (uint32_t substep = 0; substep < substep_count; substep++)
+    {
+        push_constants_block.substep = substep;
 
-        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_pre_present[i], &cmdBufferBeginInfo));
+        // Reset the dispatch arguments and active count
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &compute_to_transfer_barrier, 0, nullptr, 0, nullptr);
+        vkCmdUpdateBuffer(command_buffer, buffer_block_arguments.buffer, 0, sizeof(arguments_reset), arguments_reset);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_barrier, 0, nullptr, 0, nullptr);
 
-        VkImageMemoryBarrier prePresentBarrier = {};
-        prePresentBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        prePresentBarrier.pNext               = nullptr;
-        prePresentBarrier.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        prePresentBarrier.dstAccessMask       = VK_ACCESS_MEMORY_READ_BIT;
-        prePresentBarrier.oldLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        prePresentBarrier.newLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        prePresentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        prePresentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        prePresentBarrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-        prePresentBarrier.image               = swapchain_images[i];
+        // Active particle selection
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_block_select);
+            vkCmdPushConstants(command_buffer, pipeline_layout_block, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_block), &push_constants_block);
+            vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &indirect_barrier, 0, nullptr, 0, nullptr);
+        }
 
-        vkCmdPipelineBarrier(
-            command_buffer_pre_present[i],
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &prePresentBarrier);
+        // Kick of the active particles
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_block_kick);
+            vkCmdPushConstants(command_buffer, pipeline_layout_block, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_block), &push_constants_block);
+            vkCmdDispatchIndirect(command_buffer, buffer_block_arguments.buffer, 0);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
 
-        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_pre_present[i]));
+        // Drift of all particles
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_block_drift);
+            vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
     }
 }
 
 
-VkCommandBuffer VulkanWindow::commandBufferCreate()
+void VulkanWindow::commandBufferComputeCollisionRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_collision)
 {
-    VkCommandBuffer command_buffer;
+    // Collision merging in place in the destination of the step: hash grid insertion, overlap detection, claims, merges and
+    // removal of the merged bodies. Every pass reads the results of the previous one
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_collision[0])));
 
-    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-    command_buffer_allocate_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    command_buffer_allocate_info.commandPool        = command_pool;
-    command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    command_buffer_allocate_info.commandBufferCount = 1;
+    VkMemoryBarrier transfer_to_compute_barrier = {};
+    transfer_to_compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    transfer_to_compute_barrier.pNext         = nullptr;
+    transfer_to_compute_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    transfer_to_compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-    HANDLE_VK_RESULT(vkAllocateCommandBuffers(vkbase.device(), &command_buffer_allocate_info, &command_buffer));
+    VkMemoryBarrier host_barrier = {};
+    host_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    host_barrier.pNext         = nullptr;
+    host_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
 
-    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
-    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufferBeginInfo.pNext = nullptr;
-    HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer, &cmdBufferBeginInfo));
+    // Empty buckets and claims. The step must have written the particles
+    vkCmdFillBuffer(command_buffer, buffer_collision_heads.buffer, 0, buffer_collision_heads.descriptor.range, 0xFFFFFFFF);
+    vkCmdFillBuffer(command_buffer, buffer_collision_claims.buffer, 0, buffer_collision_claims.descriptor.range, 0xFFFFFFFF);
 
-    return command_buffer;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transfer_to_compute_barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_collision, 0, 1, &descriptor_set_collision, 0, 0);
+
+    for (uint32_t pass = 0; pass < 5; pass++)
+    {
+        if (pass > 0)
+        {
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_collision[pass]);
+        vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+    }
+
+    // The host reads the merged count to decide when to compact
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
 }
 
 
-void VulkanWindow::commandBufferSubmitAndFree(VkCommandBuffer command_buffer)
+void VulkanWindow::commandBufferComputeEscapeRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_compaction)
 {
-    if (command_buffer == VK_NULL_HANDLE)
+    // Takes the mass of the escapers in place in the destination of the step. They are removed when the buffers are compacted
+    uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_compaction[0])));
+
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkMemoryBarrier host_barrier = {};
+    host_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    host_barrier.pNext         = nullptr;
+    host_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    // The step or the collision merging must have written the particles
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_compaction[0]);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_compaction, 0, 1, &descriptor_set_compaction, 0, 0);
+    vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+
+    // The host reads the removed count to decide when to compact
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
+}
+
+
+void VulkanWindow::commandBufferComputeStreamRecord(VkCommandBuffer command_buffer, uint32_t nbody_slot_read, uint32_t nbody_slot_write)
+{
+    // Out-of-core leapfrog step between two slots in host memory, or in device memory when segmented. Each block of bodies is copied into device memory, and all bodies are
+    // streamed past it in tiles of the block size. The next tile is copied while the current one is evaluated: the barrier before a
+    // tile only waits for the work recorded before it, so the copy and the dispatch recorded after it run side by side. Once every
+    // tile has been accumulated, the block is kicked, drifted and copied back. The transfers grow as the square of the particle count
+    // over the block size, so the block should be as large as device memory allows
+    uint32_t particle_count = ubo_nbody_compute.particle_count;
+    uint32_t block_size     = std::min(stream_block_size, particle_count);
+    VkBuffer source         = buffer_nbody[nbody_slot_read].buffer;
+    VkBuffer destination    = buffer_nbody[nbody_slot_write].buffer;
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext         = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    commandBufferParticleIdsCopyRecord(command_buffer, nbody_slot_read, nbody_slot_write);
+
+    for (uint32_t block = 0; block < particle_count; block += block_size)
     {
-        qWarning("A command buffer that was a null handle was sent to be freed");
-        return;
+        uint32_t block_count        = std::min(block_size, particle_count - block);
+        uint32_t work_group_count_x = static_cast<uint32_t>(std::ceil(static_cast<double>(block_count) / static_cast<double>(work_item_count_stream[0])));
+
+        // Positions and velocities of the block, and the first tile. The previous block must be done with the working set
+        vkCmdPipelineBarrier(command_buffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy copy_regions[2] = {};
+        copy_regions[0].srcOffset = static_cast<VkDeviceSize>(block) * 4 * sizeof(float);
+        copy_regions[0].dstOffset = 0;
+        copy_regions[0].size      = static_cast<VkDeviceSize>(block_count) * 4 * sizeof(float);
+        copy_regions[1].srcOffset = (static_cast<VkDeviceSize>(particle_count) + block) * 4 * sizeof(float);
+        copy_regions[1].dstOffset = static_cast<VkDeviceSize>(block_count) * 4 * sizeof(float);
+        copy_regions[1].size      = static_cast<VkDeviceSize>(block_count) * 4 * sizeof(float);
+
+        vkCmdCopyBuffer(command_buffer, source, buffer_stream_block.buffer, 2, copy_regions);
+
+        VkBufferCopy copy_region = {};
+        copy_region.srcOffset = 0;
+        copy_region.dstOffset = 0;
+        copy_region.size      = static_cast<VkDeviceSize>(block_size) * 4 * sizeof(float);
+
+        vkCmdCopyBuffer(command_buffer, source, buffer_stream_tiles[0].buffer, 1, &copy_region);
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_stream[0]);
+
+        for (uint32_t tile = 0, tile_index = 0; tile < particle_count; tile += block_size, tile_index++)
+        {
+            uint32_t tile_next = tile + block_size;
+
+            // The copy of this tile is done, and so is the dispatch that read the buffer the next tile is copied into
+            vkCmdPipelineBarrier(command_buffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+            if (tile_next < particle_count)
+            {
+                copy_region.srcOffset = static_cast<VkDeviceSize>(tile_next) * 4 * sizeof(float);
+                copy_region.size      = static_cast<VkDeviceSize>(std::min(block_size, particle_count - tile_next)) * 4 * sizeof(float);
+
+                vkCmdCopyBuffer(command_buffer, source, buffer_stream_tiles[(tile_index + 1) % 2].buffer, 1, &copy_region);
+            }
+
+            push_constants_stream.block_count = block_count;
+            push_constants_stream.tile_count  = std::min(block_size, particle_count - tile);
+            push_constants_stream.first_tile  = (tile == 0) ? 1 : 0;
+
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_stream, 0, 1, &descriptor_stream[tile_index % 2], 0, 0);
+            vkCmdPushConstants(command_buffer, pipeline_layout_stream, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_stream), &push_constants_stream);
+            vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+        }
+
+        // Kick and drift the block in place, then copy it into the destination slot
+        vkCmdPipelineBarrier(command_buffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        push_constants_stream.tile_count = 0;
+        push_constants_stream.first_tile = 0;
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_stream[1]);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_stream, 0, 1, &descriptor_stream[0], 0, 0);
+        vkCmdPushConstants(command_buffer, pipeline_layout_stream, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_stream), &push_constants_stream);
+        vkCmdDispatch(command_buffer, work_group_count_x, 1, 1);
+
+        vkCmdPipelineBarrier(command_buffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        std::swap(copy_regions[0].srcOffset, copy_regions[0].dstOffset);
+        std::swap(copy_regions[1].srcOffset, copy_regions[1].dstOffset);
+
+        vkCmdCopyBuffer(command_buffer, buffer_stream_block.buffer, destination, 2, copy_regions);
     }
+}
 
-    HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer));
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &command_buffer;
+void VulkanWindow::commandBufferParticleIdsCopyRecord(VkCommandBuffer command_buffer, uint32_t nbody_slot_read, uint32_t nbody_slot_write)
+{
+    // Steps keep the order of the particles, so the ids are carried over unchanged. They follow the positions and velocities
+    VkBufferCopy copy_region = {};
+    copy_region.srcOffset = static_cast<VkDeviceSize>(ubo_nbody_compute.particle_count) * sizeof(Particle);
+    copy_region.dstOffset = static_cast<VkDeviceSize>(ubo_nbody_compute.particle_count) * sizeof(Particle);
+    copy_region.size      = static_cast<VkDeviceSize>(ubo_nbody_compute.particle_count) * sizeof(uint32_t);
 
-    HANDLE_VK_RESULT(vkQueueSubmit(vkbase.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
-    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
+    vkCmdCopyBuffer(command_buffer, buffer_nbody[nbody_slot_read].buffer, buffer_nbody[nbody_slot_write].buffer, 1, &copy_region);
+}
 
-    vkFreeCommandBuffers(vkbase.device(), command_pool, 1, &command_buffer);
+
+void VulkanWindow::commandBufferPublishRecord(VkCommandBuffer command_buffer, uint32_t nbody_slot)
+{
+    // Pipeline barrier making the written particle buffer readable as vertex input and by the next compute step, which may start with a copy.
+    // The particle ids are written by a copy
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext               = nullptr;
+    barrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.buffer              = buffer_nbody[nbody_slot].buffer;
+    barrier.size                = VK_WHOLE_SIZE; // The descriptor range is clamped out-of-core
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        1, &barrier,
+        0, nullptr);
 }
 
 
-void VulkanWindow::commandBuffersGraphicsRecord()
+void VulkanWindow::commandBufferComputeTreeRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_tree)
 {
-    VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
+    // Barnes-Hut velocity update: bounding box, Morton keys, bitonic sort, radix tree build, bottom-up moments and finally the tree walk.
+    // Every pass reads the results of the previous one, so they are separated by compute to compute barriers
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-    cmd_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmd_buffer_begin_info.pNext            = nullptr;
-    cmd_buffer_begin_info.pInheritanceInfo = nullptr;
+    uint32_t work_group_count_particles = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_tree[0])));
 
-    for (uint32_t i = 0; i < swapchain_image_count; ++i)
+    commandBufferComputeSortRecord(command_buffer, descriptor_set_tree);
+
+    // Radix tree
     {
-        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_draw[i], &cmd_buffer_begin_info));
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_tree_build);
+        vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
 
-        vkCmdResetQueryPool(command_buffer_draw[i], query_pool_graphics, 0, 14);
-        vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, query_pool_graphics, 12);
+    // Mass moments
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_tree_moments);
+        vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
 
-        // Scene
-        {
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 0);
+    // Tree walk, updates velocities. Only the short-range part of the force on top of the mesh kick for the tree and particle mesh
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, (force_solver == FORCE_SOLVER_TREE_MESH) ? pipeline_compute_tree_walk_short : pipeline_compute_tree_walk);
+        vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+    }
+}
 
-            VkViewport viewport = {};
-            viewport.width    = static_cast<float> (framebuffer_scene.width);
-            viewport.height   = static_cast<float> (framebuffer_scene.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = framebuffer_scene.width;
-            scissor.extent.height = framebuffer_scene.height;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
+void VulkanWindow::commandBufferComputeSortRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_tree)
+{
+    // Sorts the particle indices of the source particles by Morton key: bounding box, keys and bitonic sort. Shared by the
+    // Barnes-Hut tree and the reordering. Binds the tree descriptor set, and ends with a barrier so that the sorted values can be read
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    uint32_t work_group_count_keys = static_cast<uint32_t>(std::ceil(static_cast<double>(tree_sort_count) / static_cast<double>(work_item_count_tree[0])));
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_tree, 0, 1, &descriptor_set_tree, 0, 0);
+
+    commandBufferComputeBoundsRecord(command_buffer);
+
+    // Morton keys
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_tree_morton);
+        vkCmdDispatch(command_buffer, work_group_count_keys, 1, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
 
-            VkClearValue clear_values[3];
-            clear_values[0].color        = { 0.0f, 0.0f, 0.0f, 0.0f };
-            clear_values[1].color        = { 0.0f, 0.0f, 0.0f, 0.0f };
-            clear_values[2].depthStencil = { 1.0f, 0 };
+    // Bitonic sort, one dispatch per stage
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_tree_sort);
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderArea.offset.x      = 0;
-            render_pass_begin_info.renderArea.offset.y      = 0;
-            render_pass_begin_info.renderPass               = render_pass_hdr_color_depth;
-            render_pass_begin_info.renderArea.extent.width  = framebuffer_scene.width;
-            render_pass_begin_info.renderArea.extent.height = framebuffer_scene.height;
-            render_pass_begin_info.clearValueCount          = 3;
-            render_pass_begin_info.pClearValues             = clear_values;
+        push_constants_tree_sort.count = tree_sort_count;
 
-            // Change layout of framebuffer attachments
+        for (uint32_t k = 2; k <= tree_sort_count; k <<= 1)
+        {
+            for (uint32_t j = k >> 1; j > 0; j >>= 1)
             {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = nullptr;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                barrier.image         = framebuffer_scene.color_attachment.image;
-                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                push_constants_tree_sort.k = k;
+                push_constants_tree_sort.j = j;
 
-                vkCmdPipelineBarrier(
-                    command_buffer_draw[i],
-                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &barrier);
+                vkCmdPushConstants(command_buffer, pipeline_layout_tree, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_tree_sort), &push_constants_tree_sort);
+                vkCmdDispatch(command_buffer, work_group_count_keys, 1, 1);
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
             }
+        }
+    }
+}
 
-            render_pass_begin_info.framebuffer = framebuffer_scene.framebuffer;
 
-            // Clear the color and depth attachment
-            vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+void VulkanWindow::commandBufferComputeBoundsRecord(VkCommandBuffer command_buffer)
+{
+    // Bounding box of the source particles, reduced into the bounds buffer. Expects the tree descriptor set to be bound, and ends
+    // with a barrier so that the bounds can be read
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    uint32_t work_group_count_particles = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_tree[0])));
+
+    // Reset bounds to an empty box
+    {
+        vkCmdFillBuffer(command_buffer, buffer_tree_bounds.buffer, 0, 4 * sizeof(uint32_t), 0xFFFFFFFF);
+        vkCmdFillBuffer(command_buffer, buffer_tree_bounds.buffer, 4 * sizeof(uint32_t), 4 * sizeof(uint32_t), 0);
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext               = nullptr;
+        barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.buffer              = buffer_tree_bounds.buffer;
+        barrier.size                = buffer_tree_bounds.descriptor.range;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-            vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
-            vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+        vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+    }
 
-            // Draw particles
-            vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_nbody);
-            vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_nbody, 0, 1, &descriptor_nbody, 0, nullptr);
+    // Bounding box
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_tree_bounds);
+        vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
+}
 
-            VkDeviceSize offsets[1] = { 0 };
-            vkCmdBindVertexBuffers(command_buffer_draw[i],
-                                   INSTANCE_BUFFER_BIND_ID,
-                                   1,
-                                   &buffer_nbody_draw.buffer,
-                                   offsets);
-            vkCmdBindVertexBuffers(command_buffer_draw[i],
-                                   VERTEX_BUFFER_BIND_ID,
-                                   1,
-                                   &vertices_corner.buffer,
-                                   offsets);
-            vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
 
+void VulkanWindow::commandBufferComputeMeshRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_tree)
+{
+    // Particle-mesh velocity update: bounding box, mass assignment, load of the padded meshes, forward FFT of the mass and the
+    // force law along each axis, their product, inverse FFT of the potential and finally the interpolated gradient. Every pass
+    // reads the results of the previous one, so they are separated by compute to compute barriers. For the tree and particle mesh
+    // the product keeps only the long-range part of the force
+    VkMemoryBarrier compute_barrier = {};
+    compute_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    compute_barrier.pNext         = nullptr;
+    compute_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-            vkCmdDrawIndexed(command_buffer_draw[i], 6, ubo_nbody_compute.particle_count, 0, 0, 0);
+    uint32_t mesh_size_padded           = 2 * ubo_nbody_compute.mesh_size;
+    uint32_t work_group_count_particles = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_tree[0])));
+    uint32_t work_group_count_cells     = mesh_size_padded * mesh_size_padded / work_item_count_tree[0]; // Per plane of the padded mesh
 
-            // End render pass
-            vkCmdEndRenderPass(command_buffer_draw[i]);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_tree, 0, 1, &descriptor_set_tree, 0, 0);
 
-            // Change layout of framebuffer attachments
-            {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = nullptr;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                barrier.image         = framebuffer_scene.color_attachment.image;
-                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-                barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    // Clear the assigned mass
+    {
+        vkCmdFillBuffer(command_buffer, buffer_mesh_density.buffer, 0, VK_WHOLE_SIZE, 0);
 
-                vkCmdPipelineBarrier(
-                    command_buffer_draw[i],
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &barrier);
-            }
+        VkMemoryBarrier barrier = {};
+        barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext         = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 1);
-        }
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
 
+    commandBufferComputeBoundsRecord(command_buffer);
 
-        // Luminosity
+    // Mass assignment
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_mesh[0]);
+        vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Padded meshes of the mass and the force law
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_mesh[1]);
+        vkCmdDispatch(command_buffer, work_group_count_cells, mesh_size_padded, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Forward FFT of both meshes, one dispatch per axis with a work group per line
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_mesh_fft);
+
+        push_constants_mesh.inverse = 0;
+
+        for (uint32_t axis = 0; axis < 3; axis++)
         {
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 2);
+            push_constants_mesh.axis = axis;
 
-            VkViewport viewport = {};
-            viewport.width    = static_cast<float> (framebuffer_luminosity.width);
-            viewport.height   = static_cast<float> (framebuffer_luminosity.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
+            vkCmdPushConstants(command_buffer, pipeline_layout_tree, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_mesh), &push_constants_mesh);
+            vkCmdDispatch(command_buffer, mesh_size_padded, mesh_size_padded, 2);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
+    }
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = framebuffer_luminosity.width;
-            scissor.extent.height = framebuffer_luminosity.height;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
+    // Product of the spectra
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_mesh[(force_solver == FORCE_SOLVER_TREE_MESH) ? 4 : 2]);
+        vkCmdDispatch(command_buffer, work_group_count_cells, mesh_size_padded, 1);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+    }
 
-            VkClearValue clear_values[1];
-            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+    // Inverse FFT of the first mesh, which leaves the potential in its real part
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_mesh_fft);
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderArea.offset.x      = 0;
-            render_pass_begin_info.renderArea.offset.y      = 0;
-            render_pass_begin_info.renderPass               = render_pass_hdr;
-            render_pass_begin_info.renderArea.extent.width  = framebuffer_luminosity.width;
-            render_pass_begin_info.renderArea.extent.height = framebuffer_luminosity.height;
-            render_pass_begin_info.clearValueCount          = 1;
-            render_pass_begin_info.pClearValues             = clear_values;
+        push_constants_mesh.inverse = 1;
 
-            // Change layout of output framebuffer
-            {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = nullptr;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                barrier.image         = framebuffer_luminosity.color_attachment.image;
-                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            push_constants_mesh.axis = axis;
 
-                vkCmdPipelineBarrier(
-                    command_buffer_draw[i],
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &barrier);
-            }
+            vkCmdPushConstants(command_buffer, pipeline_layout_tree, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_mesh), &push_constants_mesh);
+            vkCmdDispatch(command_buffer, mesh_size_padded, mesh_size_padded, 1);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &compute_barrier, 0, nullptr, 0, nullptr);
+        }
+    }
 
-            // Execute shader
-            {
-                render_pass_begin_info.framebuffer = framebuffer_luminosity.framebuffer;
+    // Interpolated gradient, updates velocities
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_mesh[3]);
+        vkCmdDispatch(command_buffer, work_group_count_particles, 1, 1);
+    }
+}
 
-                // Clear the color and depth attachment
-                vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-                vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
-                vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
 
-                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_luminosity);
-                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_normal_texture, 0, 1, &descriptor_luminosity, 0, nullptr);
+void VulkanWindow::commandBuffersFree()
+{
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
+    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.computeQueue()));
 
-                VkDeviceSize offsets[1] = { 0 };
-                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, static_cast<uint32_t> (command_buffer_draw.size()), command_buffer_draw.data());
+    vkFreeCommandBuffers(vkbase.device(), command_pool, static_cast<uint32_t> (command_buffer_pre_present.size()), command_buffer_pre_present.data());
+    vkFreeCommandBuffers(vkbase.device(), command_pool, static_cast<uint32_t> (command_buffer_post_present.size()), command_buffer_post_present.data());
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_step_1);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_step_2);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_batch);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_reorder);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_slice);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_diagnostics);
+    vkFreeCommandBuffers(vkbase.device(), command_pool, NBODY_BUFFER_COUNT, command_buffer_compute_stream);
+}
 
-                // Bind index buffer
-                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-                // Draw vertices
-                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+void VulkanWindow::uniformBuffersPrepare()
+{
+    // Particles / compute
+    {
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(ubo_nbody_graphics),
+            nullptr,
+            &uniform_nbody_graphics.buffer,
+            &uniform_nbody_graphics.memory,
+            &uniform_nbody_graphics.descriptor);
 
-                // End render pass
-                vkCmdEndRenderPass(command_buffer_draw[i]);
-            }
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_nbody_graphics.memory, 0, sizeof(ubo_nbody_graphics), 0, (void **)&uniform_nbody_graphics.mapped));
 
-            // Change layout of output framebuffer
-            {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = nullptr;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                barrier.image         = framebuffer_luminosity.color_attachment.image;
-                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-                barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(ubo_nbody_compute),
+            nullptr,
+            &uniform_nbody_compute.buffer,
+            &uniform_nbody_compute.memory,
+            &uniform_nbody_compute.descriptor);
 
-                vkCmdPipelineBarrier(
-                    command_buffer_draw[i],
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &barrier);
-            }
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_nbody_compute.memory, 0, sizeof(ubo_nbody_compute), 0, (void **)&uniform_nbody_compute.mapped));
+    }
+    // Performance
+    {
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(ubo_performance_meter_compute),
+            &ubo_performance_meter_compute,
+            &uniform_performance_compute.buffer,
+            &uniform_performance_compute.memory,
+            &uniform_performance_compute.descriptor);
 
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 3);
-        }
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_performance_compute.memory, 0, sizeof(ubo_performance_meter_compute), 0, (void **)&uniform_performance_compute.mapped));
 
-        // Bloom (two blur passes)
-        {
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 4);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(ubo_performance_meter_graphics),
+            &ubo_performance_meter_graphics,
+            &uniform_performance_graphics.buffer,
+            &uniform_performance_graphics.memory,
+            &uniform_performance_graphics.descriptor);
 
-            VkViewport viewport = {};
-            viewport.width    = static_cast<float> (framebuffer_blur_alpha.width);
-            viewport.height   = static_cast<float> (framebuffer_blur_alpha.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_performance_graphics.memory, 0, sizeof(ubo_performance_meter_graphics), 0, (void **)&uniform_performance_graphics.mapped));
+    }
+    // Bloom
+    {
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(ubo_blur),
+            nullptr,
+            &uniform_blur.buffer,
+            &uniform_blur.memory,
+            &uniform_blur.descriptor);
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = framebuffer_blur_alpha.width;
-            scissor.extent.height = framebuffer_blur_alpha.height;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
 
-            VkClearValue clear_values[1];
-            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_blur.memory, 0, sizeof(ubo_blur), 0, (void **)&uniform_blur.mapped));
+    }
+    // Tone mapping
+    {
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(ubo_tone_mapping),
+            nullptr,
+            &uniform_tone_mapping.buffer,
+            &uniform_tone_mapping.memory,
+            &uniform_tone_mapping.descriptor);
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderArea.offset.x      = 0;
-            render_pass_begin_info.renderArea.offset.y      = 0;
-            render_pass_begin_info.renderPass               = render_pass_hdr;
-            render_pass_begin_info.renderArea.extent.width  = framebuffer_blur_alpha.width;
-            render_pass_begin_info.renderArea.extent.height = framebuffer_blur_alpha.height;
-            render_pass_begin_info.clearValueCount          = 1;
-            render_pass_begin_info.pClearValues             = clear_values;
 
-            // Blur in one direction
-            {
-                // Change layout of output framebuffer
-                {
-                    VkImageMemoryBarrier barrier = {};
-                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                    barrier.pNext = nullptr;
-                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                    barrier.image         = framebuffer_blur_alpha.color_attachment.image;
-                    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                    barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_tone_mapping.memory, 0, sizeof(ubo_tone_mapping), 0, (void **)&uniform_tone_mapping.mapped));
+    }
+    uniformBuffersUpdate();
+}
 
-                    vkCmdPipelineBarrier(
-                        command_buffer_draw[i],
-                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        0,
-                        0, nullptr,
-                        0, nullptr,
-                        1, &barrier);
-                }
 
-                // Execute shader
-                {
-                    render_pass_begin_info.framebuffer = framebuffer_blur_alpha.framebuffer;
+void VulkanWindow::uniformBuffersUpdate()
+{
+    std::memcpy(ubo_nbody_graphics.matrix_projection, (camera_matrix).colmajor().toFloat().data(), 16 * sizeof(float));
+    std::memcpy(ubo_nbody_graphics.matrix_view, (rotation_origin_matrix * zoom_matrix * rotation_matrix * translation_matrix).colmajor().toFloat().data(), 16 * sizeof(float));
+    std::memcpy(ubo_nbody_graphics.matrix_model, (model_matrix).colmajor().toFloat().data(), 16 * sizeof(float));
 
-                    // Clear the color and depth attachment
-                    vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-                    vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
-                    vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+    std::memcpy(uniform_nbody_graphics.mapped, &ubo_nbody_graphics, sizeof(ubo_nbody_graphics));
+    std::memcpy(uniform_nbody_compute.mapped, &ubo_nbody_compute, sizeof(ubo_nbody_compute));
+    std::memcpy(uniform_blur.mapped, &ubo_blur, sizeof(ubo_blur));
+    std::memcpy(uniform_tone_mapping.mapped, &ubo_tone_mapping, sizeof(ubo_tone_mapping));
+    std::memcpy(uniform_performance_compute.mapped, &ubo_performance_meter_compute, sizeof(ubo_performance_meter_compute));
+    std::memcpy(uniform_performance_graphics.mapped, &ubo_performance_meter_graphics, sizeof(ubo_performance_meter_graphics));
+}
 
-                    push_constants.horizontal = 1;
 
-                    vkCmdPushConstants(
-                        command_buffer_draw[i],
-                        pipeline_layout_blur,
-                        VK_SHADER_STAGE_FRAGMENT_BIT,
-                        0,
-                        sizeof(push_constants),
-                        &push_constants);
+void VulkanWindow::generateVerticesPerformanceMeterGraphics()
+{
+    // Staging buffers
+    struct
+    {
+        VkBuffer       buf;
+        VkDeviceMemory mem;
+    }
+    vertexStaging;
 
-                    vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_blur);
-                    vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_blur, 0, 1, &descriptor_blur_alpha, 0, nullptr);
+    // Setup vertices
+    struct Vertex
+    {
+        float pos[2];
+        float uv[2];
+    };
 
-                    VkDeviceSize offsets[1] = { 0 };
-                    vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+    QVector<Vertex> vertexBuffer =
+    {
+        { {  1.0f, -0.98f }, { 1.0f, 1.0f } },
+        { { -1.0f, -0.98f }, { 0.0f, 1.0f } },
+        { { -1.0f, -0.95f }, { 0.0f, 0.0f } },
+        { {  1.0f, -0.95f }, { 1.0f, 0.0f } }
+    };
+#undef dim
+#undef normal
 
-                    // Bind index buffer
-                    vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+    uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
 
-                    // Draw vertices
-                    vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        vertexBufferSize,
+        vertexBuffer.data(),
+        &vertexStaging.buf,
+        &vertexStaging.mem);
 
-                    // End render pass
-                    vkCmdEndRenderPass(command_buffer_draw[i]);
-                }
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        vertexBufferSize,
+        nullptr,
+        &vertices_performance_meter_graphics.buffer,
+        &vertices_performance_meter_graphics.memory);
 
-                // Change layout of output framebuffer
-                {
-                    VkImageMemoryBarrier barrier = {};
-                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                    barrier.pNext = nullptr;
-                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                    barrier.image         = framebuffer_blur_alpha.color_attachment.image;
-                    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                    barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-                    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    // Transfer staging buffers to device
+    VkCommandBuffer copyCmd = commandBufferCreate();
 
-                    vkCmdPipelineBarrier(
-                        command_buffer_draw[i],
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        0,
-                        0, nullptr,
-                        0, nullptr,
-                        1, &barrier);
-                }
-            }
+    VkBufferCopy copyRegion = {};
 
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 5);
-        }
-        // Blur in the other direction, using the previous framebuffers as inputs
-        {
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 6);
+    copyRegion.size = vertexBufferSize;
+    vkCmdCopyBuffer(
+        copyCmd,
+        vertexStaging.buf,
+        vertices_performance_meter_graphics.buffer,
+        1,
+        &copyRegion);
 
-            VkViewport viewport = {};
-            viewport.width    = static_cast<float> (framebuffer_blur_beta.width);
-            viewport.height   = static_cast<float> (framebuffer_blur_beta.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
+    commandBufferSubmitAndFree(copyCmd);
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = framebuffer_blur_beta.width;
-            scissor.extent.height = framebuffer_blur_beta.height;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
+    // Destroy staging buffers
+    vkDestroyBuffer(vkbase.device(), vertexStaging.buf, nullptr);
+    vkFreeMemory(vkbase.device(), vertexStaging.mem, nullptr);
 
-            VkClearValue clear_values[1];
-            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+    // Binding description
+    vertices_performance_meter_graphics.bindingDescriptions.resize(1);
+    vertices_performance_meter_graphics.bindingDescriptions[0].binding   = VERTEX_BUFFER_BIND_ID;
+    vertices_performance_meter_graphics.bindingDescriptions[0].stride    = sizeof(Vertex);
+    vertices_performance_meter_graphics.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderArea.offset.x      = 0;
-            render_pass_begin_info.renderArea.offset.y      = 0;
-            render_pass_begin_info.renderPass               = render_pass_hdr;
-            render_pass_begin_info.renderArea.extent.width  = framebuffer_blur_beta.width;
-            render_pass_begin_info.renderArea.extent.height = framebuffer_blur_beta.height;
-            render_pass_begin_info.clearValueCount          = 1;
-            render_pass_begin_info.pClearValues             = clear_values;
+    // Attribute descriptions
+    vertices_performance_meter_graphics.attributeDescriptions.resize(2);
 
-            {
-                // Change layout of output framebuffer
-                {
-                    VkImageMemoryBarrier barrier = {};
-                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                    barrier.pNext = nullptr;
-                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                    barrier.image         = framebuffer_blur_beta.color_attachment.image;
-                    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                    barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    // Location 0 : Position
+    vertices_performance_meter_graphics.attributeDescriptions[0].location = 0;
+    vertices_performance_meter_graphics.attributeDescriptions[0].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_performance_meter_graphics.attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_performance_meter_graphics.attributeDescriptions[0].offset   = 0;
 
-                    vkCmdPipelineBarrier(
-                        command_buffer_draw[i],
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        0,
-                        0, nullptr,
-                        0, nullptr,
-                        1, &barrier);
-                }
+    // Location 1 : Texture coordinates
+    vertices_performance_meter_graphics.attributeDescriptions[1].location = 1;
+    vertices_performance_meter_graphics.attributeDescriptions[1].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_performance_meter_graphics.attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_performance_meter_graphics.attributeDescriptions[1].offset   = sizeof(float) * 2;
 
-                // Execute shader
-                {
-                    render_pass_begin_info.framebuffer = framebuffer_blur_beta.framebuffer;
+    vertices_performance_meter_graphics.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertices_performance_meter_graphics.inputState.pNext = nullptr;
+    vertices_performance_meter_graphics.inputState.flags = 0;
+    vertices_performance_meter_graphics.inputState.vertexBindingDescriptionCount   = static_cast<uint32_t> (vertices_performance_meter_graphics.bindingDescriptions.size());
+    vertices_performance_meter_graphics.inputState.pVertexBindingDescriptions      = vertices_performance_meter_graphics.bindingDescriptions.data();
+    vertices_performance_meter_graphics.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t> (vertices_performance_meter_graphics.attributeDescriptions.size());
+    vertices_performance_meter_graphics.inputState.pVertexAttributeDescriptions    = vertices_performance_meter_graphics.attributeDescriptions.data();
+}
 
-                    // Clear the color and depth attachment
-                    vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-                    vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
-                    vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
 
-                    vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_blur);
+void VulkanWindow::generateVerticesPerformanceMeterCompute()
+{
+    // Staging buffers
+    struct
+    {
+        VkBuffer       buf;
+        VkDeviceMemory mem;
+    }
+    vertexStaging;
 
-                    VkDeviceSize offsets[1] = { 0 };
-                    vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+    // Setup vertices
+    struct Vertex
+    {
+        float pos[2];
+        float uv[2];
+    };
 
-                    // Bind index buffer
-                    vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+    QVector<Vertex> vertexBuffer =
+    {
+        { {  1.0f, -0.93f }, { 1.0f, 1.0f } },
+        { { -1.0f, -0.93f }, { 0.0f, 1.0f } },
+        { { -1.0f, -0.90f }, { 0.0f, 0.0f } },
+        { {  1.0f, -0.90f }, { 1.0f, 0.0f } }
+    };
+#undef dim
+#undef normal
 
+    uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
 
-                    push_constants.horizontal = 0;
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        vertexBufferSize,
+        vertexBuffer.data(),
+        &vertexStaging.buf,
+        &vertexStaging.mem);
 
-                    vkCmdPushConstants(
-                        command_buffer_draw[i],
-                        pipeline_layout_blur,
-                        VK_SHADER_STAGE_FRAGMENT_BIT,
-                        0,
-                        sizeof(push_constants),
-                        &push_constants);
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        vertexBufferSize,
+        nullptr,
+        &vertices_performance_meter_compute.buffer,
+        &vertices_performance_meter_compute.memory);
 
-                    vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_blur, 0, 1, &descriptor_blur_beta, 0, nullptr);
+    // Transfer staging buffers to device
+    VkCommandBuffer copyCmd = commandBufferCreate();
 
-                    // Draw vertices
-                    vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+    VkBufferCopy copyRegion = {};
 
-                    // End render pass
-                    vkCmdEndRenderPass(command_buffer_draw[i]);
-                }
+    copyRegion.size = vertexBufferSize;
+    vkCmdCopyBuffer(
+        copyCmd,
+        vertexStaging.buf,
+        vertices_performance_meter_compute.buffer,
+        1,
+        &copyRegion);
 
-                // Change layout of framebuffer
-                {
-                    VkImageMemoryBarrier barrier = {};
-                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                    barrier.pNext = nullptr;
-                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                    barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                    barrier.image         = framebuffer_blur_beta.color_attachment.image;
-                    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                    barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-                    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    commandBufferSubmitAndFree(copyCmd);
 
-                    vkCmdPipelineBarrier(
-                        command_buffer_draw[i],
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        0,
-                        0, nullptr,
-                        0, nullptr,
-                        1, &barrier);
-                }
-            }
+    // Destroy staging buffers
+    vkDestroyBuffer(vkbase.device(), vertexStaging.buf, nullptr);
+    vkFreeMemory(vkbase.device(), vertexStaging.mem, nullptr);
 
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 7);
-        }
+    // Binding description
+    vertices_performance_meter_compute.bindingDescriptions.resize(1);
+    vertices_performance_meter_compute.bindingDescriptions[0].binding   = VERTEX_BUFFER_BIND_ID;
+    vertices_performance_meter_compute.bindingDescriptions[0].stride    = sizeof(Vertex);
+    vertices_performance_meter_compute.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-        // Combine
-        {
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 8);
+    // Attribute descriptions
+    vertices_performance_meter_compute.attributeDescriptions.resize(2);
 
-            VkViewport viewport = {};
-            viewport.width    = static_cast<float> (framebuffer_combine.width);
-            viewport.height   = static_cast<float> (framebuffer_combine.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
+    // Location 0 : Position
+    vertices_performance_meter_compute.attributeDescriptions[0].location = 0;
+    vertices_performance_meter_compute.attributeDescriptions[0].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_performance_meter_compute.attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_performance_meter_compute.attributeDescriptions[0].offset   = 0;
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = framebuffer_combine.width;
-            scissor.extent.height = framebuffer_combine.height;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
+    // Location 1 : Texture coordinates
+    vertices_performance_meter_compute.attributeDescriptions[1].location = 1;
+    vertices_performance_meter_compute.attributeDescriptions[1].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_performance_meter_compute.attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_performance_meter_compute.attributeDescriptions[1].offset   = sizeof(float) * 2;
 
-            VkClearValue clear_values[1];
-            clear_values[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+    vertices_performance_meter_compute.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertices_performance_meter_compute.inputState.pNext = nullptr;
+    vertices_performance_meter_compute.inputState.flags = 0;
+    vertices_performance_meter_compute.inputState.vertexBindingDescriptionCount   = static_cast<uint32_t> (vertices_performance_meter_compute.bindingDescriptions.size());
+    vertices_performance_meter_compute.inputState.pVertexBindingDescriptions      = vertices_performance_meter_compute.bindingDescriptions.data();
+    vertices_performance_meter_compute.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t> (vertices_performance_meter_compute.attributeDescriptions.size());
+    vertices_performance_meter_compute.inputState.pVertexAttributeDescriptions    = vertices_performance_meter_compute.attributeDescriptions.data();
+}
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderArea.offset.x      = 0;
-            render_pass_begin_info.renderArea.offset.y      = 0;
-            render_pass_begin_info.renderPass               = render_pass_hdr;
-            render_pass_begin_info.renderArea.extent.width  = framebuffer_combine.width;
-            render_pass_begin_info.renderArea.extent.height = framebuffer_combine.height;
-            render_pass_begin_info.clearValueCount          = 1;
-            render_pass_begin_info.pClearValues             = clear_values;
 
-            // Change layout of output framebuffer
-            {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = nullptr;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                barrier.image         = framebuffer_combine.color_attachment.image;
-                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                barrier.oldLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                barrier.newLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+void VulkanWindow::generateVerticesFullscreenQuad()
+{
+    // Staging buffers
+    struct
+    {
+        VkBuffer       buf;
+        VkDeviceMemory mem;
+    }
+    vertexStaging, indexStaging;
 
-                vkCmdPipelineBarrier(
-                    command_buffer_draw[i],
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &barrier);
-            }
+    // Setup vertices
+    struct Vertex
+    {
+        float pos[2];
+        float uv[2];
+    };
 
-            // Execute shader
-            {
-                render_pass_begin_info.framebuffer = framebuffer_combine.framebuffer;
+#define DIM    1.0f
+    QVector<Vertex> vertexBuffer =
+    {
+        { { DIM,  DIM  }, { 1.0f, 1.0f } },
+        { { -DIM, DIM  }, { 0.0f, 1.0f } },
+        { { -DIM, -DIM }, { 0.0f, 0.0f } },
+        { { DIM,  -DIM }, { 1.0f, 0.0f } }
+    };
+#undef dim
+#undef normal
 
-                // Clear the color and depth attachment
-                vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-                vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
-                vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+    uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
 
-                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_normal_texture);
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        vertexBufferSize,
+        vertexBuffer.data(),
+        &vertexStaging.buf,
+        &vertexStaging.mem);
 
-                VkDeviceSize offsets[1] = { 0 };
-                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        vertexBufferSize,
+        nullptr,
+        &vertices_fullscreen.buffer,
+        &vertices_fullscreen.memory);
 
-                // Bind index buffer
-                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+    // Setup indices
+    QVector<uint32_t> indexBuffer = { 0, 1, 2, 2, 3, 0 };
+    indices_quad.count = indexBuffer.size();
+    uint32_t indexBufferSize = indices_quad.count * sizeof(uint32_t);
 
-                // Draw blur fbo
-                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_normal_texture, 0, 1, &descriptor_normal_texture_blur, 0, nullptr);
-                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        indexBufferSize,
+        indexBuffer.data(),
+        &indexStaging.buf,
+        &indexStaging.mem);
+
+    vulkan_helper->createBuffer(
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        indexBufferSize,
+        nullptr,
+        &indices_quad.buffer,
+        &indices_quad.memory);
 
-                // Draw scene fbo
-                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_normal_texture, 0, 1, &descriptor_normal_texture_scene, 0, nullptr);
-                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+    // Transfer staging buffers to device
+    VkCommandBuffer copyCmd = commandBufferCreate();
 
-                // Draw Performance meter for graphics
-                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_performance);
-                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_performance, 0, 1, &descriptor_performance_graphics, 0, nullptr);
+    VkBufferCopy copyRegion = {};
 
-                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_performance_meter_graphics.buffer, offsets);
-                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+    copyRegion.size = vertexBufferSize;
+    vkCmdCopyBuffer(
+        copyCmd,
+        vertexStaging.buf,
+        vertices_fullscreen.buffer,
+        1,
+        &copyRegion);
 
-                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+    copyRegion.size = indexBufferSize;
+    vkCmdCopyBuffer(
+        copyCmd,
+        indexStaging.buf,
+        indices_quad.buffer,
+        1,
+        &copyRegion);
 
-                // Draw Performance meter for compute
-                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_performance, 0, 1, &descriptor_performance_compute, 0, nullptr);
+    commandBufferSubmitAndFree(copyCmd);
 
-                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_performance_meter_compute.buffer, offsets);
-                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+    // Destroy staging buffers
+    vkDestroyBuffer(vkbase.device(), vertexStaging.buf, nullptr);
+    vkFreeMemory(vkbase.device(), vertexStaging.mem, nullptr);
+    vkDestroyBuffer(vkbase.device(), indexStaging.buf, nullptr);
+    vkFreeMemory(vkbase.device(), indexStaging.mem, nullptr);
 
-                // End render pass
-                vkCmdEndRenderPass(command_buffer_draw[i]);
-            }
+    // Binding description
+    vertices_fullscreen.bindingDescriptions.resize(1);
+    vertices_fullscreen.bindingDescriptions[0].binding   = VERTEX_BUFFER_BIND_ID;
+    vertices_fullscreen.bindingDescriptions[0].stride    = sizeof(Vertex);
+    vertices_fullscreen.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-            // Change layout of output framebuffer
-            {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = nullptr;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-                barrier.image         = framebuffer_combine.color_attachment.image;
-                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.oldLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-                barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    // Attribute descriptions
+    vertices_fullscreen.attributeDescriptions.resize(2);
 
-                vkCmdPipelineBarrier(
-                    command_buffer_draw[i],
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &barrier);
-            }
+    // Location 0 : Position
+    vertices_fullscreen.attributeDescriptions[0].location = 0;
+    vertices_fullscreen.attributeDescriptions[0].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_fullscreen.attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_fullscreen.attributeDescriptions[0].offset   = 0;
 
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 9);
-        }
+    // Location 1 : Texture coordinates
+    vertices_fullscreen.attributeDescriptions[1].location = 1;
+    vertices_fullscreen.attributeDescriptions[1].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_fullscreen.attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_fullscreen.attributeDescriptions[1].offset   = sizeof(float) * 2;
 
-        // Tone mapping
-        {
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_graphics, 10);
+    vertices_fullscreen.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertices_fullscreen.inputState.pNext = nullptr;
+    vertices_fullscreen.inputState.flags = 0;
+    vertices_fullscreen.inputState.vertexBindingDescriptionCount   = static_cast<uint32_t> (vertices_fullscreen.bindingDescriptions.size());
+    vertices_fullscreen.inputState.pVertexBindingDescriptions      = vertices_fullscreen.bindingDescriptions.data();
+    vertices_fullscreen.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t> (vertices_fullscreen.attributeDescriptions.size());
+    vertices_fullscreen.inputState.pVertexAttributeDescriptions    = vertices_fullscreen.attributeDescriptions.data();
+}
 
-            VkViewport viewport = {};
-            viewport.width    = static_cast<float> (surface_capabilities.currentExtent.width);
-            viewport.height   = static_cast<float> (surface_capabilities.currentExtent.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
 
-            VkRect2D scissor = {};
-            scissor.extent.width  = surface_capabilities.currentExtent.width;
-            scissor.extent.height = surface_capabilities.currentExtent.height;
-            scissor.offset.x      = 0;
-            scissor.offset.y      = 0;
+void VulkanWindow::initializeNbodies(std::vector<Particle>& buffer, int method, float gravity_constant)
+{
+    // At most UINT32_MAX / 9 particles, see generateBuffersNbody()
+    int particle_count = static_cast<int>(buffer.size());
 
-            VkClearValue clear_values[2];
-            clear_values[0].color        = { 0.0f, 0.0f, 0.0f, 0.0f };
-            clear_values[1].depthStencil = { 1.0f, 0 };
+    std::mt19937 rng;
+    rng.seed(std::random_device()());
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderArea.offset.x      = 0;
-            render_pass_begin_info.renderArea.offset.y      = 0;
-            render_pass_begin_info.renderPass               = render_pass_ldr;
-            render_pass_begin_info.renderArea.extent.width  = surface_capabilities.currentExtent.width;
-            render_pass_begin_info.renderArea.extent.height = surface_capabilities.currentExtent.height;
-            render_pass_begin_info.clearValueCount          = 2;
-            render_pass_begin_info.pClearValues             = clear_values;
+    switch (method)
+    {
+    case 0:
+        {
+            // Initial particle positions
+            std::normal_distribution<float> dist_distr(0.0f, 0.8f);
+            std::normal_distribution<float> velocity_distr(0.0f, 0.5f);
+            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
 
-            // Execute shader
+            for (int i = 0; i < particle_count / 2; i++)
             {
-                render_pass_begin_info.framebuffer = framebuffers_swapchain[i];
+                double mass = std::fabs(mass_distr(rng));//*2.0e30;
 
-                // Clear the color and depth attachment
-                vkCmdBeginRenderPass(command_buffer_draw[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-                vkCmdSetViewport(command_buffer_draw[i], 0, 1, &viewport);
-                vkCmdSetScissor(command_buffer_draw[i], 0, 1, &scissor);
+                QVector3D angular_velocity(0, 0, -0.4);
 
-                vkCmdBindPipeline(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_tone_mapping);
-                vkCmdBindDescriptorSets(command_buffer_draw[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_tone_mapping, 0, 1, &descriptor_tone_mapping, 0, nullptr);
+                QVector3D position_base(1.5, 0.1, 0.0);
 
-                VkDeviceSize offsets[1] = { 0 };
-                vkCmdBindVertexBuffers(command_buffer_draw[i], VERTEX_BUFFER_BIND_ID, 1, &vertices_fullscreen.buffer, offsets);
+                QVector3D position(position_base.x() + dist_distr(rng),
+                                   position_base.y() + dist_distr(rng),
+                                   position_base.z() + dist_distr(rng) * 0.1);
 
-                // Draw post processed scene
-                vkCmdBindIndexBuffer(command_buffer_draw[i], indices_quad.buffer, 0, VK_INDEX_TYPE_UINT32);
+                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02);
 
-                vkCmdDrawIndexed(command_buffer_draw[i], indices_quad.count, 1, 0, 0, 0);
+                QVector3D r = position - position_base;
 
-                vkCmdEndRenderPass(command_buffer_draw[i]);
-            }
+                QVector3D velocity = QVector3D::crossProduct(r, angular_velocity) + velocity_base;
 
-            vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 11);
-        }
+                buffer[i].xyzm[0] = position.x();
+                buffer[i].xyzm[1] = position.y();
+                buffer[i].xyzm[2] = position.z();
+                buffer[i].xyzm[3] = mass;//*2.0e30;
+                buffer[i].v[0]    = velocity.x();
+                buffer[i].v[1]    = velocity.y();
+                buffer[i].v[2]    = velocity.z();
+            }
 
-        vkCmdWriteTimestamp(command_buffer_draw[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_graphics, 13);
 
-        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_draw[i]));
-    }
-}
+            for (int i = particle_count / 2; i < particle_count; i++)
+            {
+                double mass = std::fabs(mass_distr(rng));//*2.0e30;
 
+                QVector3D angular_velocity(0, 0, -0.4);
 
-void VulkanWindow::commandBuffersComputeRecord()
-{
-    VkCommandBufferBeginInfo cmd_buffer_begin_info = {};
+                QVector3D position_base(-1.5, -0.1, 0.0);
 
-    cmd_buffer_begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmd_buffer_begin_info.pNext            = nullptr;
-    cmd_buffer_begin_info.pInheritanceInfo = nullptr;
+                QVector3D position(position_base.x() + dist_distr(rng),
+                                   position_base.y() + dist_distr(rng),
+                                   position_base.z() + dist_distr(rng) * 0.1);
 
-    // Compute command buffer step 1
-    {
-        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_compute_step_1, &cmd_buffer_begin_info));
+                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02);
 
-        vkCmdResetQueryPool(command_buffer_compute_step_1, query_pool_compute, 0, 2);
-        vkCmdWriteTimestamp(command_buffer_compute_step_1, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 0);
+                QVector3D r = position - position_base;
 
-        vkCmdBindPipeline(command_buffer_compute_step_1, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_step_1);
-        vkCmdBindDescriptorSets(command_buffer_compute_step_1, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_leapgfrog, 0, 0);
+                QVector3D velocity = QVector3D::crossProduct(r, angular_velocity) + velocity_base;//.normalized()*r.length()*0.3;//*std::sqrt(particleComputeUbo.G*(mass + 3000)/r.length());// + velocity_base;
 
-        // Dispatch part of the compute job
-        uint32_t work_group_count_x  = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0])));
-        uint32_t work_group_count[3] = { work_group_count_x, 1, 1 };
 
-        vkCmdDispatch(command_buffer_compute_step_1, work_group_count[0], work_group_count[1], work_group_count[2]);
+                buffer[i].xyzm[0] = position.x();
+                buffer[i].xyzm[1] = position.y();
+                buffer[i].xyzm[2] = position.z();
+                buffer[i].xyzm[3] = mass;
+                buffer[i].v[0]    = velocity.x();
+                buffer[i].v[1]    = velocity.y();
+                buffer[i].v[2]    = velocity.z();
+            }
+            break;
+        }
 
-        vkCmdWriteTimestamp(command_buffer_compute_step_1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 1);
+    case 1:
+        {
+            // Initial particle positions
+            std::normal_distribution<float> dist_distr(0.0f, 0.7f);
+            std::normal_distribution<float> velocity_distr(0.0f, 0.5f);
+            std::normal_distribution<float> mass_distr(0.5f, 0.3f);
 
-        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_compute_step_1));
-    }
-    // Compute command buffer step 2
-    {
-        HANDLE_VK_RESULT(vkBeginCommandBuffer(command_buffer_compute_step_2, &cmd_buffer_begin_info));
+            for (int i = 0; i < particle_count / 2; i++)
+            {
+                double mass = std::fabs(mass_distr(rng));//*2.0e30;
 
-        vkCmdResetQueryPool(command_buffer_compute_step_2, query_pool_compute, 2, 2);
+                QVector3D angular_velocity(0, 0, -0.4);
 
-        // Dispatch compute job
-        {
-            vkCmdWriteTimestamp(command_buffer_compute_step_2, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_compute, 2);
+                QVector3D position_base(1.5, 0.1, 0.0);
 
-            vkCmdBindPipeline(command_buffer_compute_step_2, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute_leapfrog_step_2);
-            vkCmdBindDescriptorSets(command_buffer_compute_step_2, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_leapfrog, 0, 1, &descriptor_leapgfrog, 0, 0);
+                QVector3D position(position_base.x() + dist_distr(rng),
+                                   position_base.y() + dist_distr(rng),
+                                   position_base.z() + dist_distr(rng) * 0.1);
 
-            // Find required number of work groups
-            uint32_t work_group_count_x  = static_cast<uint32_t>(std::ceil(static_cast<double>(ubo_nbody_compute.particle_count) / static_cast<double>(work_item_count_nbody[0])));
-            uint32_t work_group_count[3] = { work_group_count_x, 1, 1 };
+                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02);
 
-            vkCmdDispatch(command_buffer_compute_step_2, work_group_count[0], work_group_count[1], work_group_count[2]);
-        }
-        // Pipeline barrier turning compute buffer into transfer source
-        {
-            VkBufferMemoryBarrier barrier = {};
-            barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-            barrier.pNext               = nullptr;
-            barrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
-            barrier.dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.buffer              = buffer_nbody_compute.buffer;
-            barrier.size                = buffer_nbody_compute.descriptor.range;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                QVector3D r = position - position_base;
 
-            // Make readable/writable for compute shader
-            vkCmdPipelineBarrier(
-                command_buffer_compute_step_2,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                0,
-                0, nullptr,
-                1, &barrier,
-                0, nullptr);
-        }
-        // Pipeline barrier turning vertex buffer into transfer destination
-        {
-            VkBufferMemoryBarrier barrier = {};
-            barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-            barrier.pNext               = nullptr;
-            barrier.srcAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-            barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.buffer              = buffer_nbody_draw.buffer;
-            barrier.size                = buffer_nbody_draw.descriptor.range;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                QVector3D velocity = sqrt(gravity_constant * (9500) / r.length()) * QVector3D::crossProduct(r, angular_velocity).normalized();// + velocity_base;
 
-            // Make readable/writable for compute shader
-            vkCmdPipelineBarrier(
-                command_buffer_compute_step_2,
-                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                0,
-                0, nullptr,
-                1, &barrier,
-                0, nullptr);
-        }
+                buffer[i].xyzm[0] = position.x();
+                buffer[i].xyzm[1] = position.y();
+                buffer[i].xyzm[2] = position.z();
+                buffer[i].xyzm[3] = mass;//*2.0e30;
+                buffer[i].v[0]    = velocity.x();
+                buffer[i].v[1]    = velocity.y();
+                buffer[i].v[2]    = velocity.z();
 
-        // Transfer data
-        {
-            VkBufferCopy region = {};
-            region.size = ubo_nbody_compute.particle_count * sizeof(Particle);
-            vkCmdCopyBuffer(
-                command_buffer_compute_step_2,
-                buffer_nbody_compute.buffer,
-                buffer_nbody_draw.buffer,
-                1,
-                &region);
-        }
+                if (i == 0)
+                {
+                    buffer[i].xyzm[0] = position_base.x();
+                    buffer[i].xyzm[1] = position_base.y();
+                    buffer[i].xyzm[2] = position_base.z();
+                    buffer[i].xyzm[3] = 9500;
+                    buffer[i].v[0]    = 0;
+                    buffer[i].v[1]    = 0;
+                    buffer[i].v[2]    = 0;
+                }
+            }
 
-        // Pipeline barrier making compute buffer shader readable/writable
-        {
-            VkBufferMemoryBarrier barrier = {};
-            barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-            barrier.pNext               = nullptr;
-            barrier.srcAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
-            barrier.buffer              = buffer_nbody_compute.buffer;
-            barrier.size                = buffer_nbody_compute.descriptor.range;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-            // Make readable/writable for compute shader
-            vkCmdPipelineBarrier(
-                command_buffer_compute_step_2,
-                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                0,
-                0, nullptr,
-                1, &barrier,
-                0, nullptr);
-        }
+            for (int i = particle_count / 2; i < particle_count; i++)
+            {
+                double mass = std::fabs(mass_distr(rng));//*2.0e30;
 
-        // Pipeline barrier making vertex buffer readable
-        {
-            VkBufferMemoryBarrier barrier = {};
-            barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-            barrier.pNext               = nullptr;
-            barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-            barrier.buffer              = buffer_nbody_draw.buffer;
-            barrier.size                = buffer_nbody_draw.descriptor.range;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                QVector3D angular_velocity(0, 0, -0.4);
 
-            // Make readable/writable for compute shader
-            vkCmdPipelineBarrier(
-                command_buffer_compute_step_2,
-                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-                0,
-                0, nullptr,
-                1, &barrier,
-                0, nullptr);
-        }
+                QVector3D position_base(-1.5, -0.1, 0.0);
 
-        vkCmdWriteTimestamp(command_buffer_compute_step_2, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_compute, 3);
+                QVector3D position(position_base.x() + dist_distr(rng),
+                                   position_base.y() + dist_distr(rng),
+                                   position_base.z() + dist_distr(rng) * 0.1);
 
-        HANDLE_VK_RESULT(vkEndCommandBuffer(command_buffer_compute_step_2));
-    }
-}
+                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02);
 
+                QVector3D r = position - position_base;
 
-void VulkanWindow::commandBuffersFree()
-{
-    HANDLE_VK_RESULT(vkQueueWaitIdle(vkbase.graphicsQueue()));
+                QVector3D velocity = sqrt(gravity_constant * (10000) / r.length()) * QVector3D::crossProduct(r, angular_velocity).normalized();// + velocity_base;
 
-    vkFreeCommandBuffers(vkbase.device(), command_pool, static_cast<uint32_t> (command_buffer_draw.size()), command_buffer_draw.data());
-    vkFreeCommandBuffers(vkbase.device(), command_pool, static_cast<uint32_t> (command_buffer_pre_present.size()), command_buffer_pre_present.data());
-    vkFreeCommandBuffers(vkbase.device(), command_pool, static_cast<uint32_t> (command_buffer_post_present.size()), command_buffer_post_present.data());
-    vkFreeCommandBuffers(vkbase.device(), command_pool, 1, &command_buffer_compute_step_1);
-    vkFreeCommandBuffers(vkbase.device(), command_pool, 1, &command_buffer_compute_step_2);
-}
+                buffer[i].xyzm[0] = position.x();
+                buffer[i].xyzm[1] = position.y();
+                buffer[i].xyzm[2] = position.z();
+                buffer[i].xyzm[3] = mass;
+                buffer[i].v[0]    = velocity.x();
+                buffer[i].v[1]    = velocity.y();
+                buffer[i].v[2]    = velocity.z();
 
+                if (i == particle_count / 2)
+                {
+                    buffer[i].xyzm[0] = position_base.x();
+                    buffer[i].xyzm[1] = position_base.y();
+                    buffer[i].xyzm[2] = position_base.z();
+                    buffer[i].xyzm[3] = 10000;
+                    buffer[i].v[0]    = 0;
+                    buffer[i].v[1]    = 0;
+                    buffer[i].v[2]    = 0;
+                }
+            }
+            break;
+        }
 
-void VulkanWindow::uniformBuffersPrepare()
-{
-    // Particles / compute
-    {
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ubo_nbody_graphics),
-            nullptr,
-            &uniform_nbody_graphics.buffer,
-            &uniform_nbody_graphics.memory,
-            &uniform_nbody_graphics.descriptor);
+    case 2:
+        {
+            // Initial particle positions
+            std::normal_distribution<float> dist_distr(0.0f, 0.5f);
+            std::normal_distribution<float> velocity_distr(0.0f, 0.5f);
+            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
 
-        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_nbody_graphics.memory, 0, sizeof(ubo_nbody_graphics), 0, (void **)&uniform_nbody_graphics.mapped));
+            for (int i = 0; i < particle_count; i++)
+            {
+                double mass = std::fabs(mass_distr(rng));//*2.0e30;
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ubo_nbody_compute),
-            nullptr,
-            &uniform_nbody_compute.buffer,
-            &uniform_nbody_compute.memory,
-            &uniform_nbody_compute.descriptor);
+                QVector3D angular_velocity(0, 0, 0.4);
 
-        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_nbody_compute.memory, 0, sizeof(ubo_nbody_compute), 0, (void **)&uniform_nbody_compute.mapped));
-    }
-    // Performance
-    {
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ubo_performance_meter_compute),
-            &ubo_performance_meter_compute,
-            &uniform_performance_compute.buffer,
-            &uniform_performance_compute.memory,
-            &uniform_performance_compute.descriptor);
+                QVector3D position_base(0, 0, 0);
 
-        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_performance_compute.memory, 0, sizeof(ubo_performance_meter_compute), 0, (void **)&uniform_performance_compute.mapped));
+                QVector3D position(position_base.x() + dist_distr(rng),
+                                   position_base.y() + dist_distr(rng),
+                                   position_base.z() + dist_distr(rng));
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ubo_performance_meter_graphics),
-            &ubo_performance_meter_graphics,
-            &uniform_performance_graphics.buffer,
-            &uniform_performance_graphics.memory,
-            &uniform_performance_graphics.descriptor);
+                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02,
+                                        0 + velocity_distr(rng) * 0.02);
 
-        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_performance_graphics.memory, 0, sizeof(ubo_performance_meter_graphics), 0, (void **)&uniform_performance_graphics.mapped));
-    }
-    // Bloom
-    {
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ubo_blur),
-            nullptr,
-            &uniform_blur.buffer,
-            &uniform_blur.memory,
-            &uniform_blur.descriptor);
+                QVector3D r = position - position_base;
 
+                QVector3D velocity = sqrt(gravity_constant * (10000) / r.length()) * QVector3D::crossProduct(r, angular_velocity).normalized();// + velocity_base;
 
-        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_blur.memory, 0, sizeof(ubo_blur), 0, (void **)&uniform_blur.mapped));
-    }
-    // Tone mapping
-    {
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(ubo_tone_mapping),
-            nullptr,
-            &uniform_tone_mapping.buffer,
-            &uniform_tone_mapping.memory,
-            &uniform_tone_mapping.descriptor);
+                buffer[i].xyzm[0] = position.x();
+                buffer[i].xyzm[1] = position.y();
+                buffer[i].xyzm[2] = position.z();
+                buffer[i].xyzm[3] = mass;//*2.0e30;
+                buffer[i].v[0]    = velocity.x();
+                buffer[i].v[1]    = velocity.y();
+                buffer[i].v[2]    = velocity.z();
 
+                if (i == 0)
+                {
+                    buffer[i].xyzm[0] = position_base.x();
+                    buffer[i].xyzm[1] = position_base.y();
+                    buffer[i].xyzm[2] = position_base.z();
+                    buffer[i].xyzm[3] = 10000;
+                    buffer[i].v[0]    = 0;
+                    buffer[i].v[1]    = 0;
+                    buffer[i].v[2]    = 0;
+                }
+            }
+            break;
+        }
 
-        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), uniform_tone_mapping.memory, 0, sizeof(ubo_tone_mapping), 0, (void **)&uniform_tone_mapping.mapped));
-    }
-    uniformBuffersUpdate();
-}
+    case 3:
+        {
+            // Initial particle positions
+            std::normal_distribution<float> dist_distr(0.0f, 0.001f);
+            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
 
+            int side = static_cast<int>(std::ceil(std::pow(static_cast<double>(particle_count), 1.0 / 3.0)));
 
-void VulkanWindow::uniformBuffersUpdate()
-{
-    std::memcpy(ubo_nbody_graphics.matrix_projection, (camera_matrix).colmajor().toFloat().data(), 16 * sizeof(float));
-    std::memcpy(ubo_nbody_graphics.matrix_view, (rotation_origin_matrix * zoom_matrix * rotation_matrix * translation_matrix).colmajor().toFloat().data(), 16 * sizeof(float));
-    std::memcpy(ubo_nbody_graphics.matrix_model, (model_matrix).colmajor().toFloat().data(), 16 * sizeof(float));
+            if (side < 1)
+            {
+                side = 1;
+            }
 
-    std::memcpy(uniform_nbody_graphics.mapped, &ubo_nbody_graphics, sizeof(ubo_nbody_graphics));
-    std::memcpy(uniform_nbody_compute.mapped, &ubo_nbody_compute, sizeof(ubo_nbody_compute));
-    std::memcpy(uniform_blur.mapped, &ubo_blur, sizeof(ubo_blur));
-    std::memcpy(uniform_tone_mapping.mapped, &ubo_tone_mapping, sizeof(ubo_tone_mapping));
-    std::memcpy(uniform_performance_compute.mapped, &ubo_performance_meter_compute, sizeof(ubo_performance_meter_compute));
-    std::memcpy(uniform_performance_graphics.mapped, &ubo_performance_meter_graphics, sizeof(ubo_performance_meter_graphics));
-}
+            for (int i = 0; i < side; i++)
+            {
+                for (int j = 0; j < side; j++)
+                {
+                    for (int k = 0; k < side; k++)
+                    {
+                        int index = i * side * side + j * side + k;
 
+                        if (index < particle_count)
+                        {
+                            double mass = std::fabs(mass_distr(rng));
 
-void VulkanWindow::generateVerticesPerformanceMeterGraphics()
-{
-    // Staging buffers
-    struct
-    {
-        VkBuffer       buf;
-        VkDeviceMemory mem;
-    }
-    vertexStaging;
+                            QVector3D position_base((static_cast<double>(i) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
+                                                    (static_cast<double>(j) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
+                                                    (static_cast<double>(k) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2);
 
-    // Setup vertices
-    struct Vertex
-    {
-        float pos[2];
-        float uv[2];
-    };
+                            QVector3D position(position_base.x() + dist_distr(rng),
+                                               position_base.y() + dist_distr(rng),
+                                               position_base.z() + dist_distr(rng));
 
-    QVector<Vertex> vertexBuffer =
-    {
-        { {  1.0f, -0.98f }, { 1.0f, 1.0f } },
-        { { -1.0f, -0.98f }, { 0.0f, 1.0f } },
-        { { -1.0f, -0.95f }, { 0.0f, 0.0f } },
-        { {  1.0f, -0.95f }, { 1.0f, 0.0f } }
-    };
-#undef dim
-#undef normal
+                            buffer[index].xyzm[0] = position.x();
+                            buffer[index].xyzm[1] = position.y();
+                            buffer[index].xyzm[2] = position.z();
+                            buffer[index].xyzm[3] = mass;
+                            buffer[index].v[0]    = 0;
+                            buffer[index].v[1]    = 0;
+                            buffer[index].v[2]    = 0;
+                        }
+                    }
+                }
+            }
+            break;
+        }
 
-    uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
+    case 4:
+        {
+            // Initial particle positions
+            std::normal_distribution<float> dist_distr(0.0f, 0.001f);
+            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
 
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        vertexBufferSize,
-        vertexBuffer.data(),
-        &vertexStaging.buf,
-        &vertexStaging.mem);
+            int side = static_cast<int>(std::ceil(std::pow(static_cast<double>(particle_count), 1.0 / 3.0)));
 
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        vertexBufferSize,
-        nullptr,
-        &vertices_performance_meter_graphics.buffer,
-        &vertices_performance_meter_graphics.memory);
+            if (side < 1)
+            {
+                side = 1;
+            }
+
+            for (int i = 0; i < side; i++)
+            {
+                for (int j = 0; j < side; j++)
+                {
+                    for (int k = 0; k < side; k++)
+                    {
+                        int index = i * side * side + j * side + k;
 
-    // Transfer staging buffers to device
-    VkCommandBuffer copyCmd = commandBufferCreate();
+                        if (index < particle_count)
+                        {
+                            double mass = std::fabs(mass_distr(rng));
 
-    VkBufferCopy copyRegion = {};
+                            QVector3D position_base((static_cast<double>(i) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
+                                                    (static_cast<double>(j) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
+                                                    (static_cast<double>(k) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2);
 
-    copyRegion.size = vertexBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        vertexStaging.buf,
-        vertices_performance_meter_graphics.buffer,
-        1,
-        &copyRegion);
+                            QVector3D position(position_base.x() + dist_distr(rng),
+                                               position_base.y() + dist_distr(rng),
+                                               position_base.z() + dist_distr(rng));
 
-    commandBufferSubmitAndFree(copyCmd);
+                            buffer[index].xyzm[0] = position.x();
+                            buffer[index].xyzm[1] = position.y();
+                            buffer[index].xyzm[2] = position.z();
+                            buffer[index].xyzm[3] = mass;
+                            buffer[index].v[0]    = 5.0 * std::sin(static_cast<double>(j) / static_cast<double>(side - 1) * 100);
+                            buffer[index].v[1]    = 0;
+                            buffer[index].v[2]    = 0;
+                        }
+                    }
+                }
+            }
+            break;
+        }
 
-    // Destroy staging buffers
-    vkDestroyBuffer(vkbase.device(), vertexStaging.buf, nullptr);
-    vkFreeMemory(vkbase.device(), vertexStaging.mem, nullptr);
+    case 5:
+        {
+            // Initial particle positions
+            std::normal_distribution<float> dist_distr(0.0f, 1.0f);
+            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
 
-    // Binding description
-    vertices_performance_meter_graphics.bindingDescriptions.resize(1);
-    vertices_performance_meter_graphics.bindingDescriptions[0].binding   = VERTEX_BUFFER_BIND_ID;
-    vertices_performance_meter_graphics.bindingDescriptions[0].stride    = sizeof(Vertex);
-    vertices_performance_meter_graphics.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+            int blob_count       = 20;
+            int blob_point_count = particle_count / blob_count;
 
-    // Attribute descriptions
-    vertices_performance_meter_graphics.attributeDescriptions.resize(2);
+            for (int i = 0; i < blob_count; i++)
+            {
+                QVector3D position_base(dist_distr(rng),
+                                        dist_distr(rng),
+                                        dist_distr(rng));
 
-    // Location 0 : Position
-    vertices_performance_meter_graphics.attributeDescriptions[0].location = 0;
-    vertices_performance_meter_graphics.attributeDescriptions[0].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_performance_meter_graphics.attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_performance_meter_graphics.attributeDescriptions[0].offset   = 0;
+                for (int j = 0; j < blob_point_count; j++)
+                {
+                    int index = i * blob_point_count + j;
 
-    // Location 1 : Texture coordinates
-    vertices_performance_meter_graphics.attributeDescriptions[1].location = 1;
-    vertices_performance_meter_graphics.attributeDescriptions[1].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_performance_meter_graphics.attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_performance_meter_graphics.attributeDescriptions[1].offset   = sizeof(float) * 2;
+                    if (index < particle_count)
+                    {
+                        QVector3D position(position_base.x() + dist_distr(rng) * 0.2,
+                                           position_base.y() + dist_distr(rng) * 0.2,
+                                           position_base.z() + dist_distr(rng) * 0.2);
 
-    vertices_performance_meter_graphics.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertices_performance_meter_graphics.inputState.pNext = nullptr;
-    vertices_performance_meter_graphics.inputState.flags = 0;
-    vertices_performance_meter_graphics.inputState.vertexBindingDescriptionCount   = static_cast<uint32_t> (vertices_performance_meter_graphics.bindingDescriptions.size());
-    vertices_performance_meter_graphics.inputState.pVertexBindingDescriptions      = vertices_performance_meter_graphics.bindingDescriptions.data();
-    vertices_performance_meter_graphics.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t> (vertices_performance_meter_graphics.attributeDescriptions.size());
-    vertices_performance_meter_graphics.inputState.pVertexAttributeDescriptions    = vertices_performance_meter_graphics.attributeDescriptions.data();
+                        double mass = std::fabs(mass_distr(rng));
+
+                        buffer[index].xyzm[0] = position.x();
+                        buffer[index].xyzm[1] = position.y();
+                        buffer[index].xyzm[2] = position.z();
+                        buffer[index].xyzm[3] = mass;
+                        buffer[index].v[0]    = 0;
+                        buffer[index].v[1]    = 0;
+                        buffer[index].v[2]    = 0;
+                    }
+                }
+            }
+            break;
+        }
+
+    default:
+        break;
+    }
 }
 
 
-void VulkanWindow::generateVerticesPerformanceMeterCompute()
+void VulkanWindow::passiveMove()
 {
-    // Staging buffers
-    struct
+    double translation_speed = 2.0;
+
+    if (p_key_shift_active)
     {
-        VkBuffer       buf;
-        VkDeviceMemory mem;
+        translation_speed *= 5;
     }
-    vertexStaging;
 
-    // Setup vertices
-    struct Vertex
-    {
-        float pos[2];
-        float uv[2];
-    };
+    double time_since_last_movement = std::min((double)keyboard_movement_timer.nsecsElapsed() / (double)(1e9), 1.0 / 30.0);
 
-    QVector<Vertex> vertexBuffer =
-    {
-        { {  1.0f, -0.93f }, { 1.0f, 1.0f } },
-        { { -1.0f, -0.93f }, { 0.0f, 1.0f } },
-        { { -1.0f, -0.90f }, { 0.0f, 0.0f } },
-        { {  1.0f, -0.90f }, { 1.0f, 0.0f } }
-    };
-#undef dim
-#undef normal
+    keyboard_movement_timer.restart();
 
-    uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
+    Matrix<double> initial_camera_direction(4, 1);
+    initial_camera_direction[0] = 0;
+    initial_camera_direction[1] = 0;
+    initial_camera_direction[2] = -1;
+    initial_camera_direction[3] = 1;
 
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        vertexBufferSize,
-        vertexBuffer.data(),
-        &vertexStaging.buf,
-        &vertexStaging.mem);
+    Matrix<double> rotated_camera_direction = rotation_matrix.inverse4x4() * initial_camera_direction;
 
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        vertexBufferSize,
-        nullptr,
-        &vertices_performance_meter_compute.buffer,
-        &vertices_performance_meter_compute.memory);
+    Matrix<double> initial_camera_horizon(4, 1);
+    initial_camera_horizon[0] = 1;
+    initial_camera_horizon[1] = 0;
+    initial_camera_horizon[2] = 0;
+    initial_camera_horizon[3] = 1;
 
-    // Transfer staging buffers to device
-    VkCommandBuffer copyCmd = commandBufferCreate();
+    Matrix<double> rotated_camera_horizon = rotation_matrix.inverse4x4() * initial_camera_horizon;
 
-    VkBufferCopy copyRegion = {};
+    Matrix<double> initial_camera_vertical(4, 1);
+    initial_camera_vertical[0] = 0;
+    initial_camera_vertical[1] = 1;
+    initial_camera_vertical[2] = 0;
+    initial_camera_vertical[3] = 1;
 
-    copyRegion.size = vertexBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        vertexStaging.buf,
-        vertices_performance_meter_compute.buffer,
-        1,
-        &copyRegion);
+    Matrix<double> rotated_camera_vertical = rotation_matrix.inverse4x4() * initial_camera_vertical;
 
-    commandBufferSubmitAndFree(copyCmd);
+    Matrix<double> camera_translation;
+    camera_translation.setIdentity(4);
+    RotationMatrix<double> pitch_yaw_rotation;
+    RotationMatrix<double> roll_rotation;
 
-    // Destroy staging buffers
-    vkDestroyBuffer(vkbase.device(), vertexStaging.buf, nullptr);
-    vkFreeMemory(vkbase.device(), vertexStaging.mem, nullptr);
+    if (p_key_w_active || p_key_s_active)
+    {
+        double magnitude = (p_key_s_active ? 1 : -1) * time_since_last_movement * translation_speed / zoom_matrix[0];
+        camera_translation[3]  += rotated_camera_direction[0] * magnitude;
+        camera_translation[7]  += rotated_camera_direction[1] * magnitude;
+        camera_translation[11] += rotated_camera_direction[2] * magnitude;
+    }
+    if (p_key_a_active || p_key_d_active)
+    {
+        double magnitude = (p_key_a_active ? 1 : -1) * time_since_last_movement * translation_speed / zoom_matrix[0];
+        camera_translation[3]  += rotated_camera_horizon[0] * magnitude;
+        camera_translation[7]  += rotated_camera_horizon[1] * magnitude;
+        camera_translation[11] += rotated_camera_horizon[2] * magnitude;
+    }
+    if (p_key_space_active)
+    {
+        double magnitude = time_since_last_movement * translation_speed / zoom_matrix[0];
+        camera_translation[3]  += rotated_camera_vertical[0] * magnitude;
+        camera_translation[7]  += rotated_camera_vertical[1] * magnitude;
+        camera_translation[11] += rotated_camera_vertical[2] * magnitude;
+    }
+    if (p_key_q_active || p_key_e_active)
+    {
+        double x = rotated_camera_direction[0];
+        double y = rotated_camera_direction[1];
+        double z = rotated_camera_direction[2];
 
-    // Binding description
-    vertices_performance_meter_compute.bindingDescriptions.resize(1);
-    vertices_performance_meter_compute.bindingDescriptions[0].binding   = VERTEX_BUFFER_BIND_ID;
-    vertices_performance_meter_compute.bindingDescriptions[0].stride    = sizeof(Vertex);
-    vertices_performance_meter_compute.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        double r   = std::sqrt(x * x + y * y + z * z);
+        double eta = pi * 0.5 - std::acos(y / r);
+        double zeta;
+        if ((z == 0) && (x == 0))
+        {
+            zeta = 0;
+        }
+        else
+        {
+            zeta = -std::atan2(x, z);
+        }
+        double roll = time_since_last_movement * 1.5;
 
-    // Attribute descriptions
-    vertices_performance_meter_compute.attributeDescriptions.resize(2);
+        if (p_key_e_active)
+        {
+            roll = -roll;
+        }
 
-    // Location 0 : Position
-    vertices_performance_meter_compute.attributeDescriptions[0].location = 0;
-    vertices_performance_meter_compute.attributeDescriptions[0].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_performance_meter_compute.attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_performance_meter_compute.attributeDescriptions[0].offset   = 0;
+        roll_rotation.setArbRotation(zeta, eta, roll);
+    }
 
-    // Location 1 : Texture coordinates
-    vertices_performance_meter_compute.attributeDescriptions[1].location = 1;
-    vertices_performance_meter_compute.attributeDescriptions[1].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_performance_meter_compute.attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_performance_meter_compute.attributeDescriptions[1].offset   = sizeof(float) * 2;
+    // Mouse movement
+    if (p_mouse_right_button_active && p_key_ctrl_active)
+    {
+        double eta = std::atan2(p_pitch_yaw_vector.y(), p_pitch_yaw_vector.x()) - 0.5 * pi;
+        double relative_magnitude = std::min(((double)this->height() * 0.5), (double)std::sqrt(p_pitch_yaw_vector.x() * p_pitch_yaw_vector.x() + p_pitch_yaw_vector.y() * p_pitch_yaw_vector.y())) / ((double)this->height() * 0.5);
+        double magnitude          = time_since_last_movement * std::pow(relative_magnitude, 2.0);
 
-    vertices_performance_meter_compute.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertices_performance_meter_compute.inputState.pNext = nullptr;
-    vertices_performance_meter_compute.inputState.flags = 0;
-    vertices_performance_meter_compute.inputState.vertexBindingDescriptionCount   = static_cast<uint32_t> (vertices_performance_meter_compute.bindingDescriptions.size());
-    vertices_performance_meter_compute.inputState.pVertexBindingDescriptions      = vertices_performance_meter_compute.bindingDescriptions.data();
-    vertices_performance_meter_compute.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t> (vertices_performance_meter_compute.attributeDescriptions.size());
-    vertices_performance_meter_compute.inputState.pVertexAttributeDescriptions    = vertices_performance_meter_compute.attributeDescriptions.data();
+        pitch_yaw_rotation.setArbRotation(-0.5 * pi, eta, magnitude);
+    }
+
+    rotation_matrix = pitch_yaw_rotation * rotation_matrix * roll_rotation;
+
+    translation_matrix = translation_matrix * camera_translation;
+
+    uniformBuffersUpdate();
 }
 
 
-void VulkanWindow::generateVerticesFullscreenQuad()
+void VulkanWindow::generateVerticesNbodyInstance()
 {
-    // Staging buffers
     struct
     {
-        VkBuffer       buf;
-        VkDeviceMemory mem;
+        VkDeviceMemory memory;
+        VkBuffer       buffer;
     }
-    vertexStaging, indexStaging;
+    stagingBuffer;
 
-    // Setup vertices
     struct Vertex
     {
-        float pos[2];
         float uv[2];
     };
 
-#define DIM    1.0f
-    QVector<Vertex> vertexBuffer =
+    // "Corner" quad
     {
-        { { DIM,  DIM  }, { 1.0f, 1.0f } },
-        { { -DIM, DIM  }, { 0.0f, 1.0f } },
-        { { -DIM, -DIM }, { 0.0f, 0.0f } },
-        { { DIM,  -DIM }, { 1.0f, 0.0f } }
-    };
-#undef dim
-#undef normal
-
-    uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
-
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        vertexBufferSize,
-        vertexBuffer.data(),
-        &vertexStaging.buf,
-        &vertexStaging.mem);
-
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        vertexBufferSize,
-        nullptr,
-        &vertices_fullscreen.buffer,
-        &vertices_fullscreen.memory);
-
-    // Setup indices
-    QVector<uint32_t> indexBuffer = { 0, 1, 2, 2, 3, 0 };
-    indices_quad.count = indexBuffer.size();
-    uint32_t indexBufferSize = indices_quad.count * sizeof(uint32_t);
-
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        indexBufferSize,
-        indexBuffer.data(),
-        &indexStaging.buf,
-        &indexStaging.mem);
-
-    vulkan_helper->createBuffer(
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        indexBufferSize,
-        nullptr,
-        &indices_quad.buffer,
-        &indices_quad.memory);
-
-    // Transfer staging buffers to device
-    VkCommandBuffer copyCmd = commandBufferCreate();
-
-    VkBufferCopy copyRegion = {};
-
-    copyRegion.size = vertexBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        vertexStaging.buf,
-        vertices_fullscreen.buffer,
-        1,
-        &copyRegion);
+        QVector<Vertex> vertexBuffer =
+        {
+            { 1.0f, 1.0f },
+            { 0.0f, 1.0f },
+            { 0.0f, 0.0f },
+            { 1.0f, 0.0f }
+        };
 
-    copyRegion.size = indexBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        indexStaging.buf,
-        indices_quad.buffer,
-        1,
-        &copyRegion);
+        uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
 
-    commandBufferSubmitAndFree(copyCmd);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            vertexBufferSize,
+            vertexBuffer.data(),
+            &stagingBuffer.buffer,
+            &stagingBuffer.memory);
 
-    // Destroy staging buffers
-    vkDestroyBuffer(vkbase.device(), vertexStaging.buf, nullptr);
-    vkFreeMemory(vkbase.device(), vertexStaging.mem, nullptr);
-    vkDestroyBuffer(vkbase.device(), indexStaging.buf, nullptr);
-    vkFreeMemory(vkbase.device(), indexStaging.mem, nullptr);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            vertexBufferSize,
+            nullptr,
+            &vertices_corner.buffer,
+            &vertices_corner.memory);
 
-    // Binding description
-    vertices_fullscreen.bindingDescriptions.resize(1);
-    vertices_fullscreen.bindingDescriptions[0].binding   = VERTEX_BUFFER_BIND_ID;
-    vertices_fullscreen.bindingDescriptions[0].stride    = sizeof(Vertex);
-    vertices_fullscreen.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        // Transfer staging buffers to device
+        VkCommandBuffer copyCmd = commandBufferCreate();
 
-    // Attribute descriptions
-    vertices_fullscreen.attributeDescriptions.resize(2);
+        VkBufferCopy copyRegion = {};
 
-    // Location 0 : Position
-    vertices_fullscreen.attributeDescriptions[0].location = 0;
-    vertices_fullscreen.attributeDescriptions[0].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_fullscreen.attributeDescriptions[0].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_fullscreen.attributeDescriptions[0].offset   = 0;
+        copyRegion.size = vertexBufferSize;
+        vkCmdCopyBuffer(
+            copyCmd,
+            stagingBuffer.buffer,
+            vertices_corner.buffer,
+            1,
+            &copyRegion);
 
-    // Location 1 : Texture coordinates
-    vertices_fullscreen.attributeDescriptions[1].location = 1;
-    vertices_fullscreen.attributeDescriptions[1].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_fullscreen.attributeDescriptions[1].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_fullscreen.attributeDescriptions[1].offset   = sizeof(float) * 2;
+        commandBufferSubmitAndFree(copyCmd);
 
-    vertices_fullscreen.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertices_fullscreen.inputState.pNext = nullptr;
-    vertices_fullscreen.inputState.flags = 0;
-    vertices_fullscreen.inputState.vertexBindingDescriptionCount   = static_cast<uint32_t> (vertices_fullscreen.bindingDescriptions.size());
-    vertices_fullscreen.inputState.pVertexBindingDescriptions      = vertices_fullscreen.bindingDescriptions.data();
-    vertices_fullscreen.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t> (vertices_fullscreen.attributeDescriptions.size());
-    vertices_fullscreen.inputState.pVertexAttributeDescriptions    = vertices_fullscreen.attributeDescriptions.data();
+        // Destroy staging buffers
+        vkDestroyBuffer(vkbase.device(), stagingBuffer.buffer, nullptr);
+        vkFreeMemory(vkbase.device(), stagingBuffer.memory, nullptr);
+    }
 }
 
 
-void VulkanWindow::initializeNbodies(QVector<Particle>& buffer, int method)
+void VulkanWindow::generateBuffersNbody()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-
-    switch (method)
+    struct
     {
-    case 0:
-        {
-            // Initial particle positions
-            std::normal_distribution<float> dist_distr(0.0f, 0.8f);
-            std::normal_distribution<float> velocity_distr(0.0f, 0.5f);
-            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
+        VkDeviceMemory memory;
+        VkBuffer       buffer;
+    }
+    stagingBuffer;
 
-            for (int i = 0; i < buffer.size() / 2; i++)
-            {
-                double mass = std::fabs(mass_distr(rng));//*2.0e30;
+    float mass_max = 0.0f;
 
-                QVector3D angular_velocity(0, 0, -0.4);
+    struct Vertex
+    {
+        float uv[2];
+    };
 
-                QVector3D position_base(1.5, 0.1, 0.0);
+    {
+        // Nbodies / particles. An ensemble generates every system separately and lays them out on a square grid,
+        // so that they can be told apart when drawn. The systems only interact with themselves
+        uint32_t ensemble_count = initialization_ensemble_count;
 
-                QVector3D position(position_base.x() + dist_distr(rng),
-                                   position_base.y() + dist_distr(rng),
-                                   position_base.z() + dist_distr(rng) * 0.1);
+        // The shaders index the particle ids as 8 * particle_count + index, in 32 bits
+        uint32_t particle_count_max = std::numeric_limits<uint32_t>::max() / 9;
 
-                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02);
+        if (static_cast<uint64_t>(initialization_particle_count) * ensemble_count > particle_count_max)
+        {
+            ensemble_count = std::max(particle_count_max / std::max(initialization_particle_count, 1u), 1u);
+            qWarning("Particle count exceeds %u, generating %u systems", particle_count_max, ensemble_count);
+        }
 
-                QVector3D r = position - position_base;
+        if (integratorOutOfCore() && (ensemble_count > 1))
+        {
+            qWarning("Ensembles are not streamed, generating a single system");
+            ensemble_count = 1;
+        }
 
-                QVector3D velocity = QVector3D::crossProduct(r, angular_velocity) + velocity_base;
+        // The in-core kernels bind a whole slot of the ring, which is limited by the largest storage buffer range of the device.
+        // Larger slots stay in device memory, but are split into segments of a block each and streamed like out-of-core. The block
+        // of the working set holds the positions and velocities of a segment, and is bound whole as well
+        VkDeviceSize storage_range_max = vkbase.physicalDeviceProperties().limits.maxStorageBufferRange;
+        VkDeviceSize slot_size         = static_cast<VkDeviceSize>(initialization_particle_count) * ensemble_count * (sizeof(Particle) + sizeof(uint32_t));
+        uint32_t     segment_size_max  = static_cast<uint32_t>(storage_range_max / sizeof(Particle)) / work_item_count_stream[0] * work_item_count_stream[0];
 
-                buffer[i].xyzm[0] = position.x();
-                buffer[i].xyzm[1] = position.y();
-                buffer[i].xyzm[2] = position.z();
-                buffer[i].xyzm[3] = mass;//*2.0e30;
-                buffer[i].v[0]    = velocity.x();
-                buffer[i].v[1]    = velocity.y();
-                buffer[i].v[2]    = velocity.z();
-            }
+        stream_block_size = std::min(initialization_stream_block_size, segment_size_max);
+        stream_segmented  = false;
 
+        if (!integratorOutOfCore() && (slot_size > storage_range_max))
+        {
+            stream_block_size = segment_size_max;
+            stream_segmented  = true;
 
-            for (int i = buffer.size() / 2; i < buffer.size(); i++)
-            {
-                double mass = std::fabs(mass_distr(rng));//*2.0e30;
+            qWarning("Particle buffers exceed the storage buffer range of the device, streaming them in segments of %u bodies", stream_block_size);
+        }
 
-                QVector3D angular_velocity(0, 0, -0.4);
+        uint32_t grid_size      = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(ensemble_count))));
 
-                QVector3D position_base(-1.5, -0.1, 0.0);
+        ubo_nbody_compute.particle_count = initialization_particle_count * ensemble_count;
+        ubo_nbody_compute.ensemble_count = ensemble_count;
 
-                QVector3D position(position_base.x() + dist_distr(rng),
-                                   position_base.y() + dist_distr(rng),
-                                   position_base.z() + dist_distr(rng) * 0.1);
+        VkDeviceSize particle_count    = static_cast<VkDeviceSize>(ubo_nbody_compute.particle_count);
+        VkDeviceSize storageBufferSize = slot_size;
 
-                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02);
+        // The device buffers are a structure of arrays. Positions and masses of all particles come first, followed by the velocities
+        // and the ids. An id stays with its particle when the particles are reordered. Every system is written into the staging
+        // buffer as soon as it is generated, so that the host only holds one system besides the staging buffer
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            storageBufferSize,
+            nullptr,
+            &stagingBuffer.buffer,
+            &stagingBuffer.memory);
 
-                QVector3D r = position - position_base;
+        void *staging_mapped = nullptr;
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), stagingBuffer.memory, 0, storageBufferSize, 0, &staging_mapped));
 
-                QVector3D velocity = QVector3D::crossProduct(r, angular_velocity) + velocity_base;//.normalized()*r.length()*0.3;//*std::sqrt(particleComputeUbo.G*(mass + 3000)/r.length());// + velocity_base;
+        float    *particle_streams = static_cast<float *>(staging_mapped);
+        uint32_t *particle_ids     = static_cast<uint32_t *>(staging_mapped) + 8 * particle_count;
 
+        // Escapers are judged against the total mass at the origin until the diagnostics have measured the centre of mass
+        ubo_nbody_compute.escape_centre[0] = 0.0f;
+        ubo_nbody_compute.escape_centre[1] = 0.0f;
+        ubo_nbody_compute.escape_centre[2] = 0.0f;
+        ubo_nbody_compute.escape_centre[3] = 0.0f;
 
-                buffer[i].xyzm[0] = position.x();
-                buffer[i].xyzm[1] = position.y();
-                buffer[i].xyzm[2] = position.z();
-                buffer[i].xyzm[3] = mass;
-                buffer[i].v[0]    = velocity.x();
-                buffer[i].v[1]    = velocity.y();
-                buffer[i].v[2]    = velocity.z();
-            }
-            break;
-        }
+        ensemble_systems.resize(ensemble_count);
 
-    case 1:
+        std::vector<Particle> system_buffer;
+
+        for (uint32_t k = 0; k < ensemble_count; k++)
         {
-            // Initial particle positions
-            std::normal_distribution<float> dist_distr(0.0f, 0.7f);
-            std::normal_distribution<float> velocity_distr(0.0f, 0.5f);
-            std::normal_distribution<float> mass_distr(0.5f, 0.3f);
+            system_buffer.assign(initialization_particle_count, Particle());
+            initializeNbodies(system_buffer, initial_condition, ubo_nbody_compute.gravity_constant);
 
-            for (int i = 0; i < buffer.size() / 2; i++)
+            if (ensemble_count > 1)
             {
-                double mass = std::fabs(mass_distr(rng));//*2.0e30;
-
-                QVector3D angular_velocity(0, 0, -0.4);
-
-                QVector3D position_base(1.5, 0.1, 0.0);
-
-                QVector3D position(position_base.x() + dist_distr(rng),
-                                   position_base.y() + dist_distr(rng),
-                                   position_base.z() + dist_distr(rng) * 0.1);
+                float radius = 0.0f;
 
-                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02);
-
-                QVector3D r = position - position_base;
-
-                QVector3D velocity = sqrt(ubo_nbody_compute.gravity_constant * (9500) / r.length()) * QVector3D::crossProduct(r, angular_velocity).normalized();// + velocity_base;
+                for (size_t i = 0; i < system_buffer.size(); i++)
+                {
+                    radius = std::max(radius, QVector3D(system_buffer[i].xyzm[0], system_buffer[i].xyzm[1], system_buffer[i].xyzm[2]).length());
+                }
 
-                buffer[i].xyzm[0] = position.x();
-                buffer[i].xyzm[1] = position.y();
-                buffer[i].xyzm[2] = position.z();
-                buffer[i].xyzm[3] = mass;//*2.0e30;
-                buffer[i].v[0]    = velocity.x();
-                buffer[i].v[1]    = velocity.y();
-                buffer[i].v[2]    = velocity.z();
+                // Systems are placed by their extent at generation and may overlap once they have evolved
+                float spacing = 2.5f * radius;
 
-                if (i == 0)
+                for (size_t i = 0; i < system_buffer.size(); i++)
                 {
-                    buffer[i].xyzm[0] = position_base.x();
-                    buffer[i].xyzm[1] = position_base.y();
-                    buffer[i].xyzm[2] = position_base.z();
-                    buffer[i].xyzm[3] = 9500;
-                    buffer[i].v[0]    = 0;
-                    buffer[i].v[1]    = 0;
-                    buffer[i].v[2]    = 0;
+                    system_buffer[i].xyzm[0] += spacing * (static_cast<float>(k % grid_size) - 0.5f * static_cast<float>(grid_size - 1));
+                    system_buffer[i].xyzm[1] += spacing * (static_cast<float>(k / grid_size) - 0.5f * static_cast<float>(grid_size - 1));
                 }
             }
 
+            VkDeviceSize system_offset = static_cast<VkDeviceSize>(k) * initialization_particle_count;
+
+            ensemble_systems[k].offset            = static_cast<uint32_t>(system_offset);
+            ensemble_systems[k].count             = initialization_particle_count;
+            ensemble_systems[k].gravity_constant  = ubo_nbody_compute.gravity_constant;
+            ensemble_systems[k].softening_squared = ubo_nbody_compute.softening_squared;
+            ensemble_systems[k].time_step         = ubo_nbody_compute.time_step;
+            ensemble_systems[k].power             = ubo_nbody_compute.power;
+            ensemble_systems[k].padding[0]        = 0;
+            ensemble_systems[k].padding[1]        = 0;
 
-            for (int i = buffer.size() / 2; i < buffer.size(); i++)
+            for (size_t i = 0; i < system_buffer.size(); i++)
             {
-                double mass = std::fabs(mass_distr(rng));//*2.0e30;
+                VkDeviceSize index = system_offset + i;
 
-                QVector3D angular_velocity(0, 0, -0.4);
+                memcpy(&particle_streams[4 * index], system_buffer[i].xyzm, 4 * sizeof(float));
+                memcpy(&particle_streams[4 * (particle_count + index)], system_buffer[i].v, 4 * sizeof(float));
+                particle_ids[index] = static_cast<uint32_t>(index);
 
-                QVector3D position_base(-1.5, -0.1, 0.0);
+                mass_max = std::max(mass_max, system_buffer[i].xyzm[3]);
+                ubo_nbody_compute.escape_centre[3] += system_buffer[i].xyzm[3];
+            }
+        }
 
-                QVector3D position(position_base.x() + dist_distr(rng),
-                                   position_base.y() + dist_distr(rng),
-                                   position_base.z() + dist_distr(rng) * 0.1);
+        vkUnmapMemory(vkbase.device(), stagingBuffer.memory);
 
-                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            ensemble_count * sizeof(EnsembleSystem),
+            nullptr,
+            &buffer_ensemble_systems.buffer,
+            &buffer_ensemble_systems.memory,
+            &buffer_ensemble_systems.descriptor);
 
-                QVector3D r = position - position_base;
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), buffer_ensemble_systems.memory, 0, ensemble_count * sizeof(EnsembleSystem), 0, &buffer_ensemble_systems.mapped));
 
-                QVector3D velocity = sqrt(ubo_nbody_compute.gravity_constant * (10000) / r.length()) * QVector3D::crossProduct(r, angular_velocity).normalized();// + velocity_base;
+        ensembleSystemsUpdate();
 
-                buffer[i].xyzm[0] = position.x();
-                buffer[i].xyzm[1] = position.y();
-                buffer[i].xyzm[2] = position.z();
-                buffer[i].xyzm[3] = mass;
-                buffer[i].v[0]    = velocity.x();
-                buffer[i].v[1]    = velocity.y();
-                buffer[i].v[2]    = velocity.z();
+        // The compute pipelines step through a ring of particle buffers, and each buffer is drawn from directly. Out-of-core, the ring
+        // is kept in host memory and only the working set of the streamed step is in device memory. Segmented rings stay in device
+        // memory. Everything else that is sized by the particle count is left with a single particle when streaming, since only the
+        // streamed step runs
+        VkMemoryPropertyFlags memory_properties_nbody = (integratorOutOfCore() && !stream_segmented) ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        uint32_t              resident_count          = integratorOutOfCore() ? 1 : ubo_nbody_compute.particle_count;
+        uint32_t              stream_count            = integratorOutOfCore() ? std::min(stream_block_size, ubo_nbody_compute.particle_count) : 1;
 
-                if (i == buffer.size() / 2)
-                {
-                    buffer[i].xyzm[0] = position_base.x();
-                    buffer[i].xyzm[1] = position_base.y();
-                    buffer[i].xyzm[2] = position_base.z();
-                    buffer[i].xyzm[3] = 10000;
-                    buffer[i].v[0]    = 0;
-                    buffer[i].v[1]    = 0;
-                    buffer[i].v[2]    = 0;
-                }
-            }
-            break;
+        // Descriptors of larger slots could not be written. They are only bound by the streamed step, which copies the segments instead
+        for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+        {
+            vulkan_helper->createBuffer(
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                memory_properties_nbody,
+                storageBufferSize,
+                nullptr,
+                &buffer_nbody[i].buffer,
+                &buffer_nbody[i].memory);
+
+            buffer_nbody[i].descriptor.range  = std::min(storageBufferSize, storage_range_max);
+            buffer_nbody[i].descriptor.buffer = buffer_nbody[i].buffer;
+            buffer_nbody[i].descriptor.offset = 0;
         }
 
-    case 2:
-        {
-            // Initial particle positions
-            std::normal_distribution<float> dist_distr(0.0f, 0.5f);
-            std::normal_distribution<float> velocity_distr(0.0f, 0.5f);
-            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
+        // Batches are not streamed, so the scratch buffer is not needed out-of-core
+        VkDeviceSize scratch_size = integratorOutOfCore() ? static_cast<VkDeviceSize>(resident_count) * (sizeof(Particle) + sizeof(uint32_t)) : storageBufferSize;
 
-            for (int i = 0; i < buffer.size(); i++)
-            {
-                double mass = std::fabs(mass_distr(rng));//*2.0e30;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            scratch_size,
+            nullptr,
+            &buffer_nbody_scratch.buffer,
+            &buffer_nbody_scratch.memory);
 
-                QVector3D angular_velocity(0, 0, 0.4);
+        buffer_nbody_scratch.descriptor.range  = scratch_size;
+        buffer_nbody_scratch.descriptor.buffer = buffer_nbody_scratch.buffer;
+        buffer_nbody_scratch.descriptor.offset = 0;
 
-                QVector3D position_base(0, 0, 0);
+        // Out-of-core working set: a block with its velocities, two tiles and the accelerations of the block
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            2 * static_cast<VkDeviceSize>(stream_count) * 4 * sizeof(float),
+            nullptr,
+            &buffer_stream_block.buffer,
+            &buffer_stream_block.memory,
+            &buffer_stream_block.descriptor);
 
-                QVector3D position(position_base.x() + dist_distr(rng),
-                                   position_base.y() + dist_distr(rng),
-                                   position_base.z() + dist_distr(rng));
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            vulkan_helper->createBuffer(
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                static_cast<VkDeviceSize>(stream_count) * 4 * sizeof(float),
+                nullptr,
+                &buffer_stream_tiles[i].buffer,
+                &buffer_stream_tiles[i].memory,
+                &buffer_stream_tiles[i].descriptor);
+        }
 
-                QVector3D velocity_base(0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02,
-                                        0 + velocity_distr(rng) * 0.02);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            static_cast<VkDeviceSize>(stream_count) * 4 * sizeof(float),
+            nullptr,
+            &buffer_stream_acceleration.buffer,
+            &buffer_stream_acceleration.memory,
+            &buffer_stream_acceleration.descriptor);
 
-                QVector3D r = position - position_base;
+        // Hermite acceleration and jerk of the previous and the current step
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            2 * resident_count * sizeof(HermiteDerivatives),
+            nullptr,
+            &buffer_hermite.buffer,
+            &buffer_hermite.memory);
 
-                QVector3D velocity = sqrt(ubo_nbody_compute.gravity_constant * (10000) / r.length()) * QVector3D::crossProduct(r, angular_velocity).normalized();// + velocity_base;
+        buffer_hermite.descriptor.range  = 2 * resident_count * sizeof(HermiteDerivatives);
+        buffer_hermite.descriptor.buffer = buffer_hermite.buffer;
+        buffer_hermite.descriptor.offset = 0;
 
-                buffer[i].xyzm[0] = position.x();
-                buffer[i].xyzm[1] = position.y();
-                buffer[i].xyzm[2] = position.z();
-                buffer[i].xyzm[3] = mass;//*2.0e30;
-                buffer[i].v[0]    = velocity.x();
-                buffer[i].v[1]    = velocity.y();
-                buffer[i].v[2]    = velocity.z();
+        // Block timestep active list and indirect dispatch arguments
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            resident_count * sizeof(uint32_t),
+            nullptr,
+            &buffer_block_active.buffer,
+            &buffer_block_active.memory);
 
-                if (i == 0)
-                {
-                    buffer[i].xyzm[0] = position_base.x();
-                    buffer[i].xyzm[1] = position_base.y();
-                    buffer[i].xyzm[2] = position_base.z();
-                    buffer[i].xyzm[3] = 10000;
-                    buffer[i].v[0]    = 0;
-                    buffer[i].v[1]    = 0;
-                    buffer[i].v[2]    = 0;
-                }
-            }
-            break;
-        }
+        buffer_block_active.descriptor.range  = resident_count * sizeof(uint32_t);
+        buffer_block_active.descriptor.buffer = buffer_block_active.buffer;
+        buffer_block_active.descriptor.offset = 0;
 
-    case 3:
-        {
-            // Initial particle positions
-            std::normal_distribution<float> dist_distr(0.0f, 0.001f);
-            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            4 * sizeof(uint32_t),
+            nullptr,
+            &buffer_block_arguments.buffer,
+            &buffer_block_arguments.memory);
 
-            int side = static_cast<int>(std::ceil(std::pow(static_cast<double>(buffer.size()), 1.0 / 3.0)));
+        buffer_block_arguments.descriptor.range  = 4 * sizeof(uint32_t);
+        buffer_block_arguments.descriptor.buffer = buffer_block_arguments.buffer;
+        buffer_block_arguments.descriptor.offset = 0;
 
-            if (side < 1)
-            {
-                side = 1;
-            }
+        // Diagnostics partial sums, one set per work group of the diagnostics shader
+        uint32_t energy_count = std::max(1u, (resident_count + work_item_count_energy[0] - 1) / work_item_count_energy[0]);
 
-            for (int i = 0; i < side; i++)
-            {
-                for (int j = 0; j < side; j++)
-                {
-                    for (int k = 0; k < side; k++)
-                    {
-                        int index = i * side * side + j * side + k;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            energy_count * sizeof(DiagnosticsPartialSums),
+            nullptr,
+            &buffer_energy.buffer,
+            &buffer_energy.memory,
+            &buffer_energy.descriptor);
 
-                        if (index < buffer.size())
-                        {
-                            double mass = std::fabs(mass_distr(rng));
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), buffer_energy.memory, 0, energy_count * sizeof(DiagnosticsPartialSums), 0, &buffer_energy.mapped));
 
-                            QVector3D position_base((static_cast<double>(i) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
-                                                    (static_cast<double>(j) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
-                                                    (static_cast<double>(k) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2);
+        // Copy to staging buffer
+        VkCommandBuffer copyCmd = commandBufferCreate();
 
-                            QVector3D position(position_base.x() + dist_distr(rng),
-                                               position_base.y() + dist_distr(rng),
-                                               position_base.z() + dist_distr(rng));
+        VkBufferCopy copyRegion = {};
+        copyRegion.size = storageBufferSize;
+        vkCmdCopyBuffer(
+            copyCmd,
+            stagingBuffer.buffer,
+            buffer_nbody[0].buffer,
+            1,
+            &copyRegion);
 
-                            buffer[index].xyzm[0] = position.x();
-                            buffer[index].xyzm[1] = position.y();
-                            buffer[index].xyzm[2] = position.z();
-                            buffer[index].xyzm[3] = mass;
-                            buffer[index].v[0]    = 0;
-                            buffer[index].v[1]    = 0;
-                            buffer[index].v[2]    = 0;
-                        }
-                    }
-                }
-            }
-            break;
-        }
+        // Todo: Barriers to change initial usage of buffers
+        commandBufferSubmitAndFree(copyCmd);
 
-    case 4:
+        vkFreeMemory(vkbase.device(), stagingBuffer.memory, nullptr);
+        vkDestroyBuffer(vkbase.device(), stagingBuffer.buffer, nullptr);
+
+        nbody_slot_compute   = 0;
+        nbody_slot_published = 0;
+        nbody_slot_drawing   = 0;
+    }
+
+    {
+        // Barnes-Hut tree. Keys are padded to a power of two for the bitonic sort. Not kept out-of-core
+        uint32_t particle_count = integratorOutOfCore() ? 1 : ubo_nbody_compute.particle_count;
+        uint32_t node_count     = (particle_count > 0) ? 2 * particle_count - 1 : 1;
+
+        tree_sort_count = 2;
+        while (tree_sort_count < particle_count)
         {
-            // Initial particle positions
-            std::normal_distribution<float> dist_distr(0.0f, 0.001f);
-            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
+            tree_sort_count <<= 1;
+        }
 
-            int side = static_cast<int>(std::ceil(std::pow(static_cast<double>(buffer.size()), 1.0 / 3.0)));
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            tree_sort_count * sizeof(uint32_t),
+            nullptr,
+            &buffer_tree_keys.buffer,
+            &buffer_tree_keys.memory,
+            &buffer_tree_keys.descriptor);
 
-            if (side < 1)
-            {
-                side = 1;
-            }
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            tree_sort_count * sizeof(uint32_t),
+            nullptr,
+            &buffer_tree_values.buffer,
+            &buffer_tree_values.memory,
+            &buffer_tree_values.descriptor);
 
-            for (int i = 0; i < side; i++)
-            {
-                for (int j = 0; j < side; j++)
-                {
-                    for (int k = 0; k < side; k++)
-                    {
-                        int index = i * side * side + j * side + k;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            node_count * sizeof(TreeNode),
+            nullptr,
+            &buffer_tree_nodes.buffer,
+            &buffer_tree_nodes.memory,
+            &buffer_tree_nodes.descriptor);
 
-                        if (index < buffer.size())
-                        {
-                            double mass = std::fabs(mass_distr(rng));
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            8 * sizeof(uint32_t),
+            nullptr,
+            &buffer_tree_bounds.buffer,
+            &buffer_tree_bounds.memory,
+            &buffer_tree_bounds.descriptor);
+    }
 
-                            QVector3D position_base((static_cast<double>(i) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
-                                                    (static_cast<double>(j) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2,
-                                                    (static_cast<double>(k) - static_cast<double>(side - 1) * 0.5) / static_cast<double>(side - 1) * 2);
+    {
+        // Particle mesh. Both padded meshes are bound as a single buffer, so the mesh is made smaller until they fit the storage
+        // buffer range of the device
+        const VkPhysicalDeviceLimits& limits = vkbase.physicalDeviceProperties().limits;
 
-                            QVector3D position(position_base.x() + dist_distr(rng),
-                                               position_base.y() + dist_distr(rng),
-                                               position_base.z() + dist_distr(rng));
+        uint32_t mesh_size = std::min(std::max(initialization_mesh_size, 16u), MESH_SIZE_MAX);
 
-                            buffer[index].xyzm[0] = position.x();
-                            buffer[index].xyzm[1] = position.y();
-                            buffer[index].xyzm[2] = position.z();
-                            buffer[index].xyzm[3] = mass;
-                            buffer[index].v[0]    = 5.0 * std::sin(static_cast<double>(j) / static_cast<double>(side - 1) * 100);
-                            buffer[index].v[1]    = 0;
-                            buffer[index].v[2]    = 0;
-                        }
-                    }
-                }
-            }
-            break;
+        while ((mesh_size > 16) && (2 * 8 * static_cast<VkDeviceSize>(mesh_size) * mesh_size * mesh_size * 2 * sizeof(float) > limits.maxStorageBufferRange))
+        {
+            mesh_size /= 2;
         }
 
-    case 5:
+        if (mesh_size != initialization_mesh_size)
         {
-            // Initial particle positions
-            std::normal_distribution<float> dist_distr(0.0f, 1.0f);
-            std::normal_distribution<float> mass_distr(0.5f, 0.1f);
+            qWarning("Particle mesh of %u cells per axis reduced to %u", initialization_mesh_size, mesh_size);
+        }
 
-            int blob_count       = 20;
-            int blob_point_count = buffer.size() / blob_count;
+        ubo_nbody_compute.mesh_size = mesh_size;
 
-            for (int i = 0; i < blob_count; i++)
-            {
-                QVector3D position_base(dist_distr(rng),
-                                        dist_distr(rng),
-                                        dist_distr(rng));
+        VkDeviceSize mesh_cell_count   = static_cast<VkDeviceSize>(mesh_size) * mesh_size * mesh_size;
+        VkDeviceSize padded_cell_count = 8 * mesh_cell_count;
 
-                for (int j = 0; j < blob_point_count; j++)
-                {
-                    int index = i * blob_point_count + j;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            mesh_cell_count * sizeof(int32_t),
+            nullptr,
+            &buffer_mesh_density.buffer,
+            &buffer_mesh_density.memory,
+            &buffer_mesh_density.descriptor);
 
-                    if (index < buffer.size())
-                    {
-                        QVector3D position(position_base.x() + dist_distr(rng) * 0.2,
-                                           position_base.y() + dist_distr(rng) * 0.2,
-                                           position_base.z() + dist_distr(rng) * 0.2);
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            2 * padded_cell_count * 2 * sizeof(float),
+            nullptr,
+            &buffer_mesh_spectra.buffer,
+            &buffer_mesh_spectra.memory,
+            &buffer_mesh_spectra.descriptor);
+    }
 
-                        double mass = std::fabs(mass_distr(rng));
+    {
+        // Collision merging. The hash grid has as many buckets as the tree sorts keys, a power of two. Not kept out-of-core
+        uint32_t particle_count = integratorOutOfCore() ? 1 : ubo_nbody_compute.particle_count;
 
-                        buffer[index].xyzm[0] = position.x();
-                        buffer[index].xyzm[1] = position.y();
-                        buffer[index].xyzm[2] = position.z();
-                        buffer[index].xyzm[3] = mass;
-                        buffer[index].v[0]    = 0;
-                        buffer[index].v[1]    = 0;
-                        buffer[index].v[2]    = 0;
-                    }
-                }
-            }
-            break;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            tree_sort_count * sizeof(uint32_t),
+            nullptr,
+            &buffer_collision_heads.buffer,
+            &buffer_collision_heads.memory,
+            &buffer_collision_heads.descriptor);
+
+        UniformData *buffers[3] = { &buffer_collision_links, &buffer_collision_targets, &buffer_collision_claims };
+
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            vulkan_helper->createBuffer(
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                std::max(particle_count, 1u) * sizeof(uint32_t),
+                nullptr,
+                &buffers[i]->buffer,
+                &buffers[i]->memory,
+                &buffers[i]->descriptor);
         }
 
-    default:
-        break;
-    }
-}
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(CollisionStatistics),
+            nullptr,
+            &buffer_collision_statistics.buffer,
+            &buffer_collision_statistics.memory,
+            &buffer_collision_statistics.descriptor);
+
+        HANDLE_VK_RESULT(vkMapMemory(vkbase.device(), buffer_collision_statistics.memory, 0, sizeof(CollisionStatistics), 0, &buffer_collision_statistics.mapped));
 
+        CollisionStatistics *statistics = static_cast<CollisionStatistics *>(buffer_collision_statistics.mapped);
+        statistics->mass_max        = mass_max;
+        statistics->removed_count   = 0;
+        statistics->remaining_count = ubo_nbody_compute.particle_count;
 
-void VulkanWindow::passiveMove()
-{
-    double translation_speed = 2.0;
+        // Compaction, one offset per particle and one per work group of the compaction shader
+        uint32_t block_count = std::max(1u, (particle_count + work_item_count_compaction[0] - 1) / work_item_count_compaction[0]);
 
-    if (p_key_shift_active)
-    {
-        translation_speed *= 5;
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            std::max(particle_count, 1u) * sizeof(uint32_t),
+            nullptr,
+            &buffer_compaction_offsets.buffer,
+            &buffer_compaction_offsets.memory,
+            &buffer_compaction_offsets.descriptor);
+
+        vulkan_helper->createBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block_count * sizeof(uint32_t),
+            nullptr,
+            &buffer_compaction_block_offsets.buffer,
+            &buffer_compaction_block_offsets.memory,
+            &buffer_compaction_block_offsets.descriptor);
     }
 
-    double time_since_last_movement = std::min((double)keyboard_movement_timer.nsecsElapsed() / (double)(1e9), 1.0 / 30.0);
+    // Binding description
+    vertices_nbody.bindingDescriptions.resize(3);
+    vertices_nbody.bindingDescriptions[0].binding   = INSTANCE_BUFFER_BIND_ID;
+    vertices_nbody.bindingDescriptions[0].stride    = 4 * sizeof(float);
+    vertices_nbody.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-    keyboard_movement_timer.restart();
+    vertices_nbody.bindingDescriptions[1].binding   = VERTEX_BUFFER_BIND_ID;
+    vertices_nbody.bindingDescriptions[1].stride    = sizeof(Vertex);
+    vertices_nbody.bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-    Matrix<double> initial_camera_direction(4, 1);
-    initial_camera_direction[0] = 0;
-    initial_camera_direction[1] = 0;
-    initial_camera_direction[2] = -1;
-    initial_camera_direction[3] = 1;
+    // The velocity stream is bound from the same particle buffer at an offset
+    vertices_nbody.bindingDescriptions[2].binding   = INSTANCE_VELOCITY_BUFFER_BIND_ID;
+    vertices_nbody.bindingDescriptions[2].stride    = 4 * sizeof(float);
+    vertices_nbody.bindingDescriptions[2].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-    Matrix<double> rotated_camera_direction = rotation_matrix.inverse4x4() * initial_camera_direction;
+    // Attribute descriptions
+    vertices_nbody.attributeDescriptions.resize(3);
 
-    Matrix<double> initial_camera_horizon(4, 1);
-    initial_camera_horizon[0] = 1;
-    initial_camera_horizon[1] = 0;
-    initial_camera_horizon[2] = 0;
-    initial_camera_horizon[3] = 1;
+    // Location 0 : Position and mass
+    vertices_nbody.attributeDescriptions[0].binding  = INSTANCE_BUFFER_BIND_ID;
+    vertices_nbody.attributeDescriptions[0].location = 0;
+    vertices_nbody.attributeDescriptions[0].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vertices_nbody.attributeDescriptions[0].offset   = 0;
 
-    Matrix<double> rotated_camera_horizon = rotation_matrix.inverse4x4() * initial_camera_horizon;
+    // Location 1 : Velocity
+    vertices_nbody.attributeDescriptions[1].binding  = INSTANCE_VELOCITY_BUFFER_BIND_ID;
+    vertices_nbody.attributeDescriptions[1].location = 1;
+    vertices_nbody.attributeDescriptions[1].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vertices_nbody.attributeDescriptions[1].offset   = 0;
 
-    Matrix<double> initial_camera_vertical(4, 1);
-    initial_camera_vertical[0] = 0;
-    initial_camera_vertical[1] = 1;
-    initial_camera_vertical[2] = 0;
-    initial_camera_vertical[3] = 1;
+    // Location 2 : Instanced attribute
+    vertices_nbody.attributeDescriptions[2].location = 2;
+    vertices_nbody.attributeDescriptions[2].binding  = VERTEX_BUFFER_BIND_ID;
+    vertices_nbody.attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
+    vertices_nbody.attributeDescriptions[2].offset   = 0;
 
-    Matrix<double> rotated_camera_vertical = rotation_matrix.inverse4x4() * initial_camera_vertical;
+    // Assign to vertex buffer
+    vertices_nbody.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertices_nbody.inputState.pNext = nullptr;
+    vertices_nbody.inputState.flags = 0;
+    vertices_nbody.inputState.vertexBindingDescriptionCount   = vertices_nbody.bindingDescriptions.size();
+    vertices_nbody.inputState.pVertexBindingDescriptions      = vertices_nbody.bindingDescriptions.data();
+    vertices_nbody.inputState.vertexAttributeDescriptionCount = vertices_nbody.attributeDescriptions.size();
+    vertices_nbody.inputState.pVertexAttributeDescriptions    = vertices_nbody.attributeDescriptions.data();
+}
 
-    Matrix<double> camera_translation;
-    camera_translation.setIdentity(4);
-    RotationMatrix<double> pitch_yaw_rotation;
-    RotationMatrix<double> roll_rotation;
 
-    if (p_key_w_active || p_key_s_active)
-    {
-        double magnitude = (p_key_s_active ? 1 : -1) * time_since_last_movement * translation_speed / zoom_matrix[0];
-        camera_translation[3]  += rotated_camera_direction[0] * magnitude;
-        camera_translation[7]  += rotated_camera_direction[1] * magnitude;
-        camera_translation[11] += rotated_camera_direction[2] * magnitude;
-    }
-    if (p_key_a_active || p_key_d_active)
-    {
-        double magnitude = (p_key_a_active ? 1 : -1) * time_since_last_movement * translation_speed / zoom_matrix[0];
-        camera_translation[3]  += rotated_camera_horizon[0] * magnitude;
-        camera_translation[7]  += rotated_camera_horizon[1] * magnitude;
-        camera_translation[11] += rotated_camera_horizon[2] * magnitude;
-    }
-    if (p_key_space_active)
+void VulkanWindow::destroyBuffersNbody()
+{
+    vkUnmapMemory(vkbase.device(), buffer_ensemble_systems.memory);
+    vkDestroyBuffer(vkbase.device(), buffer_ensemble_systems.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_ensemble_systems.memory, nullptr);
+
+    buffer_ensemble_systems.mapped = nullptr;
+
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
     {
-        double magnitude = time_since_last_movement * translation_speed / zoom_matrix[0];
-        camera_translation[3]  += rotated_camera_vertical[0] * magnitude;
-        camera_translation[7]  += rotated_camera_vertical[1] * magnitude;
-        camera_translation[11] += rotated_camera_vertical[2] * magnitude;
+        vkDestroyBuffer(vkbase.device(), buffer_nbody[i].buffer, nullptr);
+        vkFreeMemory(vkbase.device(), buffer_nbody[i].memory, nullptr);
     }
-    if (p_key_q_active || p_key_e_active)
-    {
-        double x = rotated_camera_direction[0];
-        double y = rotated_camera_direction[1];
-        double z = rotated_camera_direction[2];
 
-        double r   = std::sqrt(x * x + y * y + z * z);
-        double eta = pi * 0.5 - std::acos(y / r);
-        double zeta;
-        if ((z == 0) && (x == 0))
-        {
-            zeta = 0;
-        }
-        else
-        {
-            zeta = -std::atan2(x, z);
-        }
-        double roll = time_since_last_movement * 1.5;
+    vkDestroyBuffer(vkbase.device(), buffer_nbody_scratch.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_nbody_scratch.memory, nullptr);
 
-        if (p_key_e_active)
-        {
-            roll = -roll;
-        }
+    vkDestroyBuffer(vkbase.device(), buffer_stream_block.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_stream_block.memory, nullptr);
 
-        roll_rotation.setArbRotation(zeta, eta, roll);
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        vkDestroyBuffer(vkbase.device(), buffer_stream_tiles[i].buffer, nullptr);
+        vkFreeMemory(vkbase.device(), buffer_stream_tiles[i].memory, nullptr);
     }
 
-    // Mouse movement
-    if (p_mouse_right_button_active && p_key_ctrl_active)
-    {
-        double eta = std::atan2(p_pitch_yaw_vector.y(), p_pitch_yaw_vector.x()) - 0.5 * pi;
-        double relative_magnitude = std::min(((double)this->height() * 0.5), (double)std::sqrt(p_pitch_yaw_vector.x() * p_pitch_yaw_vector.x() + p_pitch_yaw_vector.y() * p_pitch_yaw_vector.y())) / ((double)this->height() * 0.5);
-        double magnitude          = time_since_last_movement * std::pow(relative_magnitude, 2.0);
+    vkDestroyBuffer(vkbase.device(), buffer_stream_acceleration.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_stream_acceleration.memory, nullptr);
 
-        pitch_yaw_rotation.setArbRotation(-0.5 * pi, eta, magnitude);
-    }
+    vkDestroyBuffer(vkbase.device(), buffer_hermite.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_hermite.memory, nullptr);
 
-    rotation_matrix = pitch_yaw_rotation * rotation_matrix * roll_rotation;
+    vkDestroyBuffer(vkbase.device(), buffer_block_active.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_block_active.memory, nullptr);
 
-    translation_matrix = translation_matrix * camera_translation;
+    vkDestroyBuffer(vkbase.device(), buffer_block_arguments.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_block_arguments.memory, nullptr);
 
-    uniformBuffersUpdate();
-}
+    vkUnmapMemory(vkbase.device(), buffer_energy.memory);
+    vkDestroyBuffer(vkbase.device(), buffer_energy.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_energy.memory, nullptr);
 
+    vkDestroyBuffer(vkbase.device(), buffer_tree_keys.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_tree_keys.memory, nullptr);
 
-void VulkanWindow::generateVerticesNbodyInstance()
-{
-    struct
-    {
-        VkDeviceMemory memory;
-        VkBuffer       buffer;
-    }
-    stagingBuffer;
+    vkDestroyBuffer(vkbase.device(), buffer_tree_values.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_tree_values.memory, nullptr);
 
-    struct Vertex
-    {
-        float uv[2];
-    };
+    vkDestroyBuffer(vkbase.device(), buffer_tree_nodes.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_tree_nodes.memory, nullptr);
 
-    // "Corner" quad
-    {
-        QVector<Vertex> vertexBuffer =
-        {
-            { 1.0f, 1.0f },
-            { 0.0f, 1.0f },
-            { 0.0f, 0.0f },
-            { 1.0f, 0.0f }
-        };
+    vkDestroyBuffer(vkbase.device(), buffer_tree_bounds.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_tree_bounds.memory, nullptr);
 
-        uint32_t vertexBufferSize = static_cast<uint32_t> (vertexBuffer.size()) * sizeof(Vertex);
+    vkDestroyBuffer(vkbase.device(), buffer_mesh_density.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_mesh_density.memory, nullptr);
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            vertexBufferSize,
-            vertexBuffer.data(),
-            &stagingBuffer.buffer,
-            &stagingBuffer.memory);
+    vkDestroyBuffer(vkbase.device(), buffer_mesh_spectra.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_mesh_spectra.memory, nullptr);
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            vertexBufferSize,
-            nullptr,
-            &vertices_corner.buffer,
-            &vertices_corner.memory);
+    vkDestroyBuffer(vkbase.device(), buffer_collision_heads.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_collision_heads.memory, nullptr);
 
-        // Transfer staging buffers to device
-        VkCommandBuffer copyCmd = commandBufferCreate();
+    vkDestroyBuffer(vkbase.device(), buffer_collision_links.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_collision_links.memory, nullptr);
 
-        VkBufferCopy copyRegion = {};
+    vkDestroyBuffer(vkbase.device(), buffer_collision_targets.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_collision_targets.memory, nullptr);
 
-        copyRegion.size = vertexBufferSize;
-        vkCmdCopyBuffer(
-            copyCmd,
-            stagingBuffer.buffer,
-            vertices_corner.buffer,
-            1,
-            &copyRegion);
+    vkDestroyBuffer(vkbase.device(), buffer_collision_claims.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_collision_claims.memory, nullptr);
 
-        commandBufferSubmitAndFree(copyCmd);
+    vkUnmapMemory(vkbase.device(), buffer_collision_statistics.memory);
+    vkDestroyBuffer(vkbase.device(), buffer_collision_statistics.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_collision_statistics.memory, nullptr);
 
-        // Destroy staging buffers
-        vkDestroyBuffer(vkbase.device(), stagingBuffer.buffer, nullptr);
-        vkFreeMemory(vkbase.device(), stagingBuffer.memory, nullptr);
-    }
+    vkDestroyBuffer(vkbase.device(), buffer_compaction_offsets.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_compaction_offsets.memory, nullptr);
+
+    vkDestroyBuffer(vkbase.device(), buffer_compaction_block_offsets.buffer, nullptr);
+    vkFreeMemory(vkbase.device(), buffer_compaction_block_offsets.memory, nullptr);
 }
 
 
-void VulkanWindow::generateBuffersNbody()
+void VulkanWindow::descriptorSetLayoutsCreate()
 {
-    struct
-    {
-        VkDeviceMemory memory;
-        VkBuffer       buffer;
-    }
-    stagingBuffer;
-
-    struct Vertex
+    // Leapfrog
     {
-        float uv[2];
-    };
+        QVector<VkDescriptorSetLayoutBinding> bindings;
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = 0;
 
-    {
-        // Nbodies / particles
-        ubo_nbody_compute.particle_count = initialization_particle_count;
+            bindings << binding;
+        }
 
-        QVector<Particle> particleBuffer(ubo_nbody_compute.particle_count);
-        initializeNbodies(particleBuffer, initial_condition);
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = 1;
 
-        uint32_t storageBufferSize = particleBuffer.size() * sizeof(Particle);
+            bindings << binding;
+        }
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            storageBufferSize,
-            particleBuffer.data(),
-            &stagingBuffer.buffer,
-            &stagingBuffer.memory);
+        // Output particle buffer
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = 2;
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            storageBufferSize,
-            nullptr,
-            &buffer_nbody_compute.buffer,
-            &buffer_nbody_compute.memory);
+            bindings << binding;
+        }
 
-        vulkan_helper->createBuffer(
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, // TODO: remove VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            storageBufferSize,
-            nullptr,
-            &buffer_nbody_draw.buffer,
-            &buffer_nbody_draw.memory);
+        // Hermite acceleration and jerk
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = 3;
 
-        // Copy to staging buffer
-        VkCommandBuffer copyCmd = commandBufferCreate();
+            bindings << binding;
+        }
 
-        VkBufferCopy copyRegion = {};
-        copyRegion.size = storageBufferSize;
-        vkCmdCopyBuffer(
-            copyCmd,
-            stagingBuffer.buffer,
-            buffer_nbody_compute.buffer,
-            1,
-            &copyRegion);
+        // Ensemble systems
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = 4;
 
-        vkCmdCopyBuffer(
-            copyCmd,
-            stagingBuffer.buffer,
-            buffer_nbody_draw.buffer,
-            1,
-            &copyRegion);
+            bindings << binding;
+        }
 
+        VkDescriptorSetLayoutCreateInfo layout = {};
+        layout.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout.pNext        = nullptr;
+        layout.bindingCount = static_cast<uint32_t> (bindings.size());
+        layout.pBindings    = bindings.data();
 
-        // Todo: Barriers to change initial usage of buffers
-        commandBufferSubmitAndFree(copyCmd);
+        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_leapfrog));
+    }
+    // Barnes-Hut tree
+    {
+        QVector<VkDescriptorSetLayoutBinding> bindings;
 
-        vkFreeMemory(vkbase.device(), stagingBuffer.memory, nullptr);
-        vkDestroyBuffer(vkbase.device(), stagingBuffer.buffer, nullptr);
+        // Particles, uniforms, keys, values, nodes, bounds, output particles, mesh density, mesh spectra
+        for (uint32_t i = 0; i < 9; i++)
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = (i == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = i;
 
-        buffer_nbody_compute.descriptor.range  = storageBufferSize;
-        buffer_nbody_compute.descriptor.buffer = buffer_nbody_compute.buffer;
-        buffer_nbody_compute.descriptor.offset = 0;
+            bindings << binding;
+        }
 
-        buffer_nbody_draw.descriptor.range  = storageBufferSize;
-        buffer_nbody_draw.descriptor.buffer = buffer_nbody_draw.buffer;
-        buffer_nbody_draw.descriptor.offset = 0;
-    }
+        VkDescriptorSetLayoutCreateInfo layout = {};
+        layout.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout.pNext        = nullptr;
+        layout.bindingCount = static_cast<uint32_t> (bindings.size());
+        layout.pBindings    = bindings.data();
 
-    // Binding description
-    vertices_nbody.bindingDescriptions.resize(2);
-    vertices_nbody.bindingDescriptions[0].binding   = INSTANCE_BUFFER_BIND_ID;
-    vertices_nbody.bindingDescriptions[0].stride    = sizeof(Particle);
-    vertices_nbody.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_tree));
+    }
+    // Block timesteps
+    {
+        QVector<VkDescriptorSetLayoutBinding> bindings;
 
-    vertices_nbody.bindingDescriptions[1].binding   = VERTEX_BUFFER_BIND_ID;
-    vertices_nbody.bindingDescriptions[1].stride    = sizeof(Vertex);
-    vertices_nbody.bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        // Particles, uniforms, active list, dispatch arguments
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = (i == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = i;
 
-    // Attribute descriptions
-    vertices_nbody.attributeDescriptions.resize(3);
+            bindings << binding;
+        }
 
-    // Location 0 : Position and mass
-    vertices_nbody.attributeDescriptions[0].binding  = INSTANCE_BUFFER_BIND_ID;
-    vertices_nbody.attributeDescriptions[0].location = 0;
-    vertices_nbody.attributeDescriptions[0].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
-    vertices_nbody.attributeDescriptions[0].offset   = 0;
+        VkDescriptorSetLayoutCreateInfo layout = {};
+        layout.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout.pNext        = nullptr;
+        layout.bindingCount = static_cast<uint32_t> (bindings.size());
+        layout.pBindings    = bindings.data();
 
-    // Location 1 : Velocity
-    vertices_nbody.attributeDescriptions[1].binding  = INSTANCE_BUFFER_BIND_ID;
-    vertices_nbody.attributeDescriptions[1].location = 1;
-    vertices_nbody.attributeDescriptions[1].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
-    vertices_nbody.attributeDescriptions[1].offset   = 4 * sizeof(float);
+        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_block));
+    }
+    // Collision merging
+    {
+        QVector<VkDescriptorSetLayoutBinding> bindings;
 
-    // Location 2 : Instanced attribute
-    vertices_nbody.attributeDescriptions[2].location = 2;
-    vertices_nbody.attributeDescriptions[2].binding  = VERTEX_BUFFER_BIND_ID;
-    vertices_nbody.attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
-    vertices_nbody.attributeDescriptions[2].offset   = 0;
+        // Particles, uniforms, heads, links, targets, claims, statistics
+        for (uint32_t i = 0; i < 7; i++)
+        {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.descriptorType     = (i == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorCount    = 1;
+            binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding.pImmutableSamplers = nullptr;
+            binding.binding            = i;
 
-    // Assign to vertex buffer
-    vertices_nbody.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertices_nbody.inputState.pNext = nullptr;
-    vertices_nbody.inputState.flags = 0;
-    vertices_nbody.inputState.vertexBindingDescriptionCount   = vertices_nbody.bindingDescriptions.size();
-    vertices_nbody.inputState.pVertexBindingDescriptions      = vertices_nbody.bindingDescriptions.data();
-    vertices_nbody.inputState.vertexAttributeDescriptionCount = vertices_nbody.attributeDescriptions.size();
-    vertices_nbody.inputState.pVertexAttributeDescriptions    = vertices_nbody.attributeDescriptions.data();
-}
+            bindings << binding;
+        }
 
+        VkDescriptorSetLayoutCreateInfo layout = {};
+        layout.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout.pNext        = nullptr;
+        layout.bindingCount = static_cast<uint32_t> (bindings.size());
+        layout.pBindings    = bindings.data();
 
-void VulkanWindow::descriptorSetLayoutsCreate()
-{
-    // Leapfrog
+        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_collision));
+    }
+    // Escaper removal and compaction
     {
         QVector<VkDescriptorSetLayoutBinding> bindings;
+
+        // Particles, uniforms, offsets, work group offsets, statistics, output particles
+        for (uint32_t i = 0; i < 6; i++)
         {
             VkDescriptorSetLayoutBinding binding = {};
-            binding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            binding.descriptorType     = (i == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
             binding.descriptorCount    = 1;
             binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
             binding.pImmutableSamplers = nullptr;
-            binding.binding            = 0;
+            binding.binding            = i;
 
             bindings << binding;
         }
 
+        VkDescriptorSetLayoutCreateInfo layout = {};
+        layout.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout.pNext        = nullptr;
+        layout.bindingCount = static_cast<uint32_t> (bindings.size());
+        layout.pBindings    = bindings.data();
+
+        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_compaction));
+    }
+    // Out-of-core streaming
+    {
+        QVector<VkDescriptorSetLayoutBinding> bindings;
+
+        // Block, uniforms, tile, accelerations
+        for (uint32_t i = 0; i < 4; i++)
         {
             VkDescriptorSetLayoutBinding binding = {};
-            binding.descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            binding.descriptorType     = (i == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
             binding.descriptorCount    = 1;
             binding.stageFlags         = VK_SHADER_STAGE_COMPUTE_BIT;
             binding.pImmutableSamplers = nullptr;
-            binding.binding            = 1;
+            binding.binding            = i;
 
             bindings << binding;
         }
@@ -3860,7 +6047,7 @@ void VulkanWindow::descriptorSetLayoutsCreate()
         layout.bindingCount = static_cast<uint32_t> (bindings.size());
         layout.pBindings    = bindings.data();
 
-        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_leapfrog));
+        HANDLE_VK_RESULT(vkCreateDescriptorSetLayout(vkbase.device(), &layout, nullptr, &descriptor_layout_stream));
     }
     // Performance meter
     {
@@ -4025,6 +6212,11 @@ void VulkanWindow::descriptorSetLayoutsDestroy()
     vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_blur, nullptr);
     vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_normal_texture, nullptr);
     vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_tone_mapping, nullptr);
+    vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_tree, nullptr);
+    vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_block, nullptr);
+    vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_collision, nullptr);
+    vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_compaction, nullptr);
+    vkDestroyDescriptorSetLayout(vkbase.device(), descriptor_layout_stream, nullptr);
 }
 
 
@@ -4032,11 +6224,11 @@ void VulkanWindow::descriptorPoolCreate()
 {
     QVector<VkDescriptorPoolSize> type_counts(3);
     type_counts[0].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    type_counts[0].descriptorCount = 20;
+    type_counts[0].descriptorCount = 48;
     type_counts[1].type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     type_counts[1].descriptorCount = 30;
     type_counts[2].type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    type_counts[2].descriptorCount = 5;
+    type_counts[2].descriptorCount = 216;
 
     // Create the global descriptor pool
     VkDescriptorPoolCreateInfo descriptor_pool_info = {};
@@ -4044,7 +6236,7 @@ void VulkanWindow::descriptorPoolCreate()
     descriptor_pool_info.pNext         = nullptr;
     descriptor_pool_info.poolSizeCount = static_cast<uint32_t>(type_counts.size());
     descriptor_pool_info.pPoolSizes    = type_counts.data();
-    descriptor_pool_info.maxSets       = 30;
+    descriptor_pool_info.maxSets       = 48;
 
     HANDLE_VK_RESULT(vkCreateDescriptorPool(vkbase.device(), &descriptor_pool_info, nullptr, &descriptor_pool));
 }
@@ -4073,7 +6265,62 @@ void VulkanWindow::descriptorSetsAllocate()
     {
         allocate_info.pSetLayouts = &descriptor_layout_leapfrog;
 
-        HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_leapgfrog));
+        for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+        {
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_leapfrog[i]));
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_leapfrog_to_scratch[i]));
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_leapfrog_from_scratch[i]));
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_energy[i]));
+        }
+    }
+    // Barnes-Hut tree
+    {
+        allocate_info.pSetLayouts = &descriptor_layout_tree;
+
+        for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+        {
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_tree[i]));
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_tree_to_scratch[i]));
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_tree_from_scratch[i]));
+        }
+    }
+    // Block timesteps
+    {
+        allocate_info.pSetLayouts = &descriptor_layout_block;
+
+        for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+        {
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_block[i]));
+        }
+
+        HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_block_scratch));
+    }
+    // Collision merging
+    {
+        allocate_info.pSetLayouts = &descriptor_layout_collision;
+
+        for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+        {
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_collision[i]));
+        }
+    }
+    // Escaper removal and compaction
+    {
+        allocate_info.pSetLayouts = &descriptor_layout_compaction;
+
+        for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+        {
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_compaction[i]));
+        }
+    }
+    // Out-of-core streaming
+    {
+        allocate_info.pSetLayouts = &descriptor_layout_stream;
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            HANDLE_VK_RESULT(vkAllocateDescriptorSets(vkbase.device(), &allocate_info, &descriptor_stream[i]));
+        }
     }
     // Performance
     {
@@ -4122,29 +6369,206 @@ void VulkanWindow::descriptorSetsAllocate()
 
 void VulkanWindow::descriptorSetsUpdate()
 {
-    // Leapfrog compute
+    // Leapfrog compute and Barnes-Hut tree. Every particle buffer pair a step may read from and write to has its own sets
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+    {
+        struct
+        {
+            VkDescriptorSet         leapfrog;
+            VkDescriptorSet         tree;
+            VkDescriptorBufferInfo *source;
+            VkDescriptorBufferInfo *destination;
+        }
+        sets[3] =
+        {
+            { descriptor_leapfrog[i], descriptor_tree[i], &buffer_nbody[i].descriptor, &buffer_nbody[(i + 1) % NBODY_BUFFER_COUNT].descriptor },
+            { descriptor_leapfrog_to_scratch[i], descriptor_tree_to_scratch[i], &buffer_nbody[i].descriptor, &buffer_nbody_scratch.descriptor },
+            { descriptor_leapfrog_from_scratch[i], descriptor_tree_from_scratch[i], &buffer_nbody_scratch.descriptor, &buffer_nbody[i].descriptor }
+        };
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            // Leapfrog: source particles, uniforms, destination particles, Hermite derivatives, ensemble systems
+            VkDescriptorBufferInfo *buffer_infos_leapfrog[5] =
+            {
+                sets[k].source,
+                &uniform_nbody_compute.descriptor,
+                sets[k].destination,
+                &buffer_hermite.descriptor,
+                &buffer_ensemble_systems.descriptor
+            };
+
+            for (uint32_t j = 0; j < 5; j++)
+            {
+                VkWriteDescriptorSet write = {};
+                write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.pNext           = nullptr;
+                write.dstSet          = sets[k].leapfrog;
+                write.descriptorCount = 1;
+                write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                write.pBufferInfo     = buffer_infos_leapfrog[j];
+                write.dstBinding      = j;
+
+                vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
+            }
+
+            // Tree and particle mesh: source particles, uniforms, keys, values, nodes, bounds, destination particles, mesh density,
+            // mesh spectra
+            VkDescriptorBufferInfo *buffer_infos_tree[9] =
+            {
+                sets[k].source,
+                &uniform_nbody_compute.descriptor,
+                &buffer_tree_keys.descriptor,
+                &buffer_tree_values.descriptor,
+                &buffer_tree_nodes.descriptor,
+                &buffer_tree_bounds.descriptor,
+                sets[k].destination,
+                &buffer_mesh_density.descriptor,
+                &buffer_mesh_spectra.descriptor
+            };
+
+            for (uint32_t j = 0; j < 9; j++)
+            {
+                VkWriteDescriptorSet write = {};
+                write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.pNext           = nullptr;
+                write.dstSet          = sets[k].tree;
+                write.descriptorCount = 1;
+                write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                write.pBufferInfo     = buffer_infos_tree[j];
+                write.dstBinding      = j;
+
+                vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
+            }
+        }
+    }
+    // Conservation diagnostics: particles of a ring slot, uniforms, partial sums, Hermite derivatives (unused), ensemble systems
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
     {
+        VkDescriptorBufferInfo *buffer_infos[5] =
+        {
+            &buffer_nbody[i].descriptor,
+            &uniform_nbody_compute.descriptor,
+            &buffer_energy.descriptor,
+            &buffer_hermite.descriptor,
+            &buffer_ensemble_systems.descriptor
+        };
+
+        for (uint32_t j = 0; j < 5; j++)
         {
             VkWriteDescriptorSet write = {};
             write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             write.pNext           = nullptr;
-            write.dstSet          = descriptor_leapgfrog;
+            write.dstSet          = descriptor_energy[i];
             write.descriptorCount = 1;
-            write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            write.pBufferInfo     = &buffer_nbody_compute.descriptor;
-            write.dstBinding      = 0;
+            write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo     = buffer_infos[j];
+            write.dstBinding      = j;
 
             vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
         }
+    }
+    // Block timesteps, integrating in place in each ring slot or the scratch buffer
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT + 1; i++)
+    {
+        VkDescriptorBufferInfo *buffer_infos[4] =
+        {
+            (i < NBODY_BUFFER_COUNT) ? &buffer_nbody[i].descriptor : &buffer_nbody_scratch.descriptor,
+            &uniform_nbody_compute.descriptor,
+            &buffer_block_active.descriptor,
+            &buffer_block_arguments.descriptor
+        };
+
+        for (uint32_t j = 0; j < 4; j++)
         {
             VkWriteDescriptorSet write = {};
             write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             write.pNext           = nullptr;
-            write.dstSet          = descriptor_leapgfrog;
+            write.dstSet          = (i < NBODY_BUFFER_COUNT) ? descriptor_block[i] : descriptor_block_scratch;
             write.descriptorCount = 1;
-            write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            write.pBufferInfo     = &uniform_nbody_compute.descriptor;
-            write.dstBinding      = 1;
+            write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo     = buffer_infos[j];
+            write.dstBinding      = j;
+
+            vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
+        }
+    }
+    // Collision merging, in place in each ring slot
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+    {
+        VkDescriptorBufferInfo *buffer_infos[7] =
+        {
+            &buffer_nbody[i].descriptor,
+            &uniform_nbody_compute.descriptor,
+            &buffer_collision_heads.descriptor,
+            &buffer_collision_links.descriptor,
+            &buffer_collision_targets.descriptor,
+            &buffer_collision_claims.descriptor,
+            &buffer_collision_statistics.descriptor
+        };
+
+        for (uint32_t j = 0; j < 7; j++)
+        {
+            VkWriteDescriptorSet write = {};
+            write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.pNext           = nullptr;
+            write.dstSet          = descriptor_collision[i];
+            write.descriptorCount = 1;
+            write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo     = buffer_infos[j];
+            write.dstBinding      = j;
+
+            vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
+        }
+    }
+    // Escaper removal in place in slot i, compaction from slot i into slot i + 1
+    for (uint32_t i = 0; i < NBODY_BUFFER_COUNT; i++)
+    {
+        VkDescriptorBufferInfo *buffer_infos[6] =
+        {
+            &buffer_nbody[i].descriptor,
+            &uniform_nbody_compute.descriptor,
+            &buffer_compaction_offsets.descriptor,
+            &buffer_compaction_block_offsets.descriptor,
+            &buffer_collision_statistics.descriptor,
+            &buffer_nbody[(i + 1) % NBODY_BUFFER_COUNT].descriptor
+        };
+
+        for (uint32_t j = 0; j < 6; j++)
+        {
+            VkWriteDescriptorSet write = {};
+            write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.pNext           = nullptr;
+            write.dstSet          = descriptor_compaction[i];
+            write.descriptorCount = 1;
+            write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo     = buffer_infos[j];
+            write.dstBinding      = j;
+
+            vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
+        }
+    }
+    // Out-of-core streaming, one set per tile buffer
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        VkDescriptorBufferInfo *buffer_infos[4] =
+        {
+            &buffer_stream_block.descriptor,
+            &uniform_nbody_compute.descriptor,
+            &buffer_stream_tiles[i].descriptor,
+            &buffer_stream_acceleration.descriptor
+        };
+
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            VkWriteDescriptorSet write = {};
+            write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.pNext           = nullptr;
+            write.dstSet          = descriptor_stream[i];
+            write.descriptorCount = 1;
+            write.descriptorType  = (j == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo     = buffer_infos[j];
+            write.dstBinding      = j;
 
             vkUpdateDescriptorSets(vkbase.device(), 1, &write, 0, nullptr);
         }
@@ -4389,7 +6813,9 @@ void VulkanWindow::descriptorSetsUpdate()
 
 void VulkanWindow::descriptorSetsFree()
 {
-    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_leapgfrog));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_leapfrog));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_leapfrog_to_scratch));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_leapfrog_from_scratch));
     HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_nbody));
     HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_performance_compute));
     HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_performance_graphics));
@@ -4399,6 +6825,15 @@ void VulkanWindow::descriptorSetsFree()
     HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_normal_texture_scene));
     HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_normal_texture_blur));
     HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_tone_mapping));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_tree));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_tree_to_scratch));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_tree_from_scratch));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_block));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 1, &descriptor_block_scratch));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_energy));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_collision));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, NBODY_BUFFER_COUNT, descriptor_compaction));
+    HANDLE_VK_RESULT(vkFreeDescriptorSets(vkbase.device(), descriptor_pool, 2, descriptor_stream));
 }
 
 
@@ -4418,12 +6853,76 @@ void VulkanWindow::pipelineLayoutsCreate()
         HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_nbody));
     }
     {
-        pipeline_layout_create_info.pSetLayouts = &descriptor_layout_leapfrog;
-        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_leapfrog));
+        pipeline_layout_create_info.pSetLayouts = &descriptor_layout_leapfrog;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_leapfrog));
+    }
+    {
+        pipeline_layout_create_info.pSetLayouts = &descriptor_layout_performance;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_performance));
+    }
+    {
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset     = 0;
+        pushConstantRange.size       = static_cast<uint32_t>(std::max(sizeof(push_constants_tree_sort), sizeof(push_constants_mesh)));
+
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges    = &pushConstantRange;
+        pipeline_layout_create_info.pSetLayouts            = &descriptor_layout_tree;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_tree));
+
+        pipeline_layout_create_info.pushConstantRangeCount = 0;
+        pipeline_layout_create_info.pPushConstantRanges    = nullptr;
+    }
+    {
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset     = 0;
+        pushConstantRange.size       = sizeof(push_constants_block);
+
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges    = &pushConstantRange;
+        pipeline_layout_create_info.pSetLayouts            = &descriptor_layout_block;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_block));
+
+        pipeline_layout_create_info.pushConstantRangeCount = 0;
+        pipeline_layout_create_info.pPushConstantRanges    = nullptr;
+    }
+    {
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset     = 0;
+        pushConstantRange.size       = sizeof(push_constants_symmetric);
+
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges    = &pushConstantRange;
+        pipeline_layout_create_info.pSetLayouts            = &descriptor_layout_leapfrog;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_symmetric));
+
+        pipeline_layout_create_info.pushConstantRangeCount = 0;
+        pipeline_layout_create_info.pPushConstantRanges    = nullptr;
+    }
+    {
+        pipeline_layout_create_info.pSetLayouts = &descriptor_layout_collision;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_collision));
+    }
+    {
+        pipeline_layout_create_info.pSetLayouts = &descriptor_layout_compaction;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_compaction));
     }
     {
-        pipeline_layout_create_info.pSetLayouts = &descriptor_layout_performance;
-        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_performance));
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset     = 0;
+        pushConstantRange.size       = sizeof(push_constants_stream);
+
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges    = &pushConstantRange;
+        pipeline_layout_create_info.pSetLayouts            = &descriptor_layout_stream;
+        HANDLE_VK_RESULT(vkCreatePipelineLayout(vkbase.device(), &pipeline_layout_create_info, nullptr, &pipeline_layout_stream));
+
+        pipeline_layout_create_info.pushConstantRangeCount = 0;
+        pipeline_layout_create_info.pPushConstantRanges    = nullptr;
     }
     {
         VkPushConstantRange pushConstantRange = {};
@@ -4455,16 +6954,72 @@ void VulkanWindow::pipelineLayoutsDestroy()
     vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_blur, nullptr);
     vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_normal_texture, nullptr);
     vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_tone_mapping, nullptr);
+    vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_tree, nullptr);
+    vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_block, nullptr);
+    vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_symmetric, nullptr);
+    vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_collision, nullptr);
+    vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_compaction, nullptr);
+    vkDestroyPipelineLayout(vkbase.device(), pipeline_layout_stream, nullptr);
 }
 
 
-void VulkanWindow::pipelinesCreate()
+void VulkanWindow::pipelinesComputeCreate()
 {
+    // The force law exponent is constant id 4 in every shader that evaluates the force
+    VkSpecializationMapEntry specialization_entry_power = {};
+    specialization_entry_power.constantID = 4;
+    specialization_entry_power.offset     = 0;
+    specialization_entry_power.size       = sizeof(uint32_t);
+
+    VkSpecializationInfo specialization_info_power = {};
+    specialization_info_power.mapEntryCount = 1;
+    specialization_info_power.pMapEntries   = &specialization_entry_power;
+    specialization_info_power.dataSize      = sizeof(uint32_t);
+    specialization_info_power.pData         = &specialization_nbody.power_tenths;
+
     // Leapfrog
     {
         // Shaders
-        VkShaderModule shader_module_leapfrog_step_1 = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_step_one.comp.spv");
-        VkShaderModule shader_module_leapfrog_step_2 = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_step_two.comp.spv");
+        VkShaderModule shader_module_leapfrog_step_1           = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_step_one.comp.spv");
+        VkShaderModule shader_module_leapfrog_step_1_half      = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_step_one_half.comp.spv");
+        VkShaderModule shader_module_leapfrog_step_1_broadcast = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_step_one_broadcast.comp.spv");
+        VkShaderModule shader_module_leapfrog_step_2           = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_step_two.comp.spv");
+        VkShaderModule shader_module_leapfrog_fused            = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_fused.comp.spv");
+
+        // Clamp the kernel configuration to what the device supports
+        {
+            const VkPhysicalDeviceLimits& limits = vkbase.physicalDeviceProperties().limits;
+
+            uint32_t max_work_group_size = std::min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations);
+            uint32_t max_tile_size       = limits.maxComputeSharedMemorySize / static_cast<uint32_t>(4 * sizeof(float));
+
+            specialization_nbody.work_group_size   = std::max(1u, std::min(specialization_nbody.work_group_size, max_work_group_size));
+            specialization_nbody.tile_size         = std::max(1u, std::min(specialization_nbody.tile_size, max_tile_size));
+            specialization_nbody.bodies_per_thread = std::max(1u, specialization_nbody.bodies_per_thread);
+
+            work_item_count_nbody[0] = specialization_nbody.work_group_size;
+        }
+
+        // Constant ids 0, 1, 2 and 4 in the shaders
+        VkSpecializationMapEntry specialization_entries[4] = {};
+        specialization_entries[0].constantID = 0;
+        specialization_entries[0].offset     = 0;
+        specialization_entries[0].size       = sizeof(uint32_t);
+        specialization_entries[1].constantID = 1;
+        specialization_entries[1].offset     = sizeof(uint32_t);
+        specialization_entries[1].size       = sizeof(uint32_t);
+        specialization_entries[2].constantID = 2;
+        specialization_entries[2].offset     = 2 * sizeof(uint32_t);
+        specialization_entries[2].size       = sizeof(uint32_t);
+        specialization_entries[3].constantID = 4;
+        specialization_entries[3].offset     = 3 * sizeof(uint32_t);
+        specialization_entries[3].size       = sizeof(uint32_t);
+
+        VkSpecializationInfo specialization_info = {};
+        specialization_info.mapEntryCount = 4;
+        specialization_info.pMapEntries   = specialization_entries;
+        specialization_info.dataSize      = sizeof(specialization_nbody);
+        specialization_info.pData         = &specialization_nbody;
 
         VkPipelineShaderStageCreateInfo stages = {};
         stages.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -4472,7 +7027,7 @@ void VulkanWindow::pipelinesCreate()
         stages.flags = 0;
         stages.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         stages.pName = "main";
-        stages.pSpecializationInfo = nullptr;
+        stages.pSpecializationInfo = &specialization_info;
 
         VkComputePipelineCreateInfo pipe_info = {};
         pipe_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -4485,6 +7040,35 @@ void VulkanWindow::pipelinesCreate()
 
             HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_step_1));
         }
+        {
+            // A packed half precision tile entry takes half the shared memory, so the tile holds twice as many bodies
+            const VkPhysicalDeviceLimits& limits = vkbase.physicalDeviceProperties().limits;
+
+            uint32_t max_tile_size_half = limits.maxComputeSharedMemorySize / static_cast<uint32_t>(2 * sizeof(uint32_t));
+
+            auto specialization_half = specialization_nbody;
+            specialization_half.tile_size = std::min(2 * specialization_nbody.tile_size, max_tile_size_half);
+
+            VkSpecializationInfo specialization_info_half = specialization_info;
+            specialization_info_half.pData = &specialization_half;
+
+            VkPipelineShaderStageCreateInfo stages_half = stages;
+            stages_half.module              = shader_module_leapfrog_step_1_half;
+            stages_half.pSpecializationInfo = &specialization_info_half;
+
+            pipe_info.layout = pipeline_layout_leapfrog;
+            pipe_info.stage  = stages_half;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_step_1_half));
+        }
+        {
+            // Reads the bodies without a tile, so the tile size is not used
+            stages.module    = shader_module_leapfrog_step_1_broadcast;
+            pipe_info.layout = pipeline_layout_leapfrog;
+            pipe_info.stage  = stages;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_step_1_broadcast));
+        }
         {
             stages.module    = shader_module_leapfrog_step_2;
             pipe_info.layout = pipeline_layout_leapfrog;
@@ -4492,11 +7076,491 @@ void VulkanWindow::pipelinesCreate()
 
             HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_step_2));
         }
+        {
+            stages.module    = shader_module_leapfrog_fused;
+            pipe_info.layout = pipeline_layout_leapfrog;
+            pipe_info.stage  = stages;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_fused));
+        }
+
+        // Hermite
+        {
+            QVector<QString> paths =
+            {
+                "shaders/nbody_hermite_predict.comp.spv",
+                "shaders/nbody_hermite_evaluate.comp.spv",
+                "shaders/nbody_hermite_correct.comp.spv"
+            };
+
+            VkPipeline *pipelines[3] =
+            {
+                &pipeline_compute_hermite_predict,
+                &pipeline_compute_hermite_evaluate,
+                &pipeline_compute_hermite_correct
+            };
+
+            for (int i = 0; i < paths.size(); i++)
+            {
+                VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule(paths[i]);
+
+                stages.module    = shader_module;
+                pipe_info.layout = pipeline_layout_leapfrog;
+                pipe_info.stage  = stages;
+
+                HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, pipelines[i]));
+
+                vulkan_helper->destroyVulkanShaderModule(shader_module);
+            }
+        }
+        // Yoshida, one pipeline per stage. The stage is constant id 3, between the kernel configuration and the force law
+        {
+            VkShaderModule shader_module_yoshida_drift = vulkan_helper->createVulkanShaderModule("shaders/nbody_yoshida_drift.comp.spv");
+            VkShaderModule shader_module_yoshida_kick  = vulkan_helper->createVulkanShaderModule("shaders/nbody_yoshida_kick.comp.spv");
+
+            struct
+            {
+                uint32_t work_group_size;
+                uint32_t tile_size;
+                uint32_t bodies_per_thread;
+                uint32_t stage;
+                uint32_t power_tenths;
+            }
+            specialization_yoshida =
+            {
+                specialization_nbody.work_group_size,
+                specialization_nbody.tile_size,
+                specialization_nbody.bodies_per_thread,
+                0,
+                specialization_nbody.power_tenths
+            };
+
+            VkSpecializationMapEntry specialization_entries_yoshida[5] = {};
+            for (uint32_t i = 0; i < 5; i++)
+            {
+                specialization_entries_yoshida[i].constantID = i;
+                specialization_entries_yoshida[i].offset     = i * sizeof(uint32_t);
+                specialization_entries_yoshida[i].size       = sizeof(uint32_t);
+            }
+
+            VkSpecializationInfo specialization_info_yoshida = {};
+            specialization_info_yoshida.mapEntryCount = 5;
+            specialization_info_yoshida.pMapEntries   = specialization_entries_yoshida;
+            specialization_info_yoshida.dataSize      = sizeof(specialization_yoshida);
+            specialization_info_yoshida.pData         = &specialization_yoshida;
+
+            VkPipelineShaderStageCreateInfo stages_yoshida = stages;
+            stages_yoshida.pSpecializationInfo = &specialization_info_yoshida;
+
+            for (uint32_t stage = 0; stage < 4; stage++)
+            {
+                specialization_yoshida.stage = stage;
+
+                stages_yoshida.module = shader_module_yoshida_drift;
+                pipe_info.layout      = pipeline_layout_leapfrog;
+                pipe_info.stage       = stages_yoshida;
+
+                HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_yoshida_drift[stage]));
+
+                if (stage < 3)
+                {
+                    stages_yoshida.module = shader_module_yoshida_kick;
+                    pipe_info.stage       = stages_yoshida;
+
+                    HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_yoshida_kick[stage]));
+                }
+            }
+
+            vulkan_helper->destroyVulkanShaderModule(shader_module_yoshida_drift);
+            vulkan_helper->destroyVulkanShaderModule(shader_module_yoshida_kick);
+        }
 
         // Clean up shaders
         vulkan_helper->destroyVulkanShaderModule(shader_module_leapfrog_step_1);
+        vulkan_helper->destroyVulkanShaderModule(shader_module_leapfrog_step_1_half);
+        vulkan_helper->destroyVulkanShaderModule(shader_module_leapfrog_step_1_broadcast);
         vulkan_helper->destroyVulkanShaderModule(shader_module_leapfrog_step_2);
+        vulkan_helper->destroyVulkanShaderModule(shader_module_leapfrog_fused);
+    }
+    // Barnes-Hut tree and Morton reordering
+    {
+        QVector<QString> paths =
+        {
+            "shaders/nbody_tree_bounds.comp.spv",
+            "shaders/nbody_tree_morton.comp.spv",
+            "shaders/nbody_tree_sort.comp.spv",
+            "shaders/nbody_tree_build.comp.spv",
+            "shaders/nbody_tree_moments.comp.spv",
+            "shaders/nbody_tree_walk.comp.spv",
+            "shaders/nbody_reorder.comp.spv"
+        };
+
+        VkPipeline *pipelines[7] =
+        {
+            &pipeline_compute_tree_bounds,
+            &pipeline_compute_tree_morton,
+            &pipeline_compute_tree_sort,
+            &pipeline_compute_tree_build,
+            &pipeline_compute_tree_moments,
+            &pipeline_compute_tree_walk,
+            &pipeline_compute_reorder
+        };
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext = nullptr;
+        stages.flags = 0;
+        stages.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName = "main";
+        stages.pSpecializationInfo = &specialization_info_power;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_tree;
+
+        for (int i = 0; i < paths.size(); i++)
+        {
+            VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule(paths[i]);
+
+            stages.module   = shader_module;
+            pipe_info.stage = stages;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, pipelines[i]));
+
+            vulkan_helper->destroyVulkanShaderModule(shader_module);
+        }
+
+        // Short-range tree walk of the tree and particle mesh, constant id 3 selects it
+        {
+            uint32_t specialization_short[2] = { VK_TRUE, specialization_nbody.power_tenths };
+
+            VkSpecializationMapEntry specialization_entries_short[2] = {};
+            for (uint32_t i = 0; i < 2; i++)
+            {
+                specialization_entries_short[i].constantID = 3 + i;
+                specialization_entries_short[i].offset     = i * sizeof(uint32_t);
+                specialization_entries_short[i].size       = sizeof(uint32_t);
+            }
+
+            VkSpecializationInfo specialization_info_short = {};
+            specialization_info_short.mapEntryCount = 2;
+            specialization_info_short.pMapEntries   = specialization_entries_short;
+            specialization_info_short.dataSize      = sizeof(specialization_short);
+            specialization_info_short.pData         = specialization_short;
+
+            VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_tree_walk.comp.spv");
+
+            stages.module              = shader_module;
+            stages.pSpecializationInfo = &specialization_info_short;
+            pipe_info.stage            = stages;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_tree_walk_short));
+
+            vulkan_helper->destroyVulkanShaderModule(shader_module);
+        }
+    }
+    // Particle mesh, one pipeline per pass. The pass is constant id 3 like the Yoshida stage
+    {
+        VkShaderModule shader_module     = vulkan_helper->createVulkanShaderModule("shaders/nbody_pm.comp.spv");
+        VkShaderModule shader_module_fft = vulkan_helper->createVulkanShaderModule("shaders/nbody_pm_fft.comp.spv");
+
+        uint32_t pass = 0;
+
+        VkSpecializationMapEntry specialization_entry = {};
+        specialization_entry.constantID = 3;
+        specialization_entry.offset     = 0;
+        specialization_entry.size       = sizeof(uint32_t);
+
+        VkSpecializationInfo specialization_info_mesh = {};
+        specialization_info_mesh.mapEntryCount = 1;
+        specialization_info_mesh.pMapEntries   = &specialization_entry;
+        specialization_info_mesh.dataSize      = sizeof(pass);
+        specialization_info_mesh.pData         = &pass;
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = &specialization_info_mesh;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_tree;
+        pipe_info.stage  = stages;
+
+        for (pass = 0; pass < 5; pass++)
+        {
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_mesh[pass]));
+        }
+
+        stages.module              = shader_module_fft;
+        stages.pSpecializationInfo = nullptr;
+        pipe_info.stage            = stages;
+
+        HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_mesh_fft));
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
+        vulkan_helper->destroyVulkanShaderModule(shader_module_fft);
+    }
+    // Block timesteps
+    {
+        QVector<QString> paths =
+        {
+            "shaders/nbody_block_select.comp.spv",
+            "shaders/nbody_block_kick.comp.spv",
+            "shaders/nbody_block_drift.comp.spv"
+        };
+
+        VkPipeline *pipelines[3] =
+        {
+            &pipeline_compute_block_select,
+            &pipeline_compute_block_kick,
+            &pipeline_compute_block_drift
+        };
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext = nullptr;
+        stages.flags = 0;
+        stages.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName = "main";
+        stages.pSpecializationInfo = &specialization_info_power;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_block;
+
+        for (int i = 0; i < paths.size(); i++)
+        {
+            VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule(paths[i]);
+
+            stages.module   = shader_module;
+            pipe_info.stage = stages;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, pipelines[i]));
+
+            vulkan_helper->destroyVulkanShaderModule(shader_module);
+        }
+    }
+    // Conservation diagnostics
+    {
+        VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_energy.comp.spv");
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = nullptr;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_leapfrog;
+        pipe_info.stage  = stages;
+
+        HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_energy));
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
+    }
+    // Symmetric pairs
+    {
+        VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_symmetric.comp.spv");
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = &specialization_info_power;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_symmetric;
+        pipe_info.stage  = stages;
+
+        HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_symmetric));
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
+    }
+    // Collision merging, one pipeline per pass. The pass is constant id 3 like the Yoshida stage
+    {
+        VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_collision.comp.spv");
+
+        uint32_t pass = 0;
+
+        VkSpecializationMapEntry specialization_entry = {};
+        specialization_entry.constantID = 3;
+        specialization_entry.offset     = 0;
+        specialization_entry.size       = sizeof(uint32_t);
+
+        VkSpecializationInfo specialization_info_collision = {};
+        specialization_info_collision.mapEntryCount = 1;
+        specialization_info_collision.pMapEntries   = &specialization_entry;
+        specialization_info_collision.dataSize      = sizeof(pass);
+        specialization_info_collision.pData         = &pass;
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = &specialization_info_collision;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_collision;
+        pipe_info.stage  = stages;
+
+        for (pass = 0; pass < 5; pass++)
+        {
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_collision[pass]));
+        }
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
+    }
+    // Ensemble kick and drift. The pass is constant id 3
+    {
+        VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_ensemble.comp.spv");
+
+        uint32_t pass = 0;
+
+        VkSpecializationMapEntry specialization_entry = {};
+        specialization_entry.constantID = 3;
+        specialization_entry.offset     = 0;
+        specialization_entry.size       = sizeof(uint32_t);
+
+        VkSpecializationInfo specialization_info_ensemble = {};
+        specialization_info_ensemble.mapEntryCount = 1;
+        specialization_info_ensemble.pMapEntries   = &specialization_entry;
+        specialization_info_ensemble.dataSize      = sizeof(pass);
+        specialization_info_ensemble.pData         = &pass;
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = &specialization_info_ensemble;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_leapfrog;
+        pipe_info.stage  = stages;
+
+        for (pass = 0; pass < 2; pass++)
+        {
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_ensemble[pass]));
+        }
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
+    }
+    // Out-of-core accumulation and update. The pass is constant id 3, followed by the force law exponent
+    {
+        VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_leapfrog_stream.comp.spv");
+
+        uint32_t specialization_data[2] = { 0, specialization_nbody.power_tenths };
+
+        VkSpecializationMapEntry specialization_entries[2] = {};
+        specialization_entries[0].constantID = 3;
+        specialization_entries[0].offset     = 0;
+        specialization_entries[0].size       = sizeof(uint32_t);
+        specialization_entries[1].constantID = 4;
+        specialization_entries[1].offset     = sizeof(uint32_t);
+        specialization_entries[1].size       = sizeof(uint32_t);
+
+        VkSpecializationInfo specialization_info_stream = {};
+        specialization_info_stream.mapEntryCount = 2;
+        specialization_info_stream.pMapEntries   = specialization_entries;
+        specialization_info_stream.dataSize      = sizeof(specialization_data);
+        specialization_info_stream.pData         = specialization_data;
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = &specialization_info_stream;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_stream;
+        pipe_info.stage  = stages;
+
+        for (uint32_t pass = 0; pass < 2; pass++)
+        {
+            specialization_data[0] = pass;
+
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_leapfrog_stream[pass]));
+        }
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
+    }
+    // Escaper removal and compaction, one pipeline per pass
+    {
+        VkShaderModule shader_module = vulkan_helper->createVulkanShaderModule("shaders/nbody_compact.comp.spv");
+
+        uint32_t pass = 0;
+
+        VkSpecializationMapEntry specialization_entry = {};
+        specialization_entry.constantID = 3;
+        specialization_entry.offset     = 0;
+        specialization_entry.size       = sizeof(uint32_t);
+
+        VkSpecializationInfo specialization_info_compaction = {};
+        specialization_info_compaction.mapEntryCount = 1;
+        specialization_info_compaction.pMapEntries   = &specialization_entry;
+        specialization_info_compaction.dataSize      = sizeof(pass);
+        specialization_info_compaction.pData         = &pass;
+
+        VkPipelineShaderStageCreateInfo stages = {};
+        stages.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages.pNext  = nullptr;
+        stages.flags  = 0;
+        stages.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+        stages.pName  = "main";
+        stages.module = shader_module;
+        stages.pSpecializationInfo = &specialization_info_compaction;
+
+        VkComputePipelineCreateInfo pipe_info = {};
+        pipe_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipe_info.flags  = 0;
+        pipe_info.layout = pipeline_layout_compaction;
+        pipe_info.stage  = stages;
+
+        for (pass = 0; pass < 4; pass++)
+        {
+            HANDLE_VK_RESULT(vkCreateComputePipelines(vkbase.device(), pipeline_cache, 1, &pipe_info, nullptr, &pipeline_compute_compaction[pass]));
+        }
+
+        vulkan_helper->destroyVulkanShaderModule(shader_module);
     }
+}
+
+
+void VulkanWindow::pipelinesCreate()
+{
+    pipelinesComputeCreate();
 
     VkPipelineViewportStateCreateInfo viewport_state_create_info = {};
 
@@ -4988,10 +8052,60 @@ void VulkanWindow::pipelinesCreate()
 }
 
 
-void VulkanWindow::pipelinesDestroy()
+void VulkanWindow::pipelinesComputeDestroy()
 {
     vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_step_1, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_step_1_half, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_step_1_broadcast, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_symmetric, nullptr);
     vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_step_2, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_fused, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_ensemble[0], nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_ensemble[1], nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_stream[0], nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_leapfrog_stream[1], nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_bounds, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_hermite_predict, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_hermite_evaluate, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_hermite_correct, nullptr);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        vkDestroyPipeline(vkbase.device(), pipeline_compute_yoshida_drift[i], nullptr);
+    }
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        vkDestroyPipeline(vkbase.device(), pipeline_compute_yoshida_kick[i], nullptr);
+    }
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_block_select, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_block_kick, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_block_drift, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_energy, nullptr);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        vkDestroyPipeline(vkbase.device(), pipeline_compute_collision[i], nullptr);
+    }
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        vkDestroyPipeline(vkbase.device(), pipeline_compute_compaction[i], nullptr);
+    }
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_morton, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_sort, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_build, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_moments, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_walk, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_tree_walk_short, nullptr);
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        vkDestroyPipeline(vkbase.device(), pipeline_compute_mesh[i], nullptr);
+    }
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_mesh_fft, nullptr);
+    vkDestroyPipeline(vkbase.device(), pipeline_compute_reorder, nullptr);
+}
+
+
+void VulkanWindow::pipelinesDestroy()
+{
+    pipelinesComputeDestroy();
     vkDestroyPipeline(vkbase.device(), pipeline_performance, nullptr);
     vkDestroyPipeline(vkbase.device(), pipeline_nbody, nullptr);
     vkDestroyPipeline(vkbase.device(), pipeline_luminosity, nullptr);
@@ -5003,15 +8117,58 @@ void VulkanWindow::pipelinesDestroy()
 
 void VulkanWindow::pipelineCacheCreate()
 {
+    // Start from the pipelines compiled in previous runs. The driver ignores data written by a different device or driver
+    QByteArray cache_data;
+    QFile      cache_file(pipelineCachePath());
+
+    if (cache_file.open(QIODevice::ReadOnly))
+    {
+        cache_data = cache_file.readAll();
+    }
+    else if (cache_file.exists())
+    {
+        qWarning("The pipeline cache %s could not be read: %s", qPrintable(cache_file.fileName()), qPrintable(cache_file.errorString()));
+    }
+
     VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 
-    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.initialDataSize = static_cast<size_t>(cache_data.size());
+    pipelineCacheCreateInfo.pInitialData    = cache_data.constData();
     HANDLE_VK_RESULT(vkCreatePipelineCache(vkbase.device(), &pipelineCacheCreateInfo, nullptr, &pipeline_cache));
 }
 
 
+QString VulkanWindow::pipelineCachePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pipeline_cache.bin";
+}
+
+
 void VulkanWindow::pipelineCacheDestroy()
 {
+    // Keep the compiled pipelines, including every force law variant built so far, for the next run
+    size_t cache_size = 0;
+    HANDLE_VK_RESULT(vkGetPipelineCacheData(vkbase.device(), pipeline_cache, &cache_size, nullptr));
+
+    QByteArray cache_data(static_cast<int>(cache_size), 0);
+    HANDLE_VK_RESULT(vkGetPipelineCacheData(vkbase.device(), pipeline_cache, &cache_size, cache_data.data()));
+
+    QFile cache_file(pipelineCachePath());
+
+    if (!QDir().mkpath(QFileInfo(cache_file).absolutePath()))
+    {
+        qWarning("The directory of the pipeline cache %s could not be created", qPrintable(cache_file.fileName()));
+    }
+    else if (!cache_file.open(QIODevice::WriteOnly))
+    {
+        qWarning("The pipeline cache %s could not be saved: %s", qPrintable(cache_file.fileName()), qPrintable(cache_file.errorString()));
+    }
+    else if (cache_file.write(cache_data.constData(), static_cast<qint64>(cache_size)) != static_cast<qint64>(cache_size))
+    {
+        qWarning("The pipeline cache %s could not be saved: %s", qPrintable(cache_file.fileName()), qPrintable(cache_file.errorString()));
+    }
+
     vkDestroyPipelineCache(vkbase.device(), pipeline_cache, nullptr);
 }
 
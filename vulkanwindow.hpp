@@ -12,6 +12,8 @@
 #include <QVector3D>
 
 #include <random>
+#include <limits>
+#include <vector>
 #include "BUILD_OPTIONS.h"
 #include "platform.hpp"
 #include "vulkanbase.hpp"
@@ -29,6 +31,18 @@ public:
 
     void initialize();
 
+    // Particles as generated on the host. The device buffers store them as a structure of arrays followed by the particle ids,
+    // see generateBuffersNbody()
+    struct Particle
+    {
+        float xyzm[4];
+        float v[4];
+    };
+
+    // Fills the buffer with one of the initial conditions. Also used by the CPU engine, which runs without a window. A std::vector,
+    // since a QVector of Qt 5 is limited to 2 GB
+    static void initializeNbodies(std::vector<Particle>& buffer, int method, float gravity_constant);
+
 public slots:
     void setGravitationalConstant(double value);
     void setSoftening(double value);
@@ -36,6 +50,9 @@ public slots:
     void setBloomStrength(int value);
     void setBloomExtent(int value);
     void setParticleCount(int value);
+    void setEnsembleCount(int value);
+    void setOutOfCoreBlockSize(int value);
+    void setEnsembleSystem(int index, double gravity_constant, double softening_squared, double time_step, double power);
     void setPower(int value);
     void launch();
     void setInitialCondition(int value);
@@ -46,6 +63,19 @@ public slots:
     void setGamma(int value);
     void setToneMappingMode(int value);
     void setParticleSize(int value);
+    void setForceSolver(int value);
+    void setOpeningAngle(double value);
+    void setIntegrator(int value);
+    void setStepsPerSubmit(int value);
+    void setForceKernel(int value);
+    void setReorderInterval(int value);
+    void setCollisionMerging(bool value);
+    void setForceSliceSize(int value);
+    void setDiagnosticsInterval(int value);
+    void setEscapeRadius(double value);
+    void setMeshSize(int value);
+    void setMeshAssignment(int value);
+    void setMeshSplitScale(double value);
 
 private slots:
     void update();
@@ -93,20 +123,246 @@ private:
         float    softening_squared = 0.005;
         float    power             = 1.5;
         uint32_t particle_count;
+        uint32_t padding[3];                          // std140 aligns the following uvec3 to 16 bytes
         uint32_t work_group_offset[3] = { 0, 0, 0 };
+        float    opening_angle        = 0.5;
+        float    block_accuracy       = 0.02; // Time bin criterion, t = block_accuracy * sqrt(softening / |a|)
+        uint32_t block_level_max      = 4;    // The smallest time bin takes steps of time_step / 2^block_level_max
+        float    collision_radius     = 0.05; // Radius of a body of unit mass, as drawn by nbody.vert. Set from the particle size
+        float    escape_radius        = 0;    // Distance from the centre of mass beyond which unbound bodies are removed, zero disables it
+        float    escape_centre[4]     = { 0, 0, 0, 0 }; // Centre of mass and total mass, from the initial particles and the diagnostics
+        uint32_t ensemble_count       = 1;    // Independent systems sharing the particle buffers, see EnsembleSystem
+        uint32_t mesh_size            = 32;   // Cells per axis of the particle mesh, set on launch
+        uint32_t mesh_assignment      = 1;    // Mass assignment and force interpolation: nearest grid point, cloud in cell, triangular shaped cloud
+        float    mesh_split_scale     = 1.25; // Scale of the Gaussian that splits the force between the mesh and the tree, in cells
     }
     ubo_nbody_compute;
 
-    struct Particle
+    // Leapfrog kernel configuration. Passed to the shaders as specialization constants and clamped to device limits in pipelinesCreate()
+    struct
     {
-        float xyzm[4];
-        float v[4];
+        uint32_t work_group_size   = 256;
+        uint32_t tile_size         = 256;
+        uint32_t bodies_per_thread = 2;
+        uint32_t power_tenths      = 15; // Force law exponent times ten, constant id 4. Must match ubo_nbody_compute.power
+    }
+    specialization_nbody;
+
+    uint32_t work_item_count_nbody[3]  = { 128, 1, 1 }; // Set from specialization_nbody
+    uint32_t work_item_count_tree[3]   = { 128, 1, 1 }; // Must match that in shader
+    uint32_t work_item_count_energy[3] = { 128, 1, 1 }; // Must match that in shader
+
+    // Ensembles. Every system is a contiguous range of particles with its own parameters, which start out as those of the window
+    struct EnsembleSystem
+    {
+        uint32_t offset;
+        uint32_t count;
+        float    gravity_constant;
+        float    softening_squared;
+        float    time_step;
+        float    power;
+        uint32_t padding[2];
+    };
+
+    QVector<EnsembleSystem> ensemble_systems;
+    UniformData             buffer_ensemble_systems; // Mapped
+    uint32_t                work_item_count_ensemble[3] = { 128, 1, 1 }; // Must match that in shader
+    bool integratorEnsemble() const;
+    void ensembleSystemsUpdate();
+
+    // Out-of-core streaming. The ring of particle buffers is kept in host memory, and each step streams blocks of bodies through a
+    // fixed working set in device memory, see commandBufferComputeStreamRecord(). Rings whose slots exceed the storage buffer range
+    // of the device are streamed the same way in segments, but stay in device memory
+    struct
+    {
+        uint32_t block_count;
+        uint32_t tile_count;
+        uint32_t first_tile;
+    }
+    push_constants_stream;
+
+    uint32_t    stream_block_size = 0;      // Bodies per block, zero keeps the particles in device memory
+    bool        stream_segmented  = false;  // Streamed because of the storage buffer range, with the ring in device memory
+    UniformData buffer_stream_block;        // Positions and masses of the block being integrated, followed by its velocities
+    UniformData buffer_stream_tiles[2];     // Positions and masses of the bodies acting on the block, double buffered
+    UniformData buffer_stream_acceleration; // Accelerations of the block, accumulated over the tiles
+    uint32_t    work_item_count_stream[3] = { 128, 1, 1 }; // Must match that in shader
+    bool integratorOutOfCore() const;
+
+    // Variants of the all-pairs kick of the leapfrog integrator
+    enum ForceKernel
+    {
+        FORCE_KERNEL_SHARED_TILES      = 0, // Tiles of bodies in shared memory
+        FORCE_KERNEL_SHARED_TILES_HALF = 1, // Tiles of packed half floats in shared memory
+        FORCE_KERNEL_BROADCAST         = 2, // Every invocation reads the same body, without shared memory or barriers
+        FORCE_KERNEL_SYMMETRIC         = 3  // Every pair is evaluated once and applied to both bodies
+    };
+
+    int force_kernel = FORCE_KERNEL_SHARED_TILES;
+
+    // Symmetric kernel. A diagonal pass is followed by round robin rounds over pairs of tiles
+    struct
+    {
+        uint32_t round;
+    }
+    push_constants_symmetric;
+
+    static const uint32_t SYMMETRIC_ROUND_DIAGONAL = 0xFFFFFFFF;
+    uint32_t work_item_count_symmetric[3] = { 64, 1, 1 }; // Must match that in shader
+    uint32_t tile_size_symmetric          = 256;          // Must match that in shader
+
+    // Ring of particle buffers. Each compute step reads one slot and writes the next, and draws read straight from the newest completed slot
+    static const uint32_t NBODY_BUFFER_COUNT = 3;
+
+    UniformData buffer_nbody[NBODY_BUFFER_COUNT];
+    uint32_t    nbody_slot_compute   = 0; // Slot holding the newest submitted state
+    uint32_t    nbody_slot_published = 0; // Slot holding the newest completed state
+    uint32_t    nbody_slot_drawing   = 0; // Slot read by the draw in flight
+    UniformData buffer_nbody_scratch;     // Intermediate state between the steps of a batch, never drawn
+    void destroyBuffersNbody();
+
+    // Morton reordering. Every reorder_interval steps the particles are sorted along the curve to keep neighbours close in memory
+    uint32_t reorder_interval    = 100; // Zero disables reordering
+    uint32_t steps_since_reorder = 0;
+
+    // Time integration
+    enum Integrator
+    {
+        INTEGRATOR_LEAPFROG       = 0,
+        INTEGRATOR_LEAPFROG_FUSED = 1,
+        INTEGRATOR_LEAPFROG_BLOCK = 2,
+        INTEGRATOR_HERMITE        = 3,
+        INTEGRATOR_YOSHIDA        = 4
     };
 
-    uint32_t work_item_count_nbody[3] = { 128, 1, 1 }; // Must match that in shader
+    int      integrator       = INTEGRATOR_LEAPFROG;
+    uint32_t steps_per_submit = 1; // Steps recorded into a single batch command buffer
+    bool integratorFused() const;
+    bool integratorBlock() const;
+    bool integratorHermite() const;
+    bool integratorYoshida() const;
+    bool integratorBatched() const;
+    void integratorHermiteInitialize();
+
+    // Kick slicing. The kick of a step is split into submissions of force_slice_size work groups each
+    uint32_t force_slice_size = 0; // Zero disables slicing
+    uint32_t force_slice      = 0; // Next slice of the step in progress
+    bool     integratorSliced() const;
+    uint32_t forceSliceCount() const;
+
+    // Hermite acceleration and jerk. The buffer holds those of the previous step followed by those of the current step
+    struct HermiteDerivatives
+    {
+        float acceleration[4];
+        float jerk[4];
+    };
+
+    UniformData buffer_hermite;
+
+    // Conservation diagnostics, taken every diagnostics_interval steps and read back once their pass has finished. The errors are
+    // relative to the values measured first after a launch or a change of the force
+    struct DiagnosticsPartialSums
+    {
+        float energy[4];           // Kinetic energy, potential energy, mass
+        float momentum[4];         // Linear momentum, sum of its magnitudes
+        float angular_momentum[4]; // Angular momentum about the origin, sum of its magnitudes
+        float mass_moment[4];      // Mass weighted position
+    };
+
+    UniformData buffer_energy; // Partial sums of each work group, mapped
+    uint32_t    diagnostics_interval        = 100; // Zero disables the diagnostics
+    uint32_t    steps_since_diagnostics     = 0;
+    bool        diagnostics_pending         = false; // Submitted and not yet read back
+    double      energy_initial              = 0.0;
+    double      momentum_initial[3]         = {};
+    double      angular_momentum_initial[3] = {};
+    bool        energy_initial_valid        = false;
+    double      energy_error                = 0.0;
+    double      momentum_error              = 0.0;
+    double      angular_momentum_error      = 0.0;
+    double      centre_of_mass[3]           = {};
+    void diagnosticsRead();
+
+    // Block timesteps
+    struct
+    {
+        uint32_t substep;
+    }
+    push_constants_block;
+
+    UniformData buffer_block_active;    // Indices of the particles kicked in the current substep
+    UniformData buffer_block_arguments; // Indirect dispatch arguments of the kick followed by the active count
+    uint32_t    work_item_count_block[3] = { 128, 1, 1 }; // Must match that in shader
+
+    // Collision merging. Merged bodies are left without mass and removed by compacting the buffers once enough have accumulated
+    struct CollisionStatistics
+    {
+        float    mass_max;        // Sizes the cells of the hash grid
+        uint32_t removed_count;   // Bodies without mass since the last compaction, merged or escaped
+        uint32_t remaining_count; // Bodies with mass, as counted by the last compaction
+    };
+
+    bool        collision_merging = false;
+    UniformData buffer_collision_heads;      // First body of each hash bucket
+    UniformData buffer_collision_links;      // Next body in the same bucket
+    UniformData buffer_collision_targets;    // Body that a body merges into
+    UniformData buffer_collision_claims;     // Body that a body takes in
+    UniformData buffer_collision_statistics; // CollisionStatistics, mapped
+    uint32_t    work_item_count_collision[3] = { 128, 1, 1 }; // Must match that in shader
+
+    // Escaper removal and compaction. Bodies without mass are removed by a prefix sum over the remaining ones
+    UniformData buffer_compaction_offsets;       // Position of a body among the remaining ones of its work group
+    UniformData buffer_compaction_block_offsets; // Remaining bodies of each work group, then their prefix sum
+    uint32_t    work_item_count_compaction[3] = { 128, 1, 1 }; // Must match that in shader
+    void particlesCompact();
+
+    // Barnes-Hut tree
+    struct TreeNode
+    {
+        float   com_mass[4];
+        float   bbox_min[4];
+        float   bbox_max[4];
+        int32_t links[4];
+    };
+
+    struct
+    {
+        uint32_t k;
+        uint32_t j;
+        uint32_t count;
+    }
+    push_constants_tree_sort;
+
+    enum ForceSolver
+    {
+        FORCE_SOLVER_ALL_PAIRS     = 0,
+        FORCE_SOLVER_BARNES_HUT    = 1,
+        FORCE_SOLVER_PARTICLE_MESH = 2,
+        FORCE_SOLVER_TREE_MESH     = 3  // Long-range part on the mesh, short-range part on the tree within a cutoff
+    };
+
+    int force_solver = FORCE_SOLVER_ALL_PAIRS;
+
+    UniformData buffer_tree_keys;
+    UniformData buffer_tree_values;
+    UniformData buffer_tree_nodes;
+    UniformData buffer_tree_bounds;
+    uint32_t    tree_sort_count;
+
+    // Particle mesh. Shares the bounding box and the descriptor sets of the tree. The mass is assigned to a mesh of mesh_size cells
+    // per axis, and the potential is solved by FFT on a zero padded mesh of twice the size, see nbody_pm.comp
+    struct
+    {
+        uint32_t axis;
+        uint32_t inverse;
+    }
+    push_constants_mesh;
+
+    static const uint32_t MESH_SIZE_MAX = 128; // Padded lines must fit the shared memory of nbody_pm_fft.comp
+
+    UniformData buffer_mesh_density; // Assigned mass in fixed point
+    UniformData buffer_mesh_spectra; // Padded mesh of the mass, then that of the force law, as complex numbers
 
-    UniformData buffer_nbody_compute;
-    UniformData buffer_nbody_draw;
     UniformData uniform_nbody_graphics;
     UniformData uniform_nbody_compute;
     UniformData uniform_performance_graphics;
@@ -193,6 +449,7 @@ private:
     QVector<QueryResult> query_timestamp_graphics_tone_map;
     QVector<QueryResult> query_timestamp_compute_leapfrog_step_1;
     QVector<QueryResult> query_timestamp_compute_leapfrog_step_2;
+    QVector<QueryResult> query_timestamp_compute_mesh; // Long-range part of the tree and particle mesh, within step 1
 
     // Surface
     VkSurfaceKHR             surface        = VK_NULL_HANDLE;
@@ -213,9 +470,9 @@ private:
     void swapChainImageViewsDestroy();
 
     // Fences
-    VkFence fence_draw           = VK_NULL_HANDLE;
-    VkFence fence_transfer       = VK_NULL_HANDLE;
-    VkFence fence_compute_step_1 = VK_NULL_HANDLE;
+    VkFence fence_draw        = VK_NULL_HANDLE;
+    VkFence fence_compute     = VK_NULL_HANDLE;
+    VkFence fence_diagnostics = VK_NULL_HANDLE;
     void fencesCreate();
     void fencesDestroy();
 
@@ -283,11 +540,18 @@ private:
     VkDescriptorSetLayout descriptor_layout_blur           = VK_NULL_HANDLE;
     VkDescriptorSetLayout descriptor_layout_normal_texture = VK_NULL_HANDLE;
     VkDescriptorSetLayout descriptor_layout_tone_mapping   = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_layout_tree           = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_layout_block          = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_layout_collision      = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_layout_compaction     = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptor_layout_stream         = VK_NULL_HANDLE;
     void descriptorSetLayoutsCreate();
     void descriptorSetLayoutsDestroy();
 
     // Descriptor sets
-    VkDescriptorSet descriptor_leapgfrog            = VK_NULL_HANDLE;
+    VkDescriptorSet descriptor_leapfrog[NBODY_BUFFER_COUNT]              = {}; // Slot i to slot i + 1
+    VkDescriptorSet descriptor_leapfrog_to_scratch[NBODY_BUFFER_COUNT]   = {}; // Slot i to scratch
+    VkDescriptorSet descriptor_leapfrog_from_scratch[NBODY_BUFFER_COUNT] = {}; // Scratch to slot i
     VkDescriptorSet descriptor_performance_graphics = VK_NULL_HANDLE;
     VkDescriptorSet descriptor_performance_compute  = VK_NULL_HANDLE;
     VkDescriptorSet descriptor_nbody                = VK_NULL_HANDLE;
@@ -297,6 +561,15 @@ private:
     VkDescriptorSet descriptor_normal_texture_scene = VK_NULL_HANDLE;
     VkDescriptorSet descriptor_normal_texture_blur  = VK_NULL_HANDLE;
     VkDescriptorSet descriptor_tone_mapping         = VK_NULL_HANDLE;
+    VkDescriptorSet descriptor_tree[NBODY_BUFFER_COUNT]              = {};
+    VkDescriptorSet descriptor_tree_to_scratch[NBODY_BUFFER_COUNT]   = {};
+    VkDescriptorSet descriptor_tree_from_scratch[NBODY_BUFFER_COUNT] = {};
+    VkDescriptorSet descriptor_block[NBODY_BUFFER_COUNT]             = {};
+    VkDescriptorSet descriptor_block_scratch                         = VK_NULL_HANDLE;
+    VkDescriptorSet descriptor_energy[NBODY_BUFFER_COUNT]            = {};
+    VkDescriptorSet descriptor_collision[NBODY_BUFFER_COUNT]         = {};
+    VkDescriptorSet descriptor_compaction[NBODY_BUFFER_COUNT]        = {}; // Slot i, compacted into slot i + 1
+    VkDescriptorSet descriptor_stream[2]                             = {}; // One per streamed tile buffer
     void descriptorSetsAllocate();
     void descriptorSetsUpdate();
     void descriptorSetsFree();
@@ -308,13 +581,46 @@ private:
     VkPipelineLayout pipeline_layout_blur           = VK_NULL_HANDLE;
     VkPipelineLayout pipeline_layout_normal_texture = VK_NULL_HANDLE;
     VkPipelineLayout pipeline_layout_tone_mapping   = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_tree           = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_block          = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_symmetric      = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_collision      = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_compaction     = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_stream         = VK_NULL_HANDLE;
     void pipelineLayoutsCreate();
     void pipelineLayoutsDestroy();
 
     // Pipelines
-    VkPipeline      pipeline_compute_leapfrog_step_1 = VK_NULL_HANDLE;
-    VkPipeline      pipeline_compute_leapfrog_step_2 = VK_NULL_HANDLE;
-    VkPipeline      pipeline_performance             = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_step_1           = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_step_1_half      = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_step_1_broadcast = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_symmetric        = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_step_2           = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_fused            = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_leapfrog_ensemble[2]      = {}; // Kick and drift
+    VkPipeline      pipeline_compute_leapfrog_stream[2]        = {}; // Accumulation over a tile and update of a block
+    VkPipeline      pipeline_compute_tree_bounds               = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_tree_morton               = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_tree_sort                 = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_tree_build                = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_tree_moments              = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_tree_walk                 = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_tree_walk_short           = VK_NULL_HANDLE; // Short-range part of the tree and particle mesh
+    VkPipeline      pipeline_compute_mesh[5]                   = {}; // Deposit, load, multiply, kick, multiply long range
+    VkPipeline      pipeline_compute_mesh_fft                  = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_reorder                   = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_hermite_predict           = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_hermite_evaluate          = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_hermite_correct           = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_yoshida_drift[4]          = {};
+    VkPipeline      pipeline_compute_yoshida_kick[3]           = {};
+    VkPipeline      pipeline_compute_block_select              = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_block_kick                = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_block_drift               = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_energy                    = VK_NULL_HANDLE;
+    VkPipeline      pipeline_compute_collision[5]              = {}; // One per pass
+    VkPipeline      pipeline_compute_compaction[4]             = {}; // Escape, scan, scan of the work groups, scatter
+    VkPipeline      pipeline_performance                       = VK_NULL_HANDLE;
     VkPipeline      pipeline_nbody          = VK_NULL_HANDLE;
     VkPipeline      pipeline_luminosity     = VK_NULL_HANDLE;
     VkPipeline      pipeline_blur           = VK_NULL_HANDLE;
@@ -323,8 +629,11 @@ private:
     VkPipelineCache pipeline_cache          = VK_NULL_HANDLE;
     void pipelinesCreate();
     void pipelinesDestroy();
+    void pipelinesComputeCreate();
+    void pipelinesComputeDestroy();
     void pipelineCacheCreate();
     void pipelineCacheDestroy();
+    QString pipelineCachePath() const; // In the cache location of the user, not the working directory
 
     // Commands
     VkCommandPool            command_pool;
@@ -333,8 +642,13 @@ private:
 
     // Merge these two
     QVector<VkCommandBuffer> command_buffer_draw;
-    VkCommandBuffer          command_buffer_compute_step_1 = VK_NULL_HANDLE;
-    VkCommandBuffer          command_buffer_compute_step_2 = VK_NULL_HANDLE;
+    VkCommandBuffer          command_buffer_compute_step_1[NBODY_BUFFER_COUNT]      = {};
+    VkCommandBuffer          command_buffer_compute_step_2[NBODY_BUFFER_COUNT]      = {};
+    VkCommandBuffer          command_buffer_compute_batch[NBODY_BUFFER_COUNT]       = {};
+    VkCommandBuffer          command_buffer_compute_reorder[NBODY_BUFFER_COUNT]     = {};
+    VkCommandBuffer          command_buffer_compute_slice[NBODY_BUFFER_COUNT]       = {};
+    VkCommandBuffer          command_buffer_compute_diagnostics[NBODY_BUFFER_COUNT] = {};
+    VkCommandBuffer          command_buffer_compute_stream[NBODY_BUFFER_COUNT]      = {};
 
     void commandPoolCreate();
     void commandPoolDestroy();
@@ -343,6 +657,23 @@ private:
     void commandBuffersPresentRecord();
     void commandBuffersGraphicsRecord();
     void commandBuffersComputeRecord();
+    void commandBufferComputeKickRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog, VkDescriptorSet descriptor_set_tree, uint32_t work_group_count_slice = 0, bool timestamps_mesh = false);
+    void commandBufferComputeSymmetricRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog);
+    void commandBufferComputeDriftRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog);
+    void commandBufferComputeFusedRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog);
+    void commandBufferComputeHermiteRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog);
+    void commandBufferComputeYoshidaRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog);
+    void commandBufferComputeBlockRecord(VkCommandBuffer command_buffer, const UniformData& source, const UniformData& destination, VkDescriptorSet descriptor_set_block);
+    void commandBufferComputeTreeRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_tree);
+    void commandBufferComputeSortRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_tree);
+    void commandBufferComputeBoundsRecord(VkCommandBuffer command_buffer);
+    void commandBufferComputeMeshRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_tree);
+    void commandBufferHermiteInitializeRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_leapfrog);
+    void commandBufferParticleIdsCopyRecord(VkCommandBuffer command_buffer, uint32_t nbody_slot_read, uint32_t nbody_slot_write);
+    void commandBufferComputeCollisionRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_collision);
+    void commandBufferComputeEscapeRecord(VkCommandBuffer command_buffer, VkDescriptorSet descriptor_set_compaction);
+    void commandBufferComputeStreamRecord(VkCommandBuffer command_buffer, uint32_t nbody_slot_read, uint32_t nbody_slot_write);
+    void commandBufferPublishRecord(VkCommandBuffer command_buffer, uint32_t nbody_slot);
     VkCommandBuffer commandBufferCreate();
     void commandBufferSubmitAndFree(VkCommandBuffer command_buffer);
 
@@ -387,12 +718,14 @@ private:
     // Fps & cps
     QQueue<size_t> p_fps_stack;
     QQueue<size_t> p_cps_stack;
+    QQueue<size_t> p_cps_step_stack; // Steps taken in each interval of p_cps_stack
+    size_t         cps_steps = 0;    // Steps of the submission that the next interval ends with
     QElapsedTimer  fps_timer;
     QElapsedTimer  cps_timer;
     QTimer         fps_update_timer;
     QElapsedTimer  uptime;
     double         time_total_graphics;
-    double         time_total_compute;
+    double         time_total_compute = 0;
 
     // Refresh timer
     QTimer *graphics_timer;
@@ -402,10 +735,12 @@ private:
     VulkanHelper *vulkan_helper;
 
     //Initialization of particles
-    void initializeNbodies(QVector<Particle>& buffer, int method);
 
-    int      initial_condition             = 1;
-    uint32_t initialization_particle_count = 20000;
+    int      initial_condition                = 1;
+    uint32_t initialization_particle_count    = 20000; // Per system of an ensemble
+    uint32_t initialization_ensemble_count    = 1;
+    uint32_t initialization_stream_block_size = 0;     // Out-of-core when non-zero, see stream_block_size
+    uint32_t initialization_mesh_size         = 32;    // Particle mesh cells per axis, a power of two
 
     // Keyboard movement
     QElapsedTimer keyboard_movement_timer;